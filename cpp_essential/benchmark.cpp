@@ -1,3 +1,5 @@
+#pragma once
+
 #include <chrono>
 #include <iostream>
 #include <string>
@@ -32,3 +34,13 @@ void benchmark_vector_push(const std::string& name,
 
   std::cout << name << ": " << duration.count() << " us\n";
 }
+
+// Wall-clock time of |fn()| in milliseconds.
+template <typename Fn>
+double time_ms(Fn&& fn) {
+  auto start = std::chrono::high_resolution_clock::now();
+  fn();
+  auto end = std::chrono::high_resolution_clock::now();
+
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "spinlock.cpp"
+
+namespace MT {
+
+// ------------
+// Big-reader lock
+// ------------
+//
+// A reader-writer lock for data that is read far more often than written.
+//
+// std::shared_mutex counts readers in one word: every lock_shared() and
+// unlock_shared() is an atomic RMW on the same cache line, so with many
+// reader threads the line ping-pongs between cores and reads stop scaling
+// even though readers never wait for each other.
+//
+// BigReaderLock gives every reader thread its own padded indicator:
+//   - lock_shared: increment own indicator, then check the writer flag; if a
+//     writer is there, undo and wait for it to leave, then retry
+//   - lock: take the writer mutex, raise the writer flag, wait until every
+//     indicator drains to zero
+// Readers write only their own line and read the writer flag, which stays
+// shared in every core's cache until a writer shows up.
+//
+// Both sides "store, then load the other side's variable", so both use
+// seq_cst: a reader that missed the flag is seen by the writer's scan, and
+// a writer that saw no readers is seen by any later reader.
+//
+// Writer preference: once the flag is up, new readers back off, so a
+// steady stream of readers cannot starve a writer.
+//
+// The cost moves to the writer, which scans all indicators: use it where
+// writes are rare. Like std::shared_mutex, not recursive: a thread that
+// takes the shared lock twice can deadlock with a waiting writer.
+//
+// Indicators are assigned per thread (round robin), so lock_shared and
+// unlock_shared of one thread always hit the same one; there are twice as
+// many as CPUs, threads beyond that share.
+//
+// Models SharedLockable: works with std::shared_lock and std::unique_lock.
+
+class BigReaderLock {
+ public:
+  explicit BigReaderLock(size_t num_indicators = default_indicators())
+      : mask(std::bit_ceil(std::max<size_t>(num_indicators, 1)) - 1),
+        indicators(std::make_unique<Indicator[]>(mask + 1)) {}
+
+  BigReaderLock(const BigReaderLock&) = delete;
+  BigReaderLock& operator=(const BigReaderLock&) = delete;
+
+  void lock_shared() {
+    std::atomic<int32_t>& mine = own_indicator();
+    while (true) {
+      mine.fetch_add(1, std::memory_order_seq_cst);
+      if (writer.load(std::memory_order_seq_cst) == 0) {
+        return;
+      }
+      // a writer is in or waiting: get out of its way
+      mine.fetch_sub(1, std::memory_order_release);
+      wait_for_writer();
+    }
+  }
+
+  bool try_lock_shared() {
+    std::atomic<int32_t>& mine = own_indicator();
+    mine.fetch_add(1, std::memory_order_seq_cst);
+    if (writer.load(std::memory_order_seq_cst) == 0) {
+      return true;
+    }
+    mine.fetch_sub(1, std::memory_order_release);
+    return false;
+  }
+
+  void unlock_shared() {
+    own_indicator().fetch_sub(1, std::memory_order_release);
+  }
+
+  void lock() {
+    writer_mtx.lock();
+    writer.store(1, std::memory_order_seq_cst);
+    Backoff backoff;
+    while (!drained()) {
+      backoff.pause();
+    }
+  }
+
+  bool try_lock() {
+    if (!writer_mtx.try_lock()) {
+      return false;
+    }
+    writer.store(1, std::memory_order_seq_cst);
+    if (drained()) {
+      return true;
+    }
+    unlock();
+    return false;
+  }
+
+  void unlock() {
+    writer.store(0, std::memory_order_release);
+    writer.notify_all();
+    writer_mtx.unlock();
+  }
+
+ private:
+  struct alignas(64) Indicator {
+    std::atomic<int32_t> readers{0};
+  };
+
+  static size_t default_indicators() {
+    return 2 * std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  static size_t thread_index() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+  }
+
+  std::atomic<int32_t>& own_indicator() const {
+    return indicators[thread_index() & mask].readers;
+  }
+
+  bool drained() const {
+    for (size_t i = 0; i <= mask; ++i) {
+      if (indicators[i].readers.load(std::memory_order_seq_cst) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Spin briefly (writers are meant to be short), then sleep until
+  // unlock() clears the flag.
+  void wait_for_writer() const {
+    Backoff backoff;
+    for (int i = 0; i < 8; ++i) {
+      if (writer.load(std::memory_order_acquire) == 0) {
+        return;
+      }
+      backoff.pause();
+    }
+    while (writer.load(std::memory_order_acquire) != 0) {
+      writer.wait(1, std::memory_order_acquire);
+    }
+  }
+
+  const size_t mask;
+  std::unique_ptr<Indicator[]> indicators;
+  alignas(64) std::atomic<uint32_t> writer{0};
+  SpinThenParkLock writer_mtx;
+};
+
+}  // namespace MT
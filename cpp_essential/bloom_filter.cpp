@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace MT {
+
+// ------------
+// Blocked Bloom filter
+// ------------
+//
+// Answers "definitely not present" or "maybe present" for a set of keys,
+// in a few bits per key:
+//   - no false negatives: an inserted key always tests "maybe"
+//   - false positives at a rate set by the bits per key (~1% at 10)
+//
+// A classic Bloom filter sets k bits anywhere in the array, so a lookup
+// costs k cache misses. The blocked variant picks one 64-byte block per
+// key and sets all k = 8 bits inside it, one per 64-bit word: a lookup is
+// one cache line, and the 8 bit positions are computed independently
+// (multiply-shift with 8 odd constants).
+//
+// With AVX2 the 8 masks are computed explicitly in SIMD (one vpmulld,
+// two vpsllvq), which GCC does not do for the scalar loop even at -O3.
+// The words themselves are read one relaxed atomic load at a time: a
+// vector load of atomics racing with insert() would be a data race.
+//
+// Lock-free: insert() sets bits with fetch_or, may_contain() reads them
+// with relaxed loads. A lookup racing with the insert of the same key may
+// still answer "not present", as it would have a moment earlier.
+//
+// Bits are never cleared; to forget keys, build a new filter.
+
+class BlockedBloomFilter {
+ public:
+  // Sized for |expected_items| at |bits_per_item|, at least one block.
+  explicit BlockedBloomFilter(size_t expected_items, double bits_per_item = 10)
+      : num_blocks(std::max<size_t>(
+            size_t(double(expected_items) * bits_per_item / kBlockBits), 1)),
+        expected(expected_items),
+        blocks(std::make_unique<Block[]>(num_blocks)) {}
+
+  BlockedBloomFilter(const BlockedBloomFilter&) = delete;
+  BlockedBloomFilter& operator=(const BlockedBloomFilter&) = delete;
+
+  // Key hash for insert / may_contain: std::hash, then a 64-bit finalizer
+  // so every bit depends on the whole key (block index and bit positions
+  // use different halves).
+  static uint64_t hash(std::string_view key) {
+    uint64_t h = std::hash<std::string_view>{}(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  void insert(uint64_t h) {
+    alignas(32) uint64_t mask[kWords];
+    make_mask(h, mask);
+    Block& block = blocks[block_index(h)];
+    for (int i = 0; i < kWords; ++i) {
+      if ((block.words[i].load(std::memory_order_relaxed) & mask[i]) !=
+          mask[i]) {
+        block.words[i].fetch_or(mask[i], std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool may_contain(uint64_t h) const {
+    alignas(32) uint64_t mask[kWords];
+    make_mask(h, mask);
+    const Block& block = blocks[block_index(h)];
+    uint64_t missing = 0;
+    for (int i = 0; i < kWords; ++i) {
+      missing |= ~block.words[i].load(std::memory_order_relaxed) & mask[i];
+    }
+    return missing == 0;
+  }
+
+  size_t capacity() const { return expected; }
+  size_t memory_bytes() const { return num_blocks * sizeof(Block); }
+
+ private:
+  static constexpr int kWords = 8;
+  static constexpr size_t kBlockBits = 64 * kWords;
+
+  struct alignas(64) Block {
+    std::atomic<uint64_t> words[kWords] = {};
+  };
+
+  static constexpr uint32_t kSalt[kWords] = {
+      0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+      0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+  // One bit per word: the top 6 bits of (low half of h) * salt[i].
+  // |mask| is 32-byte aligned.
+  static void make_mask(uint64_t h, uint64_t* mask) {
+    const uint32_t key = uint32_t(h);
+#if defined(__AVX2__)
+    const __m256i salt = _mm256_setr_epi32(
+        int(kSalt[0]), int(kSalt[1]), int(kSalt[2]), int(kSalt[3]),
+        int(kSalt[4]), int(kSalt[5]), int(kSalt[6]), int(kSalt[7]));
+    const __m256i shift = _mm256_srli_epi32(
+        _mm256_mullo_epi32(_mm256_set1_epi32(int(key)), salt), 26);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m128i lo = _mm256_castsi256_si128(shift);
+    const __m128i hi = _mm256_extracti128_si256(shift, 1);
+    __m256i* out = reinterpret_cast<__m256i*>(mask);
+    _mm256_store_si256(out, _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(lo)));
+    _mm256_store_si256(out + 1,
+                       _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(hi)));
+#else
+    for (int i = 0; i < kWords; ++i) {
+      mask[i] = uint64_t{1} << ((key * kSalt[i]) >> 26);
+    }
+#endif
+  }
+
+  // High half of h scaled to [0, num_blocks) without a division.
+  size_t block_index(uint64_t h) const {
+    return size_t(((h >> 32) * num_blocks) >> 32);
+  }
+
+  const size_t num_blocks;
+  const size_t expected;
+  std::unique_ptr<Block[]> blocks;
+};
+
+}  // namespace MT
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "bloom_filter.cpp"
+#include "epoch_reclamation.cpp"
+#include "sharded_counter.cpp"
+
+namespace MT {
+
+// ------------
+// Capacity-bounded DataCache (segmented CLOCK eviction)
+// ------------
+//
+// DataCache keeps every symbol it has ever seen. BoundedDataCache holds at
+// most |capacity| entries and evicts the ones not read recently.
+//
+// Exact LRU moves an entry to the front of a list on every hit, so a hit is
+// a write and needs the exclusive lock. CLOCK approximates LRU with one
+// "referenced" bit per entry instead: a hit takes the shared lock and sets
+// the entry's bit (a relaxed store, skipped when already set so hot
+// entries do not dirty their line).
+//
+// Plain CLOCK lets a burst of new symbols (a scan) push the hot set out:
+// every newcomer costs one hot entry its bit, and two sweeps evict it.
+// Segmented LRU fixes that with two segments, approximated here with the
+// same bits and two hands over the slot array:
+//   - probationary: where new entries start, unreferenced. The eviction
+//     hand takes the first unreferenced probationary entry it meets; one
+//     found referenced (hit since it arrived) is promoted instead
+//   - protected: at most 80% of the shard, and skipped by the eviction
+//     hand. A promotion past that bound runs the protected hand, which
+//     gives protected entries a second chance (clearing set bits) and
+//     demotes the first unreferenced one back to probation
+// A symbol seen once never leaves probation, so a scan only churns the
+// probationary fifth and the hot set stays protected. Hits still only set
+// a bit; segments change under the exclusive lock, on insert.
+//
+// Entries are split over shards, each with its own lock, slots and hand, so
+// writers to different shards do not contend.
+//
+// Optional TTL: with ttl > 0 an entry older than ttl reads as a miss, and
+// the eviction hand evicts it on its next pass, whatever its segment or
+// bit.
+//
+// Each shard keeps a Bloom filter over its symbols, so get() answers most
+// misses without the lock. Evicted symbols stay in the filter (bits cannot
+// be cleared) and only cost a trip to the map; once half a shard has been
+// evicted, the shard builds a fresh filter from its current symbols and
+// retires the old one to the epoch domain.
+
+class BoundedDataCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;    // made room for a new symbol
+    uint64_t expirations = 0;  // evicted because the TTL passed
+    size_t size = 0;
+  };
+
+  explicit BoundedDataCache(size_t capacity,
+                            std::chrono::nanoseconds ttl = {},
+                            size_t num_shards = 16)
+      : ttl(ttl),
+        shard_mask(std::bit_floor(std::max<size_t>(
+                       std::min(num_shards, capacity), 1)) -
+                   1),
+        shards(std::make_unique<Shard[]>(shard_mask + 1)) {
+    // split evenly; the total may round down by less than one per shard
+    const size_t per_shard = std::max<size_t>(capacity / (shard_mask + 1), 1);
+    for (size_t i = 0; i <= shard_mask; ++i) {
+      shards[i].init(per_shard);
+    }
+  }
+
+  BoundedDataCache(const BoundedDataCache&) = delete;
+  BoundedDataCache& operator=(const BoundedDataCache&) = delete;
+
+  void update(const std::string& symbol, double price) {
+    const uint64_t h = BlockedBloomFilter::hash(symbol);
+    Shard& shard = shard_of(h);
+    const int64_t expires_at = ttl.count() > 0 ? now_ns() + ttl.count() : 0;
+
+    std::unique_lock<std::shared_mutex> locker(shard.mtx);
+    auto it = shard.index.find(symbol);
+    if (it != shard.index.end()) {
+      Slot& slot = shard.slots[it->second];
+      slot.price = price;
+      slot.expires_at = expires_at;
+      slot.referenced.store(true, std::memory_order_relaxed);
+      return;
+    }
+
+    uint32_t s = shard.size < shard.capacity ? uint32_t(shard.size++)
+                                             : evict(shard);
+    // filter first: a get() that finds the symbol also passed the filter
+    shard.filter.load(std::memory_order_relaxed)->insert(h);
+    auto pos = shard.index.emplace(symbol, s).first;
+    Slot& slot = shard.slots[s];
+    slot.key = &pos->first;
+    slot.price = price;
+    slot.expires_at = expires_at;
+    // new entries start on probation, unreferenced: one-hit wonders go first
+    slot.referenced.store(false, std::memory_order_relaxed);
+    slot.is_protected = false;
+  }
+
+  // Returns false on a miss (never seen, evicted or expired).
+  bool get(const std::string& symbol, double& out) const {
+    const uint64_t h = BlockedBloomFilter::hash(symbol);
+    const Shard& shard = shard_of(h);
+    {
+      auto guard = epoch_domain().pin();
+      if (!shard.filter.load(std::memory_order_seq_cst)->may_contain(h)) {
+        misses.increment();
+        return false;
+      }
+    }
+
+    std::shared_lock<std::shared_mutex> locker(shard.mtx);
+
+    auto it = shard.index.find(symbol);
+    if (it == shard.index.end()) {
+      misses.increment();
+      return false;
+    }
+    const Slot& slot = shard.slots[it->second];
+    if (expired(slot, ttl.count() > 0 ? now_ns() : 0)) {
+      misses.increment();
+      return false;
+    }
+
+    if (!slot.referenced.load(std::memory_order_relaxed)) {
+      slot.referenced.store(true, std::memory_order_relaxed);
+    }
+    out = slot.price;
+    hits.increment();
+    return true;
+  }
+
+  // DataCache interface: 0.0 on a miss.
+  double get(const std::string& symbol) const {
+    double price;
+    return get(symbol, price) ? price : 0.0;
+  }
+
+  Stats stats() const {
+    Stats stats;
+    stats.hits = hits.load();
+    stats.misses = misses.load();
+    stats.evictions = evictions.load();
+    stats.expirations = expirations.load();
+    for (size_t i = 0; i <= shard_mask; ++i) {
+      std::shared_lock<std::shared_mutex> locker(shards[i].mtx);
+      stats.size += shards[i].size;
+    }
+    return stats;
+  }
+
+  size_t capacity() const { return shards[0].capacity * (shard_mask + 1); }
+
+ private:
+  struct Slot {
+    const std::string* key = nullptr;  // owned by the shard's index
+    double price = 0;
+    int64_t expires_at = 0;  // 0: never
+    mutable std::atomic<bool> referenced{false};
+    bool is_protected = false;  // under the exclusive lock only
+  };
+
+  struct alignas(64) Shard {
+    ~Shard() { delete filter.load(std::memory_order_relaxed); }
+
+    void init(size_t slot_count) {
+      capacity = slot_count;
+      protected_capacity = slot_count * 4 / 5;
+      slots = std::make_unique<Slot[]>(slot_count);
+      index.reserve(slot_count);
+      filter.store(new BlockedBloomFilter(slot_count),
+                   std::memory_order_relaxed);
+    }
+
+    mutable std::shared_mutex mtx;
+    std::unordered_map<std::string, uint32_t> index;  // symbol -> slot
+    std::unique_ptr<Slot[]> slots;
+    size_t capacity = 0;
+    size_t size = 0;
+    size_t hand = 0;  // eviction: probationary entries
+    size_t protected_hand = 0;  // demotion: protected entries
+    size_t protected_capacity = 0;
+    size_t num_protected = 0;
+    std::atomic<BlockedBloomFilter*> filter{nullptr};
+    size_t evicted_since_rebuild = 0;
+  };
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  static bool expired(const Slot& slot, int64_t now) {
+    return slot.expires_at != 0 && slot.expires_at <= now;
+  }
+
+  // bits the filter uses least: its block index comes from the top of the
+  // high half, its bit positions from the low half
+  Shard& shard_of(uint64_t h) const {
+    return shards[(h >> 32) & shard_mask];
+  }
+
+  // Caller holds the shard's exclusive lock and the shard is full. Frees a
+  // probationary (or expired) slot and returns it. Terminates: every
+  // promotion uses up a bit, and the protected bound keeps at least one
+  // probationary entry, its bit cleared by promotion or demotion.
+  uint32_t evict(Shard& shard) {
+    const int64_t now = ttl.count() > 0 ? now_ns() : 0;
+    while (true) {
+      Slot& slot = shard.slots[shard.hand];
+      const uint32_t victim = uint32_t(shard.hand);
+      shard.hand = (shard.hand + 1) % shard.capacity;
+
+      if (expired(slot, now)) {
+        expirations.increment();
+        if (slot.is_protected) --shard.num_protected;
+      } else if (slot.is_protected) {
+        continue;
+      } else if (slot.referenced.load(std::memory_order_relaxed)) {
+        slot.referenced.store(false, std::memory_order_relaxed);
+        slot.is_protected = true;  // promoted
+        if (++shard.num_protected > shard.protected_capacity) {
+          demote(shard);
+        }
+        continue;
+      } else {
+        evictions.increment();
+      }
+      shard.index.erase(shard.index.find(*slot.key));
+      if (++shard.evicted_since_rebuild > shard.capacity / 2) {
+        rebuild_filter(shard);
+      }
+      return victim;
+    }
+  }
+
+  // Caller holds the shard's exclusive lock and the protected segment is
+  // non-empty. Moves one protected entry back to probation, unreferenced.
+  // At most two sweeps: the first clears every protected bit.
+  static void demote(Shard& shard) {
+    while (true) {
+      Slot& slot = shard.slots[shard.protected_hand];
+      shard.protected_hand = (shard.protected_hand + 1) % shard.capacity;
+      if (!slot.is_protected) {
+        continue;
+      }
+      if (slot.referenced.load(std::memory_order_relaxed)) {
+        slot.referenced.store(false, std::memory_order_relaxed);
+        continue;
+      }
+      slot.is_protected = false;
+      --shard.num_protected;
+      return;
+    }
+  }
+
+  // Caller holds the shard's exclusive lock.
+  static void rebuild_filter(Shard& shard) {
+    auto* fresh = new BlockedBloomFilter(shard.capacity);
+    for (const auto& entry : shard.index) {
+      fresh->insert(BlockedBloomFilter::hash(entry.first));
+    }
+    BlockedBloomFilter* old =
+        shard.filter.exchange(fresh, std::memory_order_seq_cst);
+    epoch_domain().retire(old);
+    shard.evicted_since_rebuild = 0;
+  }
+
+  const std::chrono::nanoseconds ttl;
+  const size_t shard_mask;
+  std::unique_ptr<Shard[]> shards;
+
+  mutable ShardedCounter<uint64_t> hits;
+  mutable ShardedCounter<uint64_t> misses;
+  ShardedCounter<uint64_t> evictions;
+  ShardedCounter<uint64_t> expirations;
+};
+
+}  // namespace MT
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace MT {
+
+// ------------
+// Bulk-synchronous parallel (BSP) executor
+// ------------
+//
+// Iterative computations (stencils, graph relaxation) run as supersteps:
+//   - every worker computes on its own partition, reading the previous
+//     superstep's state and writing only its slice of the next one
+//   - all workers meet at a barrier; its completion function runs once, on
+//     one thread, while everybody waits: it combines the per-worker partial
+//     results (a residual, a delta), decides whether to stop, and flips the
+//     double buffers
+//   - repeat
+// Nothing inside a superstep is shared-and-written, so no locks; the
+// barrier is the only synchronization.
+//
+// Workers are persistent: created once, each always handles the same
+// partition index (its slice stays warm in that core's cache from one
+// superstep to the next), and parked between run() calls. The calling
+// thread is worker 0.
+//
+// Per-worker partial results are doubles summed in the completion; for
+// other reductions (max, several values) keep padded per-worker slots and
+// read them in |done|, which runs after every worker has arrived.
+
+namespace detail {
+
+// Splits [0, n) into |parts| contiguous ranges differing by at most one.
+inline std::pair<size_t, size_t> partition_range(size_t n,
+                                                 size_t parts,
+                                                 size_t i) {
+  const size_t base = n / parts, extra = n % parts;
+  const size_t begin = i * base + std::min(i, extra);
+  return {begin, begin + base + (i < extra ? 1 : 0)};
+}
+
+}  // namespace detail
+
+// Two copies of the state: a superstep reads current() and writes next();
+// swap() (from the completion function) makes next the new current.
+template <typename T>
+class DoubleBuffer {
+ public:
+  explicit DoubleBuffer(size_t n, const T& value = T{})
+      : buffers{std::vector<T>(n, value), std::vector<T>(n, value)} {}
+
+  size_t size() const { return buffers[0].size(); }
+
+  std::span<const T> current() const { return buffers[index]; }
+  std::span<T> current() { return buffers[index]; }
+  std::span<T> next() { return buffers[index ^ 1]; }
+
+  void swap() { index ^= 1; }
+
+ private:
+  std::vector<T> buffers[2];
+  size_t index = 0;
+};
+
+class BspExecutor {
+ public:
+  explicit BspExecutor(size_t num_workers = default_workers())
+      : workers(std::max<size_t>(num_workers, 1)),
+        partials(std::make_unique<Partial[]>(workers)),
+        sync(std::ptrdiff_t(workers), Completion{this}) {
+    for (size_t w = 1; w < workers; ++w) {
+      threads.emplace_back([this, w] { worker_loop(w); });
+    }
+  }
+
+  ~BspExecutor() {
+    shutting_down = true;
+    generation.fetch_add(1, std::memory_order_release);
+    generation.notify_all();
+    for (auto& t : threads) t.join();
+  }
+
+  BspExecutor(const BspExecutor&) = delete;
+  BspExecutor& operator=(const BspExecutor&) = delete;
+
+  size_t num_workers() const { return workers; }
+
+  // Worker |w|'s share of [0, n).
+  std::pair<size_t, size_t> range(size_t n, size_t w) const {
+    return detail::partition_range(n, workers, w);
+  }
+
+  // Runs supersteps 0, 1, ... until |done| returns true or |max_supersteps|
+  // have run:
+  //   - double step(size_t worker, size_t superstep), on every worker
+  //   - bool done(size_t superstep, double sum_of_step_results), once per
+  //     superstep after all steps, with all workers waiting
+  // Returns the number of supersteps run. An exception from |step| or
+  // |done| stops the run at the end of that superstep and is rethrown.
+  // One run at a time; concurrent calls wait.
+  template <typename Step, typename Done>
+  size_t run(size_t max_supersteps, Step&& step, Done&& done) {
+    std::lock_guard<std::mutex> locker(run_mtx);
+    if (max_supersteps == 0) {
+      return 0;
+    }
+
+    struct Job {
+      Step& step;
+      Done& done;
+    } job{step, done};
+
+    context = &job;
+    step_fn = [](void* ctx, size_t worker, size_t superstep) -> double {
+      return static_cast<Job*>(ctx)->step(worker, superstep);
+    };
+    done_fn = [](void* ctx, size_t superstep, double sum) -> bool {
+      return static_cast<Job*>(ctx)->done(superstep, sum);
+    };
+    limit = max_supersteps;
+    superstep = 0;
+    stop = false;
+    error = nullptr;
+    active.store(workers - 1, std::memory_order_relaxed);
+
+    generation.fetch_add(1, std::memory_order_release);
+    generation.notify_all();
+
+    supersteps(0);
+
+    // the others may still be leaving the loop: |job| lives on this stack
+    for (size_t n = active.load(std::memory_order_acquire); n != 0;
+         n = active.load(std::memory_order_acquire)) {
+      active.wait(n, std::memory_order_acquire);
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return superstep;
+  }
+
+ private:
+  struct alignas(64) Partial {
+    double value = 0;
+    bool failed = false;
+    std::exception_ptr error;
+  };
+
+  // Runs once per superstep, on the last thread to arrive.
+  struct Completion {
+    BspExecutor* self;
+    void operator()() noexcept { self->complete(); }
+  };
+
+  static size_t default_workers() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  void worker_loop(size_t w) {
+    uint64_t seen = 0;
+    while (true) {
+      generation.wait(seen, std::memory_order_acquire);
+      seen = generation.load(std::memory_order_acquire);
+      if (shutting_down) {
+        return;
+      }
+      supersteps(w);
+      if (active.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        active.notify_one();
+      }
+    }
+  }
+
+  void supersteps(size_t w) {
+    Partial& mine = partials[w];
+    while (true) {
+      try {
+        mine.value = step_fn(context, w, superstep);
+      } catch (...) {
+        mine.failed = true;
+        mine.error = std::current_exception();
+      }
+      sync.arrive_and_wait();  // complete() runs here
+      if (stop) {
+        return;
+      }
+    }
+  }
+
+  void complete() {
+    double sum = 0;
+    for (size_t w = 0; w < workers; ++w) {
+      Partial& p = partials[w];
+      if (p.failed && !error) {
+        error = p.error;
+      }
+      p.failed = false;
+      p.error = nullptr;
+      sum += p.value;
+    }
+
+    bool finished = error != nullptr;
+    if (!finished) {
+      try {
+        finished = done_fn(context, superstep, sum);
+      } catch (...) {
+        error = std::current_exception();
+        finished = true;
+      }
+    }
+    ++superstep;
+    stop = finished || superstep == limit;
+  }
+
+  const size_t workers;
+  std::unique_ptr<Partial[]> partials;
+  std::barrier<Completion> sync;
+
+  // current run; written before |generation| is bumped or in complete()
+  void* context = nullptr;
+  double (*step_fn)(void*, size_t, size_t) = nullptr;
+  bool (*done_fn)(void*, size_t, double) = nullptr;
+  size_t limit = 0;
+  size_t superstep = 0;
+  bool stop = false;
+  std::exception_ptr error;
+  std::mutex run_mtx;
+
+  alignas(64) std::atomic<uint64_t> generation{0};
+  std::atomic<size_t> active{0};  // workers other than the caller in run()
+  bool shutting_down = false;     // published by |generation|
+
+  std::vector<std::thread> threads;  // last: starts after the members it uses
+};
+
+}  // namespace MT
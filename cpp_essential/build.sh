@@ -1,14 +1,19 @@
 #!/bin/zsh
 set -e
 
+# Optimization level, e.g. `OPT=-O2 ./build.sh test_mt_bench` for benchmarks
+OPT=${OPT:--O0}
+# Sanitizer, e.g. `SANITIZE=thread ./build.sh test_mt` for the stress tests
+FLAGS="-g ${OPT}${SANITIZE:+ -fsanitize=${SANITIZE}}"
+
 mkdir -p build
 pushd build
 
 if [ $# -eq 0 ]; then
-  clang++ -std=c++20 -g -O0 ../main.cpp -o main
+  clang++ -std=c++20 ${=FLAGS} ../main.cpp -o main
 else
   NAMESPACE=$(echo $1 | tr '[:lower:]' '[:upper:]')
-  clang++ -std=c++20 -g -O0 ../main.cpp -D${NAMESPACE} -o main
+  clang++ -std=c++20 ${=FLAGS} ../main.cpp -D${NAMESPACE} -o main
 fi
 
 popd
@@ -1,12 +1,63 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <barrier>
+#include <bit>
+#include <charconv>
+#include <cmath>
 #include <chrono>
 #include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <filesystem>
 #include <functional>
 #include <future>
 #include <iostream>
+#include <latch>
+#include <map>
 #include <mutex>
+#include <optional>
+#include <ranges>
 #include <shared_mutex>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "big_reader_lock.cpp"
+#include "bloom_filter.cpp"
+#include "bsp.cpp"
+#include "bounded_data_cache.cpp"
+#include "epoch_reclamation.cpp"
+#include "generator.cpp"
+#include "ledger.cpp"
+#include "lock_free_stack.cpp"
+#include "mpmc_queue.cpp"
+#include "parallel.cpp"
+#include "pipeline.cpp"
+#include "rcu_data_cache.cpp"
+#include "sharded_data_cache.cpp"
+#include "sharded_counter.cpp"
+#include "snapshot.cpp"
+#include "spinlock.cpp"
+#include "spsc_queue.cpp"
+#include "tick_replay.cpp"
+#include "task.cpp"
+#include "task_graph.cpp"
+#include "tick_series.cpp"
+#include "thread_pool.cpp"
+#include "timer_wheel.cpp"
 
 namespace MT {
 
@@ -124,6 +175,8 @@ std::mutex mtx;
 std::recursive_mutex re_mtx;
 // allows multiple readers, but a single writer to hold it
 std::shared_mutex rw_mtx;
+// same, with per-thread reader indicators (big_reader_lock.cpp)
+BigReaderLock br_mtx;
 
 // 1. mutex + lock_guard
 // lock_guard: RAII wrapper for mutex, auto unlock at scope exit
@@ -143,14 +196,17 @@ void recursive_func(int n) {
 }
 
 // 3. shared_mutex
-void reader(int id) {
-  std::shared_lock<std::shared_mutex> lock(rw_mtx);
+// any SharedLockable: std::shared_mutex, BigReaderLock
+template <typename SharedMutex>
+void reader(SharedMutex& rw, int id) {
+  std::shared_lock<SharedMutex> lock(rw);
   std::cout << "Reader " << id << " reads shared_data = " << shared_data
             << "\n";
 }
 
-void writer(int id) {
-  std::unique_lock<std::shared_mutex> lock(rw_mtx);
+template <typename SharedMutex>
+void writer(SharedMutex& rw, int id) {
+  std::unique_lock<SharedMutex> lock(rw);
   shared_data++;
   std::cout << "Writer " << id << " updates shared_data = " << shared_data
             << "\n";
@@ -184,8 +240,24 @@ void test_mutex_and_lock_guard() {
 
   std::cout << "--- 3. shared_mutex (readers/writers) ---\n";
   std::vector<std::thread> readers, writers;
-  for (int i = 0; i < 3; ++i) readers.emplace_back(reader, i);
-  for (int i = 0; i < 2; ++i) writers.emplace_back(writer, i);
+  for (int i = 0; i < 3; ++i) {
+    readers.emplace_back(reader<std::shared_mutex>, std::ref(rw_mtx), i);
+  }
+  for (int i = 0; i < 2; ++i) {
+    writers.emplace_back(writer<std::shared_mutex>, std::ref(rw_mtx), i);
+  }
+  for (auto& t : readers) t.join();
+  for (auto& t : writers) t.join();
+
+  std::cout << "--- 3b. BigReaderLock (readers/writers) ---\n";
+  readers.clear();
+  writers.clear();
+  for (int i = 0; i < 3; ++i) {
+    readers.emplace_back(reader<BigReaderLock>, std::ref(br_mtx), i);
+  }
+  for (int i = 0; i < 2; ++i) {
+    writers.emplace_back(writer<BigReaderLock>, std::ref(br_mtx), i);
+  }
   for (auto& t : readers) t.join();
   for (auto& t : writers) t.join();
 
@@ -257,8 +329,8 @@ struct SafeQueue {
   std::condition_variable_any cv;
 };
 
-void write(SafeQueue& queue) {
-  for (int i = 0; i < DATA_SIZE; ++i) {
+void write(SafeQueue& queue, int count) {
+  for (int i = 0; i < count; ++i) {
     std::unique_lock<std::mutex> locker(queue.mtx);
 
     // check if queue is full: (tail+1)%BUFFER_SIZE==head
@@ -274,14 +346,16 @@ void write(SafeQueue& queue) {
   }
 }
 
-void read(SafeQueue& queue) {
-  for (int i = 0; i < DATA_SIZE; ++i) {
+void read(SafeQueue& queue, int count, bool print) {
+  for (int i = 0; i < count; ++i) {
     std::unique_lock<std::mutex> locker(queue.mtx);
 
     // check if queue is empty: head==tail
     queue.cv.wait(locker, [&queue]() { return !(queue.head == queue.tail); });
 
-    std::cout << "#" << i << ": " << queue.buffer[queue.head] << ", ";
+    if (print) {
+      std::cout << "#" << i << ": " << queue.buffer[queue.head] << ", ";
+    }
 
     queue.head = (queue.head + 1) % BUFFER_SIZE;
 
@@ -289,7 +363,7 @@ void read(SafeQueue& queue) {
     queue.cv.notify_one();
   }
 
-  std::cout << "\n";
+  if (print) std::cout << "\n";
 }
 
 void test_condition_variable() {
@@ -304,12 +378,498 @@ void test_condition_variable() {
   consumer.join();
 
   SafeQueue safe_queue{};
-  std::thread writer(write, std::ref(safe_queue));
-  std::thread reader(read, std::ref(safe_queue));
+  std::thread writer(write, std::ref(safe_queue), DATA_SIZE);
+  std::thread reader(read, std::ref(safe_queue), DATA_SIZE, true);
+  writer.join();
+  reader.join();
+}
+
+// ------------
+// Lock-free SPSC ring buffer (see spsc_queue.cpp)
+// ------------
+//
+// Same writer/reader pair as SafeQueue, without the mutex: the writer only
+// stores |tail|, the reader only stores |head|. push()/pop() fall back to
+// std::atomic::wait only when the ring stays full/empty.
+
+void test_spsc_queue() {
+  SpscQueue<char, true> queue(BUFFER_SIZE);
+
+  std::thread writer([&queue] {
+    for (int i = 0; i < DATA_SIZE; ++i) {
+      queue.push(static_cast<char>('a' + i % 26));
+    }
+  });
+
+  std::thread reader([&queue] {
+    for (int i = 0; i < DATA_SIZE; ++i) {
+      std::cout << "#" << i << ": " << queue.pop() << ", ";
+    }
+    std::cout << "\n";
+  });
+
   writer.join();
   reader.join();
 }
 
+void benchmark_spsc_queue() {
+  const int num_items = 1 << 20;
+  const int num_round_trips = 1 << 16;
+
+  auto report_throughput = [](const char* name, double ms) {
+    std::cout << name << ms << " ms, "
+              << static_cast<int64_t>(num_items / (ms / 1000.0))
+              << " items/s\n";
+  };
+  auto report_latency = [](const char* name, double ms) {
+    std::cout << name << ms * 1e6 / num_round_trips << " ns/round trip\n";
+  };
+
+  std::cout << "--- throughput, " << num_items << " chars ---\n";
+  {
+    SafeQueue queue{};
+    double ms = time_ms([&] {
+      std::thread writer(write, std::ref(queue), num_items);
+      std::thread reader(read, std::ref(queue), num_items, false);
+      writer.join();
+      reader.join();
+    });
+    report_throughput("SafeQueue write()/read():      ", ms);
+  }
+
+  for (size_t capacity : {size_t{BUFFER_SIZE}, size_t{1024}}) {
+    SpscQueue<char, true> queue(capacity);
+    int64_t checksum = 0;
+    double ms = time_ms([&] {
+      std::thread writer([&] {
+        for (int i = 0; i < num_items; ++i) queue.push(char('a' + i % 26));
+      });
+      std::thread reader([&] {
+        for (int i = 0; i < num_items; ++i) checksum += queue.pop();
+      });
+      writer.join();
+      reader.join();
+    });
+    std::cout << "capacity=" << capacity << "\n";
+    report_throughput("SpscQueue push()/pop():        ", ms);
+  }
+
+  {
+    SpscQueue<char, true> queue(1024);
+    int64_t checksum = 0;
+    double ms = time_ms([&] {
+      std::thread writer([&] {
+        std::array<char, 64> batch;
+        for (int i = 0; i < num_items;) {
+          int n = std::min<int>(batch.size(), num_items - i);
+          for (int k = 0; k < n; ++k) batch[k] = 'a' + (i + k) % 26;
+          std::span<const char> rest(batch.data(), n);
+          while (!rest.empty()) {
+            size_t pushed = queue.try_push_bulk(rest);
+            if (pushed == 0) std::this_thread::yield();
+            rest = rest.subspan(pushed);
+          }
+          i += n;
+        }
+      });
+      std::thread reader([&] {
+        std::array<char, 64> batch;
+        for (int i = 0; i < num_items;) {
+          size_t n = queue.try_pop_bulk(batch);
+          if (n == 0) std::this_thread::yield();
+          for (size_t k = 0; k < n; ++k) checksum += batch[k];
+          i += n;
+        }
+      });
+      writer.join();
+      reader.join();
+    });
+    report_throughput("SpscQueue bulk (64, cap 1024): ", ms);
+  }
+
+  std::cout << "--- round trip latency (ping-pong) ---\n";
+  {
+    SafeQueue ping{}, pong{};
+    double ms = time_ms([&] {
+      std::thread echo([&] {
+        for (int i = 0; i < num_round_trips; ++i) {
+          read(ping, 1, false);
+          write(pong, 1);
+        }
+      });
+      for (int i = 0; i < num_round_trips; ++i) {
+        write(ping, 1);
+        read(pong, 1, false);
+      }
+      echo.join();
+    });
+    report_latency("SafeQueue:                     ", ms);
+  }
+
+  {
+    SpscQueue<int, true> ping(BUFFER_SIZE), pong(BUFFER_SIZE);
+    double ms = time_ms([&] {
+      std::thread echo([&] {
+        for (int i = 0; i < num_round_trips; ++i) pong.push(ping.pop());
+      });
+      for (int i = 0; i < num_round_trips; ++i) {
+        ping.push(i);
+        pong.pop();
+      }
+      echo.join();
+    });
+    report_latency("SpscQueue push()/pop():        ", ms);
+  }
+
+  // NOTE: pure spinning needs a core per side; on one core each side burns
+  // its whole time slice before the other one runs.
+  if (std::thread::hardware_concurrency() > 1) {
+    SpscQueue<int> ping(BUFFER_SIZE), pong(BUFFER_SIZE);
+    double ms = time_ms([&] {
+      std::thread echo([&] {
+        int v;
+        for (int i = 0; i < num_round_trips; ++i) {
+          while (!ping.try_pop(v)) cpu_relax();
+          while (!pong.try_push(v)) cpu_relax();
+        }
+      });
+      int v;
+      for (int i = 0; i < num_round_trips; ++i) {
+        while (!ping.try_push(i)) cpu_relax();
+        while (!pong.try_pop(v)) cpu_relax();
+      }
+      echo.join();
+    });
+    report_latency("SpscQueue try_* (busy spin):   ", ms);
+  }
+}
+
+// ------------
+// Bounded MPMC queue (see mpmc_queue.cpp)
+// ------------
+//
+// Drop-in for the produce()/consume() pair: the queue replaces
+// |q| + |mtx| + |cond|, so any number of producers and consumers can run
+// without a shared lock. A sentinel per consumer ends the stream.
+
+void test_mpmc_queue() {
+  constexpr int num_producers = 2;
+  constexpr int num_consumers = 2;
+  constexpr int sentinel = -1;
+
+  MpmcQueue<int, true> queue(8);
+
+  std::vector<std::thread> producers, consumers;
+  for (int p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&queue, p] {
+      for (int count = 5; count > 0; --count) {
+        queue.push(p * 100 + count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      }
+    });
+  }
+  for (int c = 0; c < num_consumers; ++c) {
+    consumers.emplace_back([&queue, c] {
+      for (int data = queue.pop(); data != sentinel; data = queue.pop()) {
+        std::cout << "[consumer " << c << "] queue value: " << data << "\n";
+      }
+    });
+  }
+
+  for (auto& t : producers) t.join();
+  for (int c = 0; c < num_consumers; ++c) queue.push(sentinel);
+  for (auto& t : consumers) t.join();
+}
+
+// Moves |num_items| ints from P producers to C consumers through
+// push(int) / pop() -> int, ending each consumer with a -1 sentinel.
+// Returns the elapsed ms, negated if the consumers' sum is wrong.
+template <typename Push, typename Pop>
+double run_producers_consumers(int num_producers,
+                               int num_consumers,
+                               int num_items,
+                               Push push,
+                               Pop pop) {
+  std::atomic<int64_t> sum{0};
+
+  double ms = time_ms([&] {
+    std::vector<std::thread> producers, consumers;
+    for (int p = 0; p < num_producers; ++p) {
+      producers.emplace_back([&, p] {
+        for (int i = p; i < num_items; i += num_producers) push(i);
+      });
+    }
+    for (int c = 0; c < num_consumers; ++c) {
+      consumers.emplace_back([&] {
+        int64_t local = 0;
+        for (int v = pop(); v != -1; v = pop()) local += v;
+        sum.fetch_add(local, std::memory_order_relaxed);
+      });
+    }
+    for (auto& t : producers) t.join();
+    for (int c = 0; c < num_consumers; ++c) push(-1);
+    for (auto& t : consumers) t.join();
+  });
+
+  const int64_t expected = int64_t{num_items} * (num_items - 1) / 2;
+  return sum.load() == expected ? ms : -ms;
+}
+
+void benchmark_mpmc_queue() {
+  const int num_items = 1 << 20;
+
+  std::cout << "P x C  | mutex+deque | MpmcQueue | MpmcQueue bulk(16)\n";
+  for (int p : {1, 2, 4}) {
+    for (int c : {1, 2, 4}) {
+      // same protocol as produce()/consume(): one lock, notify per item
+      std::deque<int> dq;
+      std::mutex dq_mtx;
+      std::condition_variable dq_cv;
+      double mutex_ms = run_producers_consumers(
+          p, c, num_items,
+          [&](int v) {
+            {
+              std::lock_guard<std::mutex> locker(dq_mtx);
+              dq.push_front(v);
+            }
+            dq_cv.notify_one();
+          },
+          [&] {
+            std::unique_lock<std::mutex> locker(dq_mtx);
+            dq_cv.wait(locker, [&] { return !dq.empty(); });
+            int v = dq.back();
+            dq.pop_back();
+            return v;
+          });
+
+      MpmcQueue<int, true> queue(1024);
+      double mpmc_ms = run_producers_consumers(
+          p, c, num_items,
+          [&](int v) { queue.push(v); },
+          [&] { return queue.pop(); });
+
+      // batches of 16 claimed with one CAS per side; consumers stop once
+      // every item was seen (no sentinels: a batch could swallow two)
+      MpmcQueue<int> bulk_queue(1024);
+      std::atomic<int> consumed{0};
+      std::atomic<int64_t> bulk_sum{0};
+      double bulk_ms = time_ms([&] {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < p; ++i) {
+          threads.emplace_back([&, i] {
+            std::vector<int> batch;
+            for (int v = i; v < num_items; v += p) {
+              batch.push_back(v);
+              if (batch.size() == 16 || v + p >= num_items) {
+                std::span<const int> rest(batch);
+                while (!rest.empty()) {
+                  size_t n = bulk_queue.try_push_bulk(rest);
+                  if (n == 0) std::this_thread::yield();
+                  rest = rest.subspan(n);
+                }
+                batch.clear();
+              }
+            }
+          });
+        }
+        for (int i = 0; i < c; ++i) {
+          threads.emplace_back([&] {
+            std::array<int, 16> batch;
+            int64_t local = 0;
+            while (consumed.load(std::memory_order_relaxed) < num_items) {
+              size_t n = bulk_queue.try_pop_bulk(batch);
+              if (n == 0) {
+                std::this_thread::yield();
+                continue;
+              }
+              for (size_t k = 0; k < n; ++k) local += batch[k];
+              consumed.fetch_add(n, std::memory_order_relaxed);
+            }
+            bulk_sum.fetch_add(local, std::memory_order_relaxed);
+          });
+        }
+        for (auto& t : threads) t.join();
+      });
+      if (bulk_sum.load() != int64_t{num_items} * (num_items - 1) / 2) {
+        bulk_ms = -bulk_ms;
+      }
+
+      std::cout << p << " x " << c << "  | " << mutex_ms << " ms | "
+                << mpmc_ms << " ms | " << bulk_ms << " ms\n";
+    }
+  }
+}
+
+// ------------
+// Staged pipeline (see pipeline.cpp)
+// ------------
+//
+// parse -> transform -> aggregate -> write over "symbol,qty,price" lines.
+// Aggregate keeps a running total per symbol, so it has one worker, and
+// with ordered = true it sees the trades in input order.
+
+struct Trade {
+  std::string symbol;
+  int64_t qty = 0;
+  double price = 0;
+  double notional = 0;
+  uint64_t seq = 0;
+};
+
+Trade parse_trade(const std::string& line, uint64_t seq) {
+  Trade t;
+  t.seq = seq;
+  const size_t c1 = line.find(','), c2 = line.find(',', c1 + 1);
+  t.symbol = line.substr(0, c1);
+  std::from_chars(line.data() + c1 + 1, line.data() + c2, t.qty);
+  t.price = std::stod(line.substr(c2 + 1));
+  return t;
+}
+
+void print_pipeline_stats(const std::vector<PipelineStageStats>& stats) {
+  std::cout << "stage      | workers | items | busy ms | starved ms | "
+               "stalled ms | max depth\n";
+  for (const auto& s : stats) {
+    std::cout << s.name << std::string(11 - std::min<size_t>(s.name.size(), 10), ' ')
+              << "| " << s.workers << " | " << s.items << " | " << s.busy_ms
+              << " | " << s.starved_ms << " | " << s.stalled_ms << " | "
+              << s.max_queue_depth << "\n";
+  }
+}
+
+void test_pipeline() {
+  const std::vector<std::string> symbols = {"AAPL", "MSFT", "GOOG"};
+
+  std::map<std::string, double> totals;
+  uint64_t expected_seq = 0;
+  bool in_order = true;
+  std::string last_line;
+
+  PipelineOptions options;
+  options.batch_size = 4;
+  options.queue_capacity = 2;
+  options.ordered = true;
+
+  auto pipeline =
+      PipelineBuilder<std::pair<std::string, uint64_t>>(options)
+          .stage("parse", 2,
+                 [](std::pair<std::string, uint64_t> line) {
+                   return parse_trade(line.first, line.second);
+                 })
+          .stage("transform", 2,
+                 [](Trade t) {
+                   t.notional = t.qty * t.price;
+                   return t;
+                 })
+          .stage("aggregate", 1,
+                 [&totals](Trade t) {
+                   t.notional = totals[t.symbol] += t.notional;
+                   return t;
+                 })
+          .sink("write", 1, [&](const Trade& t) {
+            in_order = in_order && t.seq == expected_seq++;
+            last_line = t.symbol + " running notional " +
+                        std::to_string(t.notional);
+          });
+
+  for (uint64_t i = 0; i < 100; ++i) {
+    pipeline.push({symbols[i % symbols.size()] + "," + std::to_string(i + 1) +
+                       "," + std::to_string(10 + i % 7) + ".5",
+                   i});
+  }
+  pipeline.finish();
+
+  std::cout << "write saw " << expected_seq << " trades, in input order: "
+            << std::boolalpha << in_order << "\n";
+  std::cout << "last line: " << last_line << "\n";
+  for (const auto& [symbol, total] : totals) {
+    std::cout << symbol << " total notional " << total << "\n";
+  }
+  print_pipeline_stats(pipeline.stats());
+
+  // a throwing stage: the others drain, finish() rethrows
+  auto failing = PipelineBuilder<int>()
+                     .stage("check", 2,
+                            [](int v) {
+                              if (v == 500) throw std::runtime_error("bad row 500");
+                              return v;
+                            })
+                     .sink("drop", 1, [](int) {});
+  for (int i = 0; i < 1000; ++i) failing.push(i);
+  try {
+    failing.finish();
+  } catch (const std::exception& e) {
+    std::cout << "finish() rethrew: " << e.what() << "\n";
+  }
+}
+
+// |units| rounds of an LCG: stand-in for per-item work of a known cost.
+uint64_t burn(uint64_t x, int units) {
+  for (int i = 0; i < units; ++i) {
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  return x;
+}
+
+void benchmark_pipeline() {
+  const int num_items = 200'000;
+
+  std::vector<std::string> lines;
+  lines.reserve(num_items);
+  for (int i = 0; i < num_items; ++i) {
+    lines.push_back("S" + std::to_string(i % 64) + "," + std::to_string(i % 100) +
+                    "," + std::to_string(100 + i % 13) + ".25");
+  }
+
+  struct Config {
+    const char* name;
+    int transform_units;  // cost of the transform stage per item
+    size_t transform_workers;
+    bool ordered;
+  };
+  for (Config config : {Config{"balanced", 50, 1, false},
+                        Config{"slow transform", 2000, 1, false},
+                        Config{"slow transform x3", 2000, 3, false},
+                        Config{"slow transform x3 ordered", 2000, 3, true}}) {
+    PipelineOptions options;
+    options.ordered = config.ordered;
+
+    std::unordered_map<std::string, double> totals;
+    uint64_t written = 0, checksum = 0;
+    auto pipeline =
+        PipelineBuilder<const std::string*>(options)
+            .stage("parse", 1,
+                   [](const std::string* line) { return parse_trade(*line, 0); })
+            .stage("transform", config.transform_workers,
+                   [units = config.transform_units](Trade t) {
+                     t.seq = burn(uint64_t(t.qty), units);
+                     t.notional = t.qty * t.price;
+                     return t;
+                   })
+            .stage("aggregate", 1,
+                   [&totals](Trade t) {
+                     t.notional = totals[t.symbol] += t.notional;
+                     return t;
+                   })
+            .sink("write", 1, [&](const Trade& t) {
+              ++written;
+              checksum += t.seq;
+            });
+
+    double ms = time_ms([&] {
+      for (const std::string& line : lines) pipeline.push(&line);
+      pipeline.finish();
+    });
+
+    std::cout << config.name << ": " << num_items / ms << " items/ms"
+              << (written == uint64_t(num_items) && checksum != 0
+                      ? ""
+                      : " (LOST ITEMS)")
+              << "\n";
+    print_pipeline_stats(pipeline.stats());
+  }
+}
+
 // ------------
 // Deadlock
 // ------------
@@ -395,7 +955,11 @@ void spinlock() {
   // - If the lock is acquired: by another thread, keeps spinning
   // - If the lock is released: acquire the lock, set to true, return false
   while (atomic_flag_lock.test_and_set(std::memory_order_acquire)) {
-    // busy-wait (spin)
+    // busy-wait (spin) on a plain read: test_and_set is a write and would
+    // bounce the cache line between the waiters on every iteration
+    while (atomic_flag_lock.test(std::memory_order_relaxed)) {
+      cpu_relax();
+    }
   }
 
   std::cout << "Atomic flag lock acquired by thread"
@@ -406,6 +970,157 @@ void spinlock() {
   atomic_flag_lock.clear(std::memory_order_release);
 }
 
+// Lockable spinlocks with backoff, a ticket lock, an MCS lock and a
+// spin-then-park lock live in spinlock.cpp.
+template <Lockable Lock>
+void count_with_lock(const char* name) {
+  Lock lock;
+  int count = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 10000; ++i) {
+        std::lock_guard<Lock> locker(lock);
+        ++count;
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  std::cout << name << ": count = " << count << "\n";
+}
+
+// Every thread runs lock -> ++shared -> unlock for |duration|. Prints the
+// acquisitions per ms over all threads and Jain's fairness index of the
+// per-thread counts: 1 = equal shares, 1/num_threads = one thread got all.
+template <Lockable Lock>
+void benchmark_lock(int num_threads, std::chrono::milliseconds duration) {
+  Lock lock;
+  int64_t shared = 0;
+  std::vector<detail::PaddedSlot<int64_t>> counts(num_threads);
+  std::atomic<bool> stop{false};
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      int64_t local = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        lock.lock();
+        ++shared;
+        lock.unlock();
+        ++local;
+      }
+      counts[t].value = local;
+    });
+  }
+  std::this_thread::sleep_for(duration);
+  stop.store(true, std::memory_order_relaxed);
+  for (auto& t : threads) t.join();
+
+  double sum = 0, sum_squares = 0;
+  for (auto& c : counts) {
+    sum += c.value;
+    sum_squares += double(c.value) * c.value;
+  }
+  double fairness = sum_squares > 0 ? sum * sum / (num_threads * sum_squares)
+                                    : 0;
+  std::cout << " | " << int64_t(sum / duration.count()) << " ("
+            << fairness << ")" << (shared == sum ? "" : " WRONG");
+}
+
+// Expect TicketLock / McsLock to collapse once threads > cores: the lock
+// can only go to the next waiter in line, even if it is not running.
+void benchmark_locks() {
+  const auto duration = std::chrono::milliseconds(200);
+  const std::vector<int> num_threads = {1, 2, 4, 8};
+
+  std::cout << "acquisitions/ms (fairness), threads:";
+  for (int n : num_threads) std::cout << " " << n;
+  std::cout << "\n";
+
+  auto row = [&]<Lockable Lock>(const char* name, std::type_identity<Lock>) {
+    std::cout << name;
+    for (int n : num_threads) benchmark_lock<Lock>(n, duration);
+    std::cout << "\n";
+  };
+  row("std::mutex      ", std::type_identity<std::mutex>{});
+  row("TtasLock        ", std::type_identity<TtasLock>{});
+  row("TicketLock      ", std::type_identity<TicketLock>{});
+  row("McsLock         ", std::type_identity<McsLock>{});
+  row("SpinThenParkLock", std::type_identity<SpinThenParkLock>{});
+}
+
+// |num_readers| threads take the shared lock in a loop for |duration| while
+// one writer takes the exclusive lock every |write_interval| (none if 0).
+// Prints reads/ms over all readers and the writes that got through.
+template <typename SharedMutex>
+void benchmark_shared_lock(int num_readers,
+                           std::chrono::milliseconds duration,
+                           std::chrono::microseconds write_interval) {
+  SharedMutex rw;
+  int64_t value = 0;
+  std::atomic<bool> stop{false};
+  std::atomic<int64_t> reads{0};
+  int64_t writes = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_readers; ++t) {
+    threads.emplace_back([&] {
+      int64_t local = 0, sum = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        std::shared_lock<SharedMutex> lock(rw);
+        sum += value;
+        ++local;
+      }
+      reads.fetch_add(local + (sum < 0));
+    });
+  }
+  if (write_interval.count() > 0) {
+    threads.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(write_interval);
+        std::unique_lock<SharedMutex> lock(rw);
+        ++value;
+        ++writes;
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(duration);
+  stop.store(true, std::memory_order_relaxed);
+  for (auto& t : threads) t.join();
+
+  std::cout << " | " << reads.load() / duration.count();
+  if (write_interval.count() > 0) std::cout << " (" << writes << "w)";
+}
+
+// Read throughput as readers are added. With std::shared_mutex every
+// reader writes the same lock word; with BigReaderLock each writes its own.
+void benchmark_shared_locks() {
+  const auto duration = std::chrono::milliseconds(200);
+  const std::vector<int> num_readers = {1, 2, 4, 8, 16, 32, 64};
+
+  for (auto write_interval :
+       {std::chrono::microseconds(0), std::chrono::microseconds(1000)}) {
+    std::cout << (write_interval.count() ? "1 writer every 1ms, "
+                                         : "readers only, ")
+              << "reads/ms, readers:";
+    for (int n : num_readers) std::cout << " " << n;
+    std::cout << "\n";
+
+    auto row = [&]<typename Lock>(const char* name, std::type_identity<Lock>) {
+      std::cout << name;
+      for (int n : num_readers) {
+        benchmark_shared_lock<Lock>(n, duration, write_interval);
+      }
+      std::cout << "\n";
+    };
+    row("std::shared_mutex", std::type_identity<std::shared_mutex>{});
+    row("BigReaderLock    ", std::type_identity<BigReaderLock>{});
+  }
+}
+
 std::atomic<int> d{0};
 std::atomic<bool> ready2{false};
 
@@ -477,6 +1192,108 @@ void print_stack(std::atomic<Node*>& head) {
   std::cout << "\n";
 }
 
+// ------------
+// Lock-free stack with pop
+// ------------
+//
+// push_stack above never frees a node and has no pop: adding the obvious
+// pop (load head, CAS head -> head->next, delete) is both a use-after-free
+// and an ABA bug. LockFreeStack (lock_free_stack.cpp) fixes both.
+//
+// The stress part is meant to run under ThreadSanitizer:
+//   SANITIZE=thread ./build.sh test_mt
+
+void test_lock_free_stack() {
+  {
+    LockFreeStack<int> stack;
+    for (int i = 0; i < 5; ++i) stack.push(i);
+
+    int value;
+    while (stack.try_pop(value)) std::cout << value << "->";
+    std::cout << "\n";
+  }
+
+  // every thread pushes its own range and pops whatever is on top; each
+  // value must come out exactly once
+  const int num_threads = 4;
+  const int per_thread = 1 << 14;
+
+  LockFreeStack<int> stack;
+  std::vector<std::vector<int>> popped(num_threads + 1);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      int value;
+      for (int i = 0; i < per_thread; ++i) {
+        stack.push(t * per_thread + i);
+        if (i % 3 != 0 && stack.try_pop(value)) popped[t].push_back(value);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  int value;
+  while (stack.try_pop(value)) popped.back().push_back(value);
+
+  std::vector<int> seen(num_threads * per_thread, 0);
+  for (auto& values : popped) {
+    for (int v : values) ++seen[v];
+  }
+  bool ok = std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; });
+  std::cout << "stress: " << num_threads << " threads, " << seen.size()
+            << " values, each popped once: " << (ok ? "yes" : "NO") << "\n";
+}
+
+// Push/pop pairs from 1..8 threads: LockFreeStack vs a mutex + vector.
+void benchmark_lock_free_stack() {
+  const int num_ops = 1 << 21;
+
+  auto run = [&](int num_threads, auto push, auto pop) {
+    return time_ms([&] {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+          for (int i = 0; i < num_ops / num_threads; ++i) {
+            push(i);
+            pop();
+          }
+        });
+      }
+      for (auto& t : threads) t.join();
+    });
+  };
+
+  std::cout << "threads | mutex stack | LockFreeStack  (" << num_ops
+            << " push+pop pairs)\n";
+  for (int num_threads : {1, 2, 4, 8}) {
+    std::vector<int> vec;
+    std::mutex mtx;
+    double mutex_ms = run(
+        num_threads,
+        [&](int v) {
+          std::lock_guard<std::mutex> locker(mtx);
+          vec.push_back(v);
+        },
+        [&] {
+          std::lock_guard<std::mutex> locker(mtx);
+          if (!vec.empty()) vec.pop_back();
+        });
+
+    LockFreeStack<int> stack;
+    double lock_free_ms = run(
+        num_threads,
+        [&](int v) { stack.push(v); },
+        [&] {
+          int v;
+          stack.try_pop(v);
+        });
+
+    std::cout << num_threads << "       | " << mutex_ms << " ms | "
+              << lock_free_ms << " ms\n";
+  }
+}
+
 void spawn_threads(int num_threads) {
   const int num_iters = 1 << 27;
   const int elements_per_thread = num_iters / num_threads;
@@ -547,6 +1364,88 @@ void spawn_threads3() {
   for (int i = 0; i < num_threads; ++i) threads[i].join();
 }
 
+// spawn_threads3 packaged: ShardedCounter picks the padded slot itself, and
+// the total is read back with one call
+void spawn_threads4() {
+  const int num_iters = 1 << 27;
+  const int num_threads = 4;
+  const int elements_per_thread = num_iters / num_threads;
+
+  ShardedCounter<int64_t> counter;
+
+  auto work = [&]() {
+    for (int i = 0; i < elements_per_thread; ++i) {
+      counter.increment();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(work);
+  }
+
+  for (int i = 0; i < num_threads; ++i) threads[i].join();
+  int64_t total = counter.load();
+  (void)total;
+}
+
+// Same number of increments split over 1..64 threads: one std::atomic vs
+// ShardedCounter, and a reader thread polling load() / load_approx().
+void benchmark_sharded_counter() {
+  const int num_iters = 1 << 24;
+
+  auto run = [&](int num_threads, auto add, auto read) {
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+      while (!done.load(std::memory_order_relaxed)) {
+        read();
+        std::this_thread::yield();
+      }
+    });
+
+    double ms = time_ms([&] {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&] {
+          for (int i = 0; i < num_iters / num_threads; ++i) add();
+        });
+      }
+      for (auto& t : threads) t.join();
+    });
+
+    done.store(true, std::memory_order_relaxed);
+    reader.join();
+    return ms;
+  };
+
+  std::cout << "threads | atomic fetch_add | ShardedCounter load() | "
+               "ShardedCounter load_approx(1ms)\n";
+  for (int num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+    std::atomic<int64_t> atomic{0};
+    double atomic_ms = run(
+        num_threads,
+        [&] { atomic.fetch_add(1, std::memory_order_relaxed); },
+        [&] { return atomic.load(std::memory_order_relaxed); });
+
+    ShardedCounter<int64_t> exact;
+    double exact_ms = run(
+        num_threads, [&] { exact.increment(); }, [&] { return exact.load(); });
+
+    ShardedCounter<int64_t> approx;
+    double approx_ms = run(
+        num_threads,
+        [&] { approx.increment(); },
+        [&] { return approx.load_approx(std::chrono::milliseconds(1)); });
+
+    const int64_t expected = int64_t{num_iters / num_threads} * num_threads;
+    bool ok = atomic.load() == expected && exact.load() == expected &&
+              approx.load() == expected;
+    std::cout << num_threads << "       | " << atomic_ms << " ms | "
+              << exact_ms << " ms | " << approx_ms << " ms"
+              << (ok ? "" : " (WRONG)") << "\n";
+  }
+}
+
 void test_atomic_and_memory_order_model() {
   std::cout << "--- atomic ---\n";
   std::vector<std::thread> threads;
@@ -596,6 +1495,11 @@ void test_atomic_and_memory_order_model() {
     std::thread t2(spinlock);
     t1.join();
     t2.join();
+
+    count_with_lock<TtasLock>("TtasLock");
+    count_with_lock<TicketLock>("TicketLock");
+    count_with_lock<McsLock>("McsLock");
+    count_with_lock<SpinThenParkLock>("SpinThenParkLock");
   }
 
   {
@@ -634,30 +1538,255 @@ void test_atomic_and_memory_order_model() {
   std::cout << "no sharing, num_threads=4, num_counters=4, duration="
             << std::chrono::duration<double, std::milli>(end - start).count()
             << "ms\n";
+
+  start = std::chrono::high_resolution_clock::now();
+  spawn_threads4();
+  end = std::chrono::high_resolution_clock::now();
+  std::cout << "ShardedCounter, num_threads=4, duration="
+            << std::chrono::duration<double, std::milli>(end - start).count()
+            << "ms\n";
 }
 
 // ------------
-// Design Pattern: Futures & Promises
+// parallel_for / parallel_reduce vs spawn_threads*
 // ------------
 //
-// Producer ---> Promise -> Future ----> Consumer
+// Same pool for every run; the caller participates, so a pool of
+// |num_threads - 1| workers gives |num_threads| participants, like the
+// spawn_threads* experiments.
 
-int compute_square(int x) {
-  std::cout << "Computing square of " << x << " in thread "
-            << std::this_thread::get_id() << ": ";
-  std::this_thread::sleep_for(std::chrono::seconds(1));
-  return x * x;
-}
+void benchmark_parallel_loops() {
+  const int num_threads = 4;
+  ThreadPool pool(num_threads - 1);
 
-void test_promise_and_future() {
-  std::promise<int> prom;
-  std::future<int> fut = prom.get_future();
-  std::thread t(
-      [&prom](int x) {
-        int val = compute_square(x);
-        prom.set_value(val);
-      },
-      6);
+  auto report = [](const char* name, double ms, bool ok) {
+    std::cout << name << ms << " ms" << (ok ? "" : " (WRONG)") << "\n";
+  };
+
+  std::cout << "--- count to 2^27 ---\n";
+  {
+    const int num_iters = 1 << 27;
+
+    double ms = time_ms([] { spawn_threads(1); });
+    report("spawn_threads(1):         ", ms, true);
+    ms = time_ms([] { spawn_threads(4); });
+    report("spawn_threads(4):         ", ms, true);
+    ms = time_ms([] { spawn_threads2(); });
+    report("spawn_threads2:           ", ms, true);
+    ms = time_ms([] { spawn_threads3(); });
+    report("spawn_threads3:           ", ms, true);
+    ms = time_ms([] { spawn_threads4(); });
+    report("spawn_threads4 (sharded): ", ms, true);
+
+    int64_t count = 0;
+    auto ones = std::views::iota(0, num_iters) |
+                std::views::transform([](int) { return int64_t{1}; });
+    ms = time_ms([&] {
+      count = parallel_reduce(pool, ones, int64_t{0}, std::plus<>{});
+    });
+    report("parallel_reduce:          ", ms, count == num_iters);
+  }
+
+  std::cout << "--- sum of 2^24 elements (uniform work) ---\n";
+  {
+    std::vector<int64_t> data(1 << 24);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = i % 1000;
+
+    int64_t expected = 0;
+    double ms = time_ms([&] {
+      for (int64_t x : data) expected += x;
+    });
+    report("serial loop:              ", ms, true);
+
+    // static partition, one padded partial per thread
+    int64_t sum = 0;
+    ms = time_ms([&] {
+      std::array<detail::PaddedSlot<int64_t>, num_threads> partials{};
+      const size_t slice = data.size() / num_threads;
+      std::vector<std::thread> threads;
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+          size_t end = t == num_threads - 1 ? data.size() : (t + 1) * slice;
+          int64_t local = 0;
+          for (size_t i = t * slice; i < end; ++i) local += data[i];
+          partials[t].value = local;
+        });
+      }
+      for (auto& t : threads) t.join();
+      for (auto& p : partials) sum += p.value;
+    });
+    report("static split (threads):   ", ms, sum == expected);
+
+    ms = time_ms([&] {
+      sum = parallel_reduce(pool, data, int64_t{0}, std::plus<>{});
+    });
+    report("parallel_reduce:          ", ms, sum == expected);
+  }
+
+  std::cout << "--- skewed work: cost of element i grows with i ---\n";
+  {
+    const int n = 1 << 12;
+    std::vector<double> out(n);
+    auto cost = [&](int i) {
+      double x = i;
+      for (int k = 0; k < i; ++k) x = x * 0.999 + 1.0;
+      out[i] = x;
+    };
+
+    double ms = time_ms([&] {
+      for (int i = 0; i < n; ++i) cost(i);
+    });
+    report("serial loop:              ", ms, true);
+
+    ms = time_ms([&] {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+          int begin = t * n / num_threads;
+          int end = (t + 1) * n / num_threads;
+          for (int i = begin; i < end; ++i) cost(i);
+        });
+      }
+      for (auto& t : threads) t.join();
+    });
+    report("static split (threads):   ", ms, true);
+
+    ms = time_ms([&] {
+      parallel_for(pool, std::views::iota(0, n), 16, cost);
+    });
+    report("parallel_for (grain=16):  ", ms, true);
+  }
+}
+
+// Strong scaling of BspExecutor: the same problem on 1, 2, 4, 8 workers.
+//   - Jacobi: 5-point stencil on a 2048x2048 grid, 200 supersteps, rows
+//     partitioned by worker; the reduction is the squared residual
+//   - PageRank: 1M vertices, 8 random out-edges each, pulled over in-edges
+//     until the L1 change drops below 1e-6
+void benchmark_bsp() {
+  const size_t n = 2048;
+  const size_t pr_vertices = 1'000'000;
+  const size_t out_degree = 8;
+
+  // in-edge lists (CSR) of a random graph, every vertex out_degree edges
+  std::vector<uint32_t> in_begin(pr_vertices + 1, 0), in_edges;
+  {
+    std::vector<std::pair<uint32_t, uint32_t>> edges;  // (to, from)
+    edges.reserve(pr_vertices * out_degree);
+    uint64_t rng = 99;
+    for (uint32_t from = 0; from < pr_vertices; ++from) {
+      for (size_t k = 0; k < out_degree; ++k) {
+        rng = rng * 6364136223846793005ull + 1442695040888963407ull;  // LCG
+        edges.emplace_back(uint32_t((rng >> 33) % pr_vertices), from);
+      }
+    }
+    std::sort(edges.begin(), edges.end());
+    in_edges.reserve(edges.size());
+    for (auto [to, from] : edges) {
+      ++in_begin[to + 1];
+      in_edges.push_back(from);
+    }
+    for (size_t v = 0; v < pr_vertices; ++v) in_begin[v + 1] += in_begin[v];
+  }
+
+  std::cout << "workers | jacobi ms | speedup | pagerank ms | supersteps | "
+               "speedup\n";
+  double jacobi_base = 0, pagerank_base = 0;
+  for (size_t workers : {1, 2, 4, 8}) {
+    BspExecutor bsp(workers);
+
+    DoubleBuffer<double> grid(n * n, 0.0);
+    for (size_t x = 0; x < n; ++x) {
+      grid.current()[x] = grid.next()[x] = 1.0;  // hot top edge
+    }
+    double residual = 0;
+    double jacobi_ms = time_ms([&] {
+      bsp.run(
+          200,
+          [&](size_t worker, size_t) {
+            auto [begin, end] = bsp.range(n - 2, worker);
+            auto cur = grid.current();
+            auto next = grid.next();
+            double r = 0;
+            for (size_t y = begin + 1; y < end + 1; ++y) {
+              for (size_t x = 1; x < n - 1; ++x) {
+                size_t i = y * n + x;
+                next[i] =
+                    0.25 * (cur[i - 1] + cur[i + 1] + cur[i - n] + cur[i + n]);
+                r += (next[i] - cur[i]) * (next[i] - cur[i]);
+              }
+            }
+            return r;
+          },
+          [&](size_t, double r) {
+            grid.swap();
+            residual = r;
+            return false;
+          });
+    });
+
+    const double damping = 0.85;
+    DoubleBuffer<double> rank(pr_vertices, 1.0 / pr_vertices);
+    size_t supersteps = 0;
+    double pagerank_ms = time_ms([&] {
+      supersteps = bsp.run(
+          100,
+          [&](size_t worker, size_t) {
+            auto [begin, end] = bsp.range(pr_vertices, worker);
+            auto cur = rank.current();
+            auto next = rank.next();
+            double delta = 0;
+            for (size_t v = begin; v < end; ++v) {
+              double sum = 0;
+              for (uint32_t e = in_begin[v]; e < in_begin[v + 1]; ++e) {
+                sum += cur[in_edges[e]];
+              }
+              next[v] = (1 - damping) / pr_vertices +
+                        damping * sum / out_degree;
+              delta += std::abs(next[v] - cur[v]);
+            }
+            return delta;
+          },
+          [&](size_t, double delta) {
+            rank.swap();
+            return delta < 1e-6;
+          });
+    });
+
+    if (workers == 1) {
+      jacobi_base = jacobi_ms;
+      pagerank_base = pagerank_ms;
+    }
+    volatile double sink = residual;  // keeps the reduction alive
+    (void)sink;
+    std::cout << workers << " | " << jacobi_ms << " | "
+              << jacobi_base / jacobi_ms << " | " << pagerank_ms << " | "
+              << supersteps << " | " << pagerank_base / pagerank_ms << "\n";
+  }
+}
+
+// ------------
+// Design Pattern: Futures & Promises
+// ------------
+//
+// Producer ---> Promise -> Future ----> Consumer
+
+int compute_square(int x) {
+  std::cout << "Computing square of " << x << " in thread "
+            << std::this_thread::get_id() << ": ";
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  return x * x;
+}
+
+void test_promise_and_future() {
+  std::promise<int> prom;
+  std::future<int> fut = prom.get_future();
+  std::thread t(
+      [&prom](int x) {
+        int val = compute_square(x);
+        prom.set_value(val);
+      },
+      6);
   std::cout << "Result from promise: " << fut.get() << "\n";
   t.join();
 }
@@ -719,187 +1848,2270 @@ void test_packaged_task() {
 // ------------
 // Design Pattern: Thread Pool Pattern
 // ------------
-class ThreadPool {
- public:
-  ThreadPool(int n) {
-    for (int i = 0; i < n; ++i) {
-      workers.emplace_back([this]() {
-        while (true) {
-          std::function<void()> task;
-
-          {
-            std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [this] { return stop || !tasks.empty(); });
-
-            if (stop && tasks.empty()) {
-              return;
-            }
+//
+// ThreadPool, Future/Promise, when_all/when_any: see thread_pool.cpp
+//
+// submit() vs enqueue() + std::promise:
+//   - the task is move-only, no shared_ptr<promise> needed
+//   - the result comes back through a Future, which can be chained with
+//     then() instead of blocking a thread on get()
 
-            task = std::move(tasks.front());
-            tasks.pop();
-          }
+void test_thread_pool() {
+  ThreadPool pool(3);
+
+  for (int i = 0; i < 5; ++i) {
+    pool.enqueue([i]() {
+      std::cout << "Task " << i << " executed by thread "
+                << std::this_thread::get_id() << "\n";
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    });
+  }
+
+  std::cout << "--- submit / then / when_all / when_any ---\n";
+  Future<int> squared = pool.submit(compute_square, 3);
+  Future<std::string> message =
+      squared.then([](int x) { return "then: " + std::to_string(x); });
+  std::cout << message.get() << "\n";
+
+  std::vector<Future<int>> parts;
+  for (int i = 1; i <= 4; ++i) {
+    parts.push_back(pool.submit([](int x) { return x * 10; }, i));
+  }
+  int total = 0;
+  for (int v : when_all(std::move(parts)).get()) total += v;
+  std::cout << "when_all sum: " << total << "\n";
+
+  std::vector<Future<int>> racers;
+  racers.push_back(pool.submit([] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    return 1;
+  }));
+  racers.push_back(pool.submit([] { return 2; }));
+  auto first = when_any(std::move(racers)).get();
+  std::cout << "when_any: index=" << first.index << ", value=" << first.value
+            << "\n";
+  try {
+    when_any(std::vector<Future<int>>{}).get();
+  } catch (const std::invalid_argument& e) {
+    std::cout << "when_any of nothing throws: " << e.what() << "\n";
+  }
+
+  Future<double> failed = pool.submit([]() -> double {
+    throw std::runtime_error("Exception from pool: division by zero");
+  });
+  try {
+    failed.get();
+  } catch (const std::runtime_error& e) {
+    std::cout << "submit rethrows: " << e.what() << "\n";
+  }
+}
+
+// Lanes: one worker, held busy while tasks of every lane queue up, so the
+// order they run in is the pool's choice alone.
+void run_lanes_in_order(const char* title, ThreadPoolOptions options,
+                        std::chrono::milliseconds bulk_head_start = {}) {
+  ThreadPool pool(1, options);
+  Promise<void> gate;
+  Future<void> opened = gate.get_future();
+  pool.enqueue([&opened] { opened.wait(); });
+
+  std::string order;  // only the one worker writes it
+  std::latch done(9);
+  auto mark = [&](char c) {
+    return [&order, &done, c] {
+      order += c;
+      done.count_down();
+    };
+  };
+  for (int i = 0; i < 3; ++i) pool.enqueue(mark('b'), Lane::kBulk);
+  std::this_thread::sleep_for(bulk_head_start);
+  for (int i = 0; i < 3; ++i) pool.enqueue(mark('n'));
+  for (int i = 0; i < 3; ++i) pool.enqueue(mark('C'), Lane::kCritical);
+
+  gate.set_value();
+  done.wait();
+  std::cout << title << order << "\n";
+}
+
+void test_thread_pool_lanes() {
+  std::cout << "queued: bbb nnn CCC (bulk, normal, critical)\n";
+
+  ThreadPoolOptions strict;
+  strict.strict = true;
+  run_lanes_in_order("strict:           ", strict);
+
+  run_lanes_in_order("weighted 4:2:1:   ", ThreadPoolOptions{});
 
-          task();
+  ThreadPoolOptions aging = strict;
+  aging.max_wait = std::chrono::milliseconds(5);
+  run_lanes_in_order("strict, aged 5ms: ", aging,
+                     std::chrono::milliseconds(10));
+}
+
+// Every ~1 ms a burst of 16 bulk tasks (50 us each) arrives, then one
+// critical task (1 us). Latency = from enqueue until the task starts. In
+// one FIFO the critical task waits for the whole burst; in its own lane,
+// for a worker to come free; with a reserved worker, for nothing.
+void benchmark_thread_pool_lanes() {
+  using namespace std::chrono_literals;
+  using Clock = std::chrono::steady_clock;
+  auto spin = [](Clock::duration d) {
+    for (auto end = Clock::now() + d; Clock::now() < end;) {
+    }
+  };
+  const int rounds = 1000, burst = 16;
+
+  ThreadPoolOptions strict;
+  strict.strict = true;
+  ThreadPoolOptions reserved = strict;
+  reserved.reserved_workers = 1;
+  ThreadPoolOptions aged = strict;
+  aged.max_wait = 2ms;
+
+  struct Config {
+    const char* name;
+    bool lanes;  // false: everything in the normal lane
+    ThreadPoolOptions options;
+  };
+  std::cout << "pool (4 workers)     | critical p50 us | p99 us | max us | "
+               "bulk p99 us | max us\n";
+  for (const Config& config : {Config{"single FIFO         ", false, {}},
+                               Config{"weighted 4:2:1      ", true, {}},
+                               Config{"strict              ", true, strict},
+                               Config{"strict + 1 reserved ", true, reserved},
+                               Config{"strict + aging 2 ms ", true, aged}}) {
+    std::vector<int64_t> critical(rounds), bulk(rounds * burst);
+    {
+      ThreadPool pool(4, config.options);
+      for (int r = 0; r < rounds; ++r) {
+        for (int b = 0; b < burst; ++b) {
+          pool.enqueue(
+              [&, slot = r * burst + b, t = Clock::now()] {
+                bulk[slot] = (Clock::now() - t).count();
+                spin(50us);
+              },
+              config.lanes ? Lane::kBulk : Lane::kNormal);
         }
+        pool.enqueue(
+            [&, r, t = Clock::now()] {
+              critical[r] = (Clock::now() - t).count();
+              spin(1us);
+            },
+            config.lanes ? Lane::kCritical : Lane::kNormal);
+        std::this_thread::sleep_for(1ms);
+      }
+    }  // drains the queue
+
+    auto us = [](std::vector<int64_t>& v, double p) {
+      std::sort(v.begin(), v.end());
+      return v[std::min(v.size() - 1, size_t(p * v.size()))] / 1000;
+    };
+    std::cout << config.name << " | " << us(critical, 0.5) << " | "
+              << us(critical, 0.99) << " | " << us(critical, 1) << " | "
+              << us(bulk, 0.99) << " | " << us(bulk, 1) << "\n";
+  }
+}
+
+// Two single-worker pools bounce a task back and forth: every hop wakes an
+// idle worker, so a round trip is two wake-ups. CPU = process CPU time /
+// wall time (100% = one core), measured over 200 ms with nothing queued
+// and over the ping-pong (at most 10k round trips or 1 s).
+void benchmark_idle_strategies() {
+  using namespace std::chrono_literals;
+  using Clock = std::chrono::steady_clock;
+
+  auto cpu_percent = [](auto&& fn) {
+    const std::clock_t start = std::clock();
+    const double wall_ms = time_ms(fn);
+    const double cpu_ms = 1000.0 * (std::clock() - start) / CLOCKS_PER_SEC;
+    return int(100 * cpu_ms / wall_ms);
+  };
+
+  struct Config {
+    const char* name;
+    IdleStrategy idle;
+  };
+  std::cout << "idle strategy   | round trip p50 us | p99 us | CPU idle % | "
+               "CPU ping-pong %\n";
+  for (Config config : {Config{"block (cv)     ", IdleStrategy::kBlock},
+                        Config{"spin then wait ", IdleStrategy::kSpinThenWait},
+                        Config{"spin then yield", IdleStrategy::kSpinThenYield},
+                        Config{"busy poll      ", IdleStrategy::kBusyPoll}}) {
+    ThreadPoolOptions options;
+    options.idle = config.idle;
+    ThreadPool ping(1, options), pong(1, options);
+
+    const int idle_cpu =
+        cpu_percent([] { std::this_thread::sleep_for(200ms); });
+
+    std::vector<int64_t> samples;
+    samples.reserve(10'000);
+    const Clock::time_point deadline = Clock::now() + 1s;
+    Promise<void> done;
+    Future<void> finished = done.get_future();
+    std::function<void()> serve = [&] {  // runs on |ping|
+      if (samples.size() == 10'000 || Clock::now() > deadline) {
+        done.set_value();
+        return;
+      }
+      pong.enqueue([&, t0 = Clock::now()] {
+        ping.enqueue([&, t0] {
+          samples.push_back((Clock::now() - t0).count());
+          serve();
+        });
       });
-    }
+    };
+    const int busy_cpu = cpu_percent([&] {
+      ping.enqueue([&] { serve(); });
+      finished.wait();
+    });
+
+    std::sort(samples.begin(), samples.end());
+    auto us = [&](double p) {
+      return samples[std::min(samples.size() - 1, size_t(p * samples.size()))] /
+             1000.0;
+    };
+    std::cout << config.name << " | " << us(0.5) << " | " << us(0.99) << " | "
+              << idle_cpu << " | " << busy_cpu << " (" << samples.size()
+              << " round trips)\n";
   }
+}
 
-  ~ThreadPool() {
-    {
-      std::lock_guard<std::mutex> lock(mtx);
-      stop = true;
+// CPUs this process may run on: its affinity mask on Linux, else all.
+std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+#if defined(__linux__)
+  cpu_set_t set;
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
     }
-    cv.notify_all();
+  }
+#endif
+  if (cpus.empty()) {
+    const int n = int(std::max(1u, std::thread::hardware_concurrency()));
+    for (int cpu = 0; cpu < n; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
 
-    for (int i = 0; i < workers.size(); ++i) {
-      workers[i].join();
-    }
+// One CPU per worker, round robin over the allowed ones.
+std::vector<std::vector<int>> one_cpu_each(int workers) {
+  const std::vector<int> cpus = allowed_cpus();
+  std::vector<std::vector<int>> sets;
+  for (int i = 0; i < workers; ++i) {
+    sets.push_back({cpus[size_t(i) % cpus.size()]});
   }
+  return sets;
+}
 
-  void enqueue(std::function<void()> task) {
-    {
-      std::lock_guard<std::mutex> lock(mtx);
-      tasks.push(task);
-    }
-    cv.notify_one();
+void print_pool_stats(const ThreadPoolStats& stats) {
+  std::cout << "worker | tasks | busy ms | idle ms | avg queue wait us | "
+               "cpu | migrations\n";
+  for (const WorkerStats& w : stats.workers) {
+    std::cout << w.index << (w.reserved ? " (critical)" : "")
+              << (w.pinned ? " pinned" : "") << " | " << w.tasks << " | "
+              << std::chrono::duration<double, std::milli>(w.busy).count()
+              << " | "
+              << std::chrono::duration<double, std::milli>(w.idle).count()
+              << " | "
+              << (w.tasks ? w.queue_wait.count() / 1000 / int64_t(w.tasks) : 0)
+              << " | " << w.cpu << " | " << w.migrations << "\n";
   }
+  std::cout << "run by try_run_one() callers: " << stats.helped << "\n";
+}
 
- private:
-  std::vector<std::thread> workers;
-  std::queue<std::function<void()>> tasks;
+// A named, pinned pool with timing on: the workers report their thread
+// name, and stats() shows who ran what, the caller helping included.
+void test_thread_pool_stats() {
+  using namespace std::chrono_literals;
+  ThreadPoolOptions options;
+  options.name = "demo-pool";
+  options.stats = true;
+  options.reserved_workers = 1;
+  options.affinity = one_cpu_each(3);
+  ThreadPool pool(3, options);
+
+#if defined(__linux__)
+  std::cout << "worker thread name: "
+            << pool.submit([] {
+                 char name[16] = {};
+                 pthread_getname_np(pthread_self(), name, sizeof(name));
+                 return std::string(name);
+               }).get()
+            << "\n";
+#endif
+
+  std::atomic<int> left{200};
+  for (int i = 0; i < 200; ++i) {
+    pool.enqueue(
+        [&left, i] {
+          std::this_thread::sleep_for(i % 10 == 0 ? 500us : 50us);
+          left.fetch_sub(1, std::memory_order_release);
+        },
+        i % 10 == 0 ? Lane::kCritical : Lane::kNormal);
+  }
+  while (left.load(std::memory_order_acquire) > 0) {
+    if (!pool.try_run_one()) std::this_thread::yield();
+  }
+  print_pool_stats(pool.stats());
+}
 
-  std::mutex mtx;
-  std::condition_variable cv;
-  bool stop = false;
-};
+// Cache-sensitive work: every worker owns a 256 KB table (sized for a
+// private L2) and each task makes 64K random updates to the table of the
+// worker running it. Pinned, a worker's table stays in its core's cache
+// from one task to the next; unpinned, the scheduler may move the worker
+// to a cold core, most often when other threads compete for the CPUs
+// (the "+ noise" rows add one spinning thread per CPU, unpinned).
+// Migrations come from the pool's own stats.
+//
+// NOTE: what pinning buys depends on the machine. On a single CPU there is
+// nowhere to migrate to and the rows differ by noise only; pinning also
+// hurts when the pinned CPUs are the busy ones while others sit idle.
+void benchmark_thread_pool_affinity() {
+  const std::vector<int> cpus = allowed_cpus();
+  const int workers = int(cpus.size());
+  const int tasks = 256 * workers, updates = 1 << 16;
+  constexpr size_t kTableWords = (256 << 10) / sizeof(uint64_t);
+
+  std::cout << "pool (" << workers << " workers) | ms | ns/update | "
+               "migrations\n";
+  for (int noisy = 0; noisy < 2; ++noisy) {
+    for (int pinned = 0; pinned < 2; ++pinned) {
+      std::atomic<bool> stop_noise{false};
+      std::vector<std::thread> noise;
+      for (int i = 0; noisy && i < workers; ++i) {
+        noise.emplace_back([&stop_noise] {
+          while (!stop_noise.load(std::memory_order_relaxed)) cpu_relax();
+        });
+      }
 
-void test_thread_pool() {
-  ThreadPool pool(3);
+      ThreadPoolOptions options;
+      options.stats = true;
+      if (pinned) options.affinity = one_cpu_each(workers);
+      std::vector<std::vector<uint64_t>> tables(
+          workers, std::vector<uint64_t>(kTableWords));
+      uint64_t migrations = 0;
+      double ms;
+      {
+        ThreadPool pool(workers, options);
+        ms = time_ms([&] {
+          std::vector<Future<void>> done;
+          for (int t = 0; t < tasks; ++t) {
+            done.push_back(pool.submit([&pool, &tables, t] {
+              std::vector<uint64_t>& table = tables[pool.worker_index()];
+              uint64_t x = uint64_t(t) + 1;
+              for (int i = 0; i < updates; ++i) {
+                x = x * 6364136223846793005ull + 1442695040888963407ull;
+                ++table[(x >> 33) % kTableWords];
+              }
+            }));
+          }
+          when_all(std::move(done)).get();
+        });
+        for (const WorkerStats& w : pool.stats().workers) {
+          migrations += w.migrations;
+        }
+      }
+      stop_noise = true;
+      for (std::thread& t : noise) t.join();
 
-  for (int i = 0; i < 5; ++i) {
-    pool.enqueue([i]() {
-      std::cout << "Task " << i << " executed by thread "
-                << std::this_thread::get_id() << "\n";
-      std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    });
+      std::cout << (pinned ? "pinned  " : "unpinned")
+                << (noisy ? " + noise" : "        ") << " | " << ms << " | "
+                << ms * 1e6 / (double(tasks) * updates) << " | " << migrations
+                << "\n";
+    }
   }
 }
 
 // ------------
-// Design Pattern: Monitor Object Pattern
+// Timer wheel (see timer_wheel.cpp)
 // ------------
-class BankAccount {
- private:
-  int balance = 0;
-  std::mutex mtx;
+//
+// Delayed and periodic work without a thread sleeping for each: the
+// timer thread hands due tasks to the pool.
+
+void test_timer_wheel() {
+  using namespace std::chrono_literals;
+  using Clock = TimerWheel::Clock;
+
+  std::mutex print_mtx;
+  const Clock::time_point start = Clock::now();
+  auto say = [&](const std::string& what) {
+    const double ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(print_mtx);
+    std::cout << "[" << int(ms) << " ms] " << what << "\n";
+  };
+  std::latch one_shots(2);
+  std::atomic<int> beats{0};
+  Promise<void> fifth_beat;
+  Future<void> fifth = fifth_beat.get_future();
+
+  ThreadPool pool(2);
+  TimerWheel wheel(pool);  // 1 ms ticks
+
+  wheel.schedule_after(50ms, [&] {
+    say("50 ms timer");
+    one_shots.count_down();
+  });
+  wheel.schedule_after(20ms, [&] {
+    say("20 ms timer");
+    one_shots.count_down();
+  });
+  TimerWheel::TimerId doomed =
+      wheel.schedule_after(30ms, [&] { say("cancelled timer ran (bug)"); });
+  TimerWheel::TimerId heartbeat =
+      wheel.schedule_every(10ms, [&, p = std::move(fifth_beat)]() mutable {
+        if (++beats == 5) p.set_value();
+      });
+  say(std::string("cancel 30 ms timer: ") +
+      (wheel.cancel(doomed) ? "ok" : "too late"));
+
+  fifth.get();
+  say(std::string("heartbeat ran 5 times, cancel: ") +
+      (wheel.cancel(heartbeat) ? "ok" : "too late"));
+  one_shots.wait();
+  std::cout << "pending timers: " << wheel.pending() << "\n";
+}
 
+// The usual alternative: a min-heap by deadline under a mutex (like
+// TimerService), with lazy cancellation: cancel() flags the id and the
+// entry is dropped when it reaches the top.
+class HeapTimerScheduler {
  public:
-  void deposit(int amount) {
-    std::lock_guard<std::mutex> lock(mtx);
-    balance += amount;
+  using Clock = std::chrono::steady_clock;
+
+  uint64_t schedule_after(Clock::duration delay, UniqueFunction task) {
+    const Clock::time_point deadline = Clock::now() + delay;
+    std::lock_guard<std::mutex> locker(mtx);
+    const uint64_t id = cancelled.size();
+    cancelled.push_back(false);
+    heap.push_back({deadline, id, std::move(task)});
+    std::push_heap(heap.begin(), heap.end(), Later{});
+    return id;
   }
 
-  int get_balance() {
-    std::lock_guard<std::mutex> lock(mtx);
-    return balance;
+  bool cancel(uint64_t id) {
+    std::lock_guard<std::mutex> locker(mtx);
+    if (id >= cancelled.size() || cancelled[id]) {
+      return false;
+    }
+    cancelled[id] = true;
+    return true;
   }
+
+  size_t heap_size() const { return heap.size(); }
+
+ private:
+  struct Entry {
+    Clock::time_point deadline;
+    uint64_t id;
+    UniqueFunction task;
+  };
+  struct Later {
+    bool operator()(const Entry& a, const Entry& b) const {
+      return a.deadline > b.deadline;
+    }
+  };
+
+  std::mutex mtx;
+  std::vector<Entry> heap;
+  std::vector<bool> cancelled;  // by id
 };
 
-void test_monitor_object_pattern() {
-  BankAccount account;
+// Insert 1M timers, cancel them all (in random order), then churn: with
+// 1M pending, cancel a random one and insert one, 1M times. Delays of
+// 10 s..10 min, so nothing fires while we measure.
+//
+// What to expect: the heap's cancel only flips a flag in a small bitmap,
+// the wheel's unlinks the node and frees it, touching its neighbours in a
+// node array of ~100 MB; so per call the heap wins at cancelling. But its
+// cancelled entries stay until their deadline (3M entries for 1M live
+// timers after the churn below), each later costing an O(log n) pop,
+// while the wheel holds exactly the pending timers and fires each in O(1).
+template <typename Scheduler>
+void benchmark_timer_scheduler(const char* name, Scheduler& scheduler) {
+  constexpr size_t n = 1'000'000;
+  std::vector<uint64_t> delays_ms(2 * n);
+  uint64_t rng = 11;
+  for (auto& d : delays_ms) {
+    rng = rng * 6364136223846793005ull + 1442695040888963407ull;  // LCG
+    d = 10'000 + (rng >> 33) % 590'000;
+  }
+  auto delay = [&](size_t i) {
+    return std::chrono::milliseconds(delays_ms[i]);
+  };
+  auto noop = [] {};
 
-  std::thread t1([&] {
-    for (int i = 0; i < 10000; ++i) {
-      account.deposit(1);
+  std::vector<uint64_t> ids(n);
+  const double insert_ms = time_ms([&] {
+    for (size_t i = 0; i < n; ++i) {
+      ids[i] = scheduler.schedule_after(delay(i), noop);
     }
   });
+  const double cancel_ms = time_ms([&] {
+    for (size_t i = 0; i < n; ++i) scheduler.cancel(ids[(i * 7919) % n]);
+  });
 
-  std::thread t2([&] {
-    for (int i = 0; i < 10000; ++i) {
-      account.deposit(1);
+  for (size_t i = 0; i < n; ++i) {
+    ids[i] = scheduler.schedule_after(delay(i), noop);
+  }
+  const double churn_ms = time_ms([&] {
+    for (size_t i = 0; i < n; ++i) {
+      rng = rng * 6364136223846793005ull + 1442695040888963407ull;
+      const size_t victim = (rng >> 33) % n;
+      scheduler.cancel(ids[victim]);
+      ids[victim] = scheduler.schedule_after(delay(n + i), noop);
     }
   });
 
-  t1.join();
-  t2.join();
-
-  std::cout << "Account balance: " << account.get_balance() << "\n";
+  std::cout << name << ": insert " << insert_ms * 1e6 / n << " ns, cancel "
+            << cancel_ms * 1e6 / n << " ns, insert+cancel at 1M pending "
+            << churn_ms * 1e6 / n << " ns\n";
 }
 
-// ------------
-// Design Pattern: Barrier Pattern
-// ------------
-void test_barrier_pattern() {
-  constexpr int num_workers = 4;
-
-  std::barrier sync(num_workers);
-
-  std::vector<std::thread> workers;
-
-  for (int i = 0; i < num_workers; ++i) {
-    workers.emplace_back([&, i] {
-      std::cout << i << " finished phase 1\n";
-
-      sync.arrive_and_wait();
-
-      std::cout << i << " starting phase 2\n";
-    });
+void benchmark_timer_wheel() {
+  ThreadPool pool(1);
+  {
+    TimerWheel wheel(pool);
+    benchmark_timer_scheduler("TimerWheel          ", wheel);
+    std::cout << "  pending after churn: " << wheel.pending() << "\n";
   }
-
-  for (auto& t : workers) {
-    t.join();
+  {
+    HeapTimerScheduler heap;
+    benchmark_timer_scheduler("priority queue (heap)", heap);
+    std::cout << "  heap entries after churn (cancelled ones stay): "
+              << heap.heap_size() << "\n";
   }
 }
 
 // ------------
-// Design Pattern: Read-Write Lock Pattern
+// Coroutine tasks
 // ------------
+Task<int> fetch_price(ThreadPool& pool, int id) {
+  co_await sleep_for(pool, std::chrono::milliseconds(10 * id));  // no thread held
+  co_return 100 + id;
+}
 
-class DataCache {
- private:
-  std::unordered_map<std::string, double> data;
-  mutable std::shared_mutex mtx;
+Task<int> sum_prices(ThreadPool& pool) {
+  co_await schedule_on(pool);
+  int total = 0;
+  for (int id = 1; id <= 3; ++id) {
+    total += co_await fetch_price(pool, id);
+  }
+  // a Future, awaited
+  total += co_await pool.submit(std::multiplies<int>{}, 4, 4);
+  co_return total;
+}
 
- public:
-  void update(const std::string& symbol, double price) {
-    std::unique_lock<std::shared_mutex> locker(mtx);
-    data[symbol] = price;
+Task<void> fail_on(ThreadPool& pool) {
+  co_await schedule_on(pool);
+  throw std::runtime_error("Exception from coroutine");
+}
+
+// Each level awaits the next: symmetric transfer, no thread switch.
+Task<int> coro_chain(int depth) {
+  if (depth == 0) {
+    co_return 0;
   }
+  co_return 1 + co_await coro_chain(depth - 1);
+}
 
-  double get(const std::string& symbol) const {
-    std::shared_lock<std::shared_mutex> locker(mtx);
+void test_coroutine_task() {
+  ThreadPool pool(2);
 
-    auto it = data.find(symbol);
+  std::cout << "sum of prices: " << sync_wait(sum_prices(pool))
+            << " (expected 322)\n";
 
-    return it == data.end() ? 0.0 : it->second;
+  try {
+    sync_wait(fail_on(pool));
+  } catch (const std::runtime_error& e) {
+    std::cout << "co_await rethrows: " << e.what() << "\n";
   }
-};
 
-void test_read_write_lock_pattern() {
-  DataCache cache;
+  std::cout << "chain of 1000 awaits: " << sync_wait(coro_chain(1000))
+            << "\n";
+}
 
-  cache.update("AAPL", 200);
+Task<int> coro_square(int x) { co_return x * x; }
 
-  std::vector<std::thread> readers;
-  for (int i = 0; i < 3; ++i) {
-    readers.emplace_back([&] { std::cout << cache.get("AAPL") << "\n"; });
+Task<int64_t> await_children(int n) {
+  int64_t sum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += co_await coro_square(i & 1023);
   }
+  co_return sum;
+}
 
-  for (auto& t : readers) {
-    t.join();
+Task<void> hop_on(ThreadPool& pool, int n) {
+  for (int i = 0; i < n; ++i) {
+    co_await schedule_on(pool);
   }
 }
 
-int run() {
-  std::cout << "=== Thread ===\n";
-  test_thread();
-
-  std::cout << "=== Mutex & Lock guard ===\n";
-  test_mutex_and_lock_guard();
+// Same chain, but every level first moves to the pool.
+Task<int> coro_chain_on(ThreadPool& pool, int depth) {
+  co_await schedule_on(pool);
+  if (depth == 0) {
+    co_return 0;
+  }
+  co_return 1 + co_await coro_chain_on(pool, depth - 1);
+}
 
-  std::cout << "=== Condition Variable (Producer-Consumer Pattern) ===\n";
-  test_condition_variable();
+// The Future version: one shared state and one pool task per level. (The
+// blocking style, each level calling get() on the next, parks one worker
+// per level and deadlocks once the chain is deeper than the pool.)
+Future<int> future_chain(ThreadPool& pool, int depth) {
+  if (depth == 0) {
+    return pool.submit([] { return 0; });
+  }
+  return future_chain(pool, depth - 1).then([](int x) { return x + 1; });
+}
+
+void benchmark_coroutines() {
+  ThreadPool pool(2);
+  auto per_op = [](double ms, double ops) { return ms * 1e6 / ops; };
+
+  const int n = 1'000'000;
+  int64_t sum = 0;
+  double ms = time_ms([&] { sum = sync_wait(await_children(n)); });
+  std::cout << "co_await a child Task (frame + 2 transfers): "
+            << per_op(ms, n) << " ns\n";
+  volatile int64_t sink = sum;
+  (void)sink;
+
+  const int hops = 100'000;
+  ms = time_ms([&] { sync_wait(hop_on(pool, hops)); });
+  std::cout << "co_await schedule_on(pool):                  "
+            << per_op(ms, hops) << " ns\n";
+  ms = time_ms([&] {
+    for (int i = 0; i < hops; ++i) pool.submit([] {}).get();
+  });
+  std::cout << "pool.submit(...).get() round trip:           "
+            << per_op(ms, hops) << " ns\n";
+
+  const int depth = 1000, reps = 200;
+  std::cout << "call chain of depth " << depth << " (ns per level)\n";
+  int result = 0;
+  ms = time_ms([&] {
+    for (int r = 0; r < reps; ++r) result += sync_wait(coro_chain(depth));
+  });
+  std::cout << "Task, symmetric transfer:    " << per_op(ms, depth * reps)
+            << "\n";
+  ms = time_ms([&] {
+    for (int r = 0; r < reps; ++r) {
+      result += sync_wait(coro_chain_on(pool, depth));
+    }
+  });
+  std::cout << "Task, schedule_on per level: " << per_op(ms, depth * reps)
+            << "\n";
+  ms = time_ms([&] {
+    for (int r = 0; r < reps; ++r) result += future_chain(pool, depth).get();
+  });
+  std::cout << "Future + then per level:     " << per_op(ms, depth * reps)
+            << (result == 3 * depth * reps ? "" : " (WRONG)") << "\n";
+}
+
+// ------------
+// Generator pipelines
+// ------------
+Generator<std::string_view> lines_of(std::string_view text) {
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    co_yield text.substr(0, end);
+    text = end == std::string_view::npos ? "" : text.substr(end + 1);
+  }
+}
+
+// "SYMBOL,price" -> price
+int64_t parse_price(std::string_view line) {
+  int64_t price = 0;
+  std::string_view field = line.substr(line.find(',') + 1);
+  std::from_chars(field.data(), field.data() + field.size(), price);
+  return price;
+}
+
+// The same stages as coroutines, each pulling from the previous one.
+Generator<int64_t> prices_of(Generator<std::string_view> lines) {
+  for (std::string_view line : lines) {
+    co_yield parse_price(line);
+  }
+}
+
+Generator<int64_t> multiples_of_3(Generator<int64_t> prices) {
+  for (int64_t p : prices) {
+    if (p % 3 == 0) co_yield p;
+  }
+}
+
+Generator<int> count_up(int n) {
+  for (int i = 0; i < n; ++i) co_yield i;
+}
+
+// |depth| generators around count_up, each passing elements on either with
+// elements_of or by re-yielding them one by one.
+Generator<int> nested(int depth, int n, bool delegate) {
+  if (depth == 0) {
+    co_yield elements_of(count_up(n));
+  } else if (delegate) {
+    co_yield elements_of(nested(depth - 1, n, delegate));
+  } else {
+    for (int x : nested(depth - 1, n, delegate)) co_yield x;
+  }
+}
+
+// Bytes malloc has handed out and not yet taken back (glibc only).
+std::optional<size_t> heap_in_use() {
+#if defined(__GLIBC__)
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;  // small blocks + mmap'ed large ones
+#else
+  return std::nullopt;
+#endif
+}
+
+void benchmark_generator() {
+  const size_t num_lines = 5'000'000;
+  std::string text;
+  for (size_t i = 0; i < num_lines; ++i) {
+    text += "SYM" + std::to_string(i % 1000) + "," +
+            std::to_string(100 + i % 9973) + "\n";
+  }
+  std::cout << num_lines << " lines (" << text.size() / 1'000'000
+            << " MB): split -> parse -> keep multiples of 3 -> sum\n";
+  std::cout << "pipeline | ms | extra heap at peak (MB) | sum\n";
+
+  auto print = [](const char* name, double ms, std::optional<size_t> before,
+                  std::optional<size_t> peak, int64_t sum) {
+    std::cout << name << " | " << ms << " | ";
+    if (before && peak) {
+      std::cout << double(*peak - *before) / 1e6;
+    } else {
+      std::cout << "n/a";
+    }
+    std::cout << " | " << sum << "\n";
+  };
+
+  // Each run on a fresh thread: generator frames come from that thread's
+  // (empty) FrameAllocator cache, so they show up as heap.
+  auto run = [](auto&& fn) { std::thread(fn).join(); };
+
+  run([&] {
+    int64_t sum = 0;
+    std::optional<size_t> before = heap_in_use(), peak;
+    double ms = time_ms([&] {
+      std::vector<std::string_view> lines;
+      for (size_t pos = 0; pos < text.size();) {
+        size_t end = text.find('\n', pos);
+        lines.push_back(std::string_view(text).substr(pos, end - pos));
+        pos = end + 1;
+      }
+      std::vector<int64_t> prices;
+      for (std::string_view line : lines) prices.push_back(parse_price(line));
+      std::vector<int64_t> kept;
+      for (int64_t p : prices) {
+        if (p % 3 == 0) kept.push_back(p);
+      }
+      peak = heap_in_use();
+      for (int64_t p : kept) sum += p;
+    });
+    print("std::vector per stage", ms, before, peak, sum);
+  });
+
+  run([&] {
+    int64_t sum = 0;
+    std::optional<size_t> before = heap_in_use(), peak;
+    double ms = time_ms([&] {
+      size_t i = 0;
+      for (int64_t p : lines_of(text) | std::views::transform(parse_price) |
+                           std::views::filter([](int64_t p) {
+                             return p % 3 == 0;
+                           })) {
+        if (++i == num_lines / 6) peak = heap_in_use();
+        sum += p;
+      }
+    });
+    print("Generator | views", ms, before, peak, sum);
+  });
+
+  run([&] {
+    int64_t sum = 0;
+    std::optional<size_t> before = heap_in_use(), peak;
+    double ms = time_ms([&] {
+      size_t i = 0;
+      for (int64_t p : multiples_of_3(prices_of(lines_of(text)))) {
+        if (++i == num_lines / 6) peak = heap_in_use();
+        sum += p;
+      }
+    });
+    print("Generator per stage", ms, before, peak, sum);
+  });
+
+  const int n = 200'000;
+  std::cout << "nested generators, ns per element\n";
+  std::cout << "depth | elements_of | re-yield loop\n";
+  for (int depth : {1, 8, 64}) {
+    int64_t sum = 0;
+    double delegated = time_ms([&] {
+      for (int x : nested(depth, n, true)) sum += x;
+    });
+    double reyielded = time_ms([&] {
+      for (int x : nested(depth, n, false)) sum += x;
+    });
+    std::cout << depth << " | " << delegated * 1e6 / n << " | "
+              << reyielded * 1e6 / n
+              << (sum == int64_t(n) * (n - 1) ? "" : " (WRONG)") << "\n";
+  }
+}
+
+// ------------
+// Task graph
+// ------------
+void test_task_graph() {
+  ThreadPool pool(3);
+  std::mutex print_mtx;
+  auto say = [&](const std::string& what) {
+    std::lock_guard<std::mutex> lock(print_mtx);
+    std::cout << what << "\n";
+  };
+
+  TaskGraph graph;
+  auto prices = graph.emplace([&] { say("fetch prices"); });
+  auto positions = graph.emplace([&] { say("fetch positions"); });
+  auto merge = graph.emplace([&] { say("merge (after both fetches)"); });
+  graph.precede(prices, merge);
+  graph.precede(positions, merge);
+
+  // check -> retry? -> check ... until it passes, then report
+  int attempts = 0;
+  auto check = graph.emplace(
+      [&] { say("risk check, attempt " + std::to_string(++attempts)); });
+  auto retry = graph.emplace_condition([&]() -> size_t {
+    return attempts < 3 ? 0 : 1;  // index into retry's successors
+  });
+  auto report = graph.emplace_subflow([&](TaskGraph& sub) {
+    for (int part = 1; part <= 3; ++part) {  // decided at run time
+      sub.emplace([&, part] { say("report part " + std::to_string(part)); });
+    }
+  });
+  graph.precede(merge, check);
+  graph.precede(check, retry);
+  graph.precede(retry, check);   // successor 0
+  graph.precede(retry, report);  // successor 1
+
+  graph.run(pool);
+
+  std::cout << "--- same graph, second run ---\n";
+  attempts = 2;
+  graph.run(pool);
+
+  // A fresh graph each time, destroyed as soon as run() returns: the
+  // worker that finished the last leaf may still be notifying the waiter.
+  constexpr int kGraphs = 20000;
+  std::atomic<int> nodes_run{0};
+  auto count = [&] { nodes_run.fetch_add(1, std::memory_order_relaxed); };
+  for (int i = 0; i < kGraphs; ++i) {
+    TaskGraph fresh;
+    auto root = fresh.emplace(count);
+    for (int leaf = 0; leaf < 3; ++leaf) {
+      fresh.precede(root, fresh.emplace(count));
+    }
+    fresh.run(pool);
+  }
+  std::cout << "--- " << kGraphs << " fresh graphs: " << nodes_run.load()
+            << " nodes run (expected " << 4 * kGraphs << ") ---\n";
+}
+
+// Synthetic DAG: |levels| x |width| nodes; node (l, i) reads two nodes of
+// level l - 1 and burns a random 1..200 units of work, so levels are
+// uneven and a per-level barrier waits for the slowest node each time.
+struct SyntheticDag {
+  SyntheticDag(size_t levels, size_t width)
+      : levels(levels), width(width), cost(levels * width),
+        value(levels * width) {
+    uint64_t rng = 5;
+    for (auto& c : cost) {
+      rng = rng * 6364136223846793005ull + 1442695040888963407ull;  // LCG
+      c = 1 + uint32_t((rng >> 33) % 200);
+    }
+  }
+
+  size_t other_input(size_t i) const { return (i * 7 + 3) % width; }
+
+  void compute(size_t l, size_t i) {
+    uint64_t x = l == 0 ? i : value[(l - 1) * width + i] ^
+                                  value[(l - 1) * width + other_input(i)];
+    for (uint32_t k = 0; k < cost[l * width + i]; ++k) {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    value[l * width + i] = x;
+  }
+
+  size_t levels, width;
+  std::vector<uint32_t> cost;
+  std::vector<uint64_t> value;
+};
+
+void benchmark_task_graph() {
+  ThreadPool pool(3);  // + the calling thread
+
+  struct Shape {
+    const char* name;
+    size_t levels, width;
+  };
+  for (Shape shape : {Shape{"wide", 16, 4096}, Shape{"deep", 2048, 8}}) {
+    SyntheticDag dag(shape.levels, shape.width);
+    std::cout << shape.name << ": " << shape.levels << " levels x "
+              << shape.width << " nodes\n";
+
+    double ms = time_ms([&] {
+      for (size_t l = 0; l < dag.levels; ++l) {
+        for (size_t i = 0; i < dag.width; ++i) dag.compute(l, i);
+      }
+    });
+    const std::vector<uint64_t> expected = dag.value;
+    std::cout << "serial:                  " << ms << " ms\n";
+
+    auto check = [&] { return dag.value == expected ? "" : " (WRONG)"; };
+
+    std::fill(dag.value.begin(), dag.value.end(), 0);
+    ms = time_ms([&] {
+      for (size_t l = 0; l < dag.levels; ++l) {
+        parallel_for(pool, std::views::iota(size_t{0}, dag.width), 1,
+                     [&](size_t i) { dag.compute(l, i); });
+      }
+    });
+    std::cout << "barrier per level:       " << ms << " ms" << check() << "\n";
+
+    TaskGraph graph;
+    ms = time_ms([&] {
+      for (size_t l = 0; l < dag.levels; ++l) {
+        for (size_t i = 0; i < dag.width; ++i) {
+          graph.emplace([&dag, l, i] { dag.compute(l, i); });
+          if (l > 0) {
+            auto id = TaskGraph::NodeId(l * dag.width + i);
+            graph.precede(id - dag.width, id);
+            if (dag.other_input(i) != i) {
+              graph.precede(
+                  TaskGraph::NodeId((l - 1) * dag.width + dag.other_input(i)),
+                  id);
+            }
+          }
+        }
+      }
+    });
+    std::cout << "TaskGraph build:         " << ms << " ms\n";
+
+    for (int run = 1; run <= 2; ++run) {
+      std::fill(dag.value.begin(), dag.value.end(), 0);
+      ms = time_ms([&] { graph.run(pool); });
+      std::cout << "TaskGraph run " << run << ":         " << ms << " ms"
+                << check() << "\n";
+    }
+  }
+}
+
+// ------------
+// Design Pattern: Monitor Object Pattern
+// ------------
+class BankAccount {
+ private:
+  int balance = 0;
+  std::mutex mtx;
+
+ public:
+  void deposit(int amount) {
+    std::lock_guard<std::mutex> lock(mtx);
+    balance += amount;
+  }
+
+  int get_balance() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return balance;
+  }
+
+  // Both locks at once (std::scoped_lock orders them), so two opposite
+  // transfers cannot deadlock. Fails without funds.
+  static bool transfer(BankAccount& from, BankAccount& to, int amount) {
+    if (&from == &to) {
+      return true;
+    }
+    std::scoped_lock lock(from.mtx, to.mtx);
+    if (from.balance < amount) {
+      return false;
+    }
+    from.balance -= amount;
+    to.balance += amount;
+    return true;
+  }
+};
+
+void test_monitor_object_pattern() {
+  BankAccount account;
+
+  std::thread t1([&] {
+    for (int i = 0; i < 10000; ++i) {
+      account.deposit(1);
+    }
+  });
+
+  std::thread t2([&] {
+    for (int i = 0; i < 10000; ++i) {
+      account.deposit(1);
+    }
+  });
+
+  t1.join();
+  t2.join();
+
+  std::cout << "Account balance: " << account.get_balance() << "\n";
+}
+
+// ------------
+// Sharded ledger
+// ------------
+void test_ledger() {
+  Ledger ledger(8, 4);  // accounts 0..7 over 4 owner threads
+
+  for (AccountId id = 0; id < 8; ++id) {
+    ledger.deposit(id, 100000);
+  }
+
+  // two clients passing money around the ring 0 -> 1 -> ... -> 7 -> 0, in
+  // batches of 16; most transfers cross shards
+  std::vector<std::thread> clients;
+  for (int c = 0; c < 2; ++c) {
+    clients.emplace_back([&ledger, c] {
+      LedgerClient client(ledger, 16);
+      for (int i = 0; i < 10000; ++i) {
+        AccountId from = (i + c) % 8;
+        client.transfer(from, (from + 1) % 8, 1 + i % 5);
+      }
+    });
+  }
+
+  // a cut taken while transfers are in flight still adds up
+  LedgerSnapshot during = ledger.snapshot();
+  for (auto& t : clients) t.join();
+  ledger.transfer(0, 1, 1'000'000);  // more than account 0 has: rejected
+  LedgerSnapshot after = ledger.snapshot();
+
+  std::cout << "total during: " << during.total()
+            << ", after: " << after.total() << " (expected 800000)\n";
+  std::cout << "applied: " << after.applied
+            << ", rejected for funds: " << after.rejected << "\n";
+  for (AccountId id = 0; id < 8; ++id) {
+    std::cout << "account " << id << ": " << after.balance(id) << "\n";
+  }
+}
+
+// |num_threads| clients run the same random mix (80% transfers, 20%
+// deposits) over |num_accounts| accounts, against one BankAccount per
+// account (a mutex each) and against Ledger. Latency is sampled every
+// 1024th operation: for BankAccount the call, for Ledger from submission
+// to application by the owning shard (so it includes client batching).
+void benchmark_ledger_with(size_t num_accounts,
+                           int num_threads,
+                           size_t ops_per_thread) {
+  struct Request {
+    uint32_t from;
+    uint32_t to;
+    int32_t amount;
+    bool transfer;
+  };
+  std::vector<std::vector<Request>> requests(num_threads);
+  for (int t = 0; t < num_threads; ++t) {
+    uint64_t rng = 17 + t;
+    auto next = [&rng] {
+      rng = rng * 6364136223846793005ull + 1442695040888963407ull;  // LCG
+      return rng >> 33;
+    };
+    requests[t].reserve(ops_per_thread);
+    for (size_t i = 0; i < ops_per_thread; ++i) {
+      uint32_t from = uint32_t(next() % num_accounts);
+      uint32_t to = uint32_t(next() % num_accounts);
+      requests[t].push_back(
+          {from, to, int32_t(1 + next() % 100), next() % 5 != 0});
+    }
+  }
+  int64_t deposited = 0;
+  for (auto& thread_requests : requests) {
+    for (const Request& r : thread_requests) {
+      if (!r.transfer) deposited += r.amount;
+    }
+  }
+  const int64_t expected = int64_t(num_accounts) * 100 + deposited;
+
+  constexpr size_t kSampleEvery = 1024;
+  const size_t samples_per_thread = ops_per_thread / kSampleEvery;
+  auto now_ns = [] {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  };
+  auto print = [&](const char* name, double ms, std::vector<int64_t>& lat,
+                   int64_t total) {
+    std::sort(lat.begin(), lat.end());
+    auto percentile = [&](double p) {
+      return lat[std::min(lat.size() - 1, size_t(p * lat.size()))];
+    };
+    std::cout << name << " | " << int64_t(num_threads * ops_per_thread / ms)
+              << " | " << percentile(0.5) << " | " << percentile(0.99)
+              << " | " << percentile(0.999) << " | "
+              << (total == expected ? "ok" : "MISMATCH") << "\n";
+  };
+
+  {
+    std::vector<BankAccount> accounts(num_accounts);
+    for (auto& a : accounts) a.deposit(100);
+
+    std::vector<int64_t> latencies(num_threads * samples_per_thread);
+    double ms = time_ms([&] {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+          int64_t* lat = &latencies[t * samples_per_thread];
+          for (size_t i = 0; i < ops_per_thread; ++i) {
+            const Request& r = requests[t][i];
+            const bool sampled = i % kSampleEvery == 0 &&
+                                 i / kSampleEvery < samples_per_thread;
+            int64_t start = sampled ? now_ns() : 0;
+            if (r.transfer) {
+              BankAccount::transfer(accounts[r.from], accounts[r.to],
+                                    r.amount);
+            } else {
+              accounts[r.to].deposit(r.amount);
+            }
+            if (sampled) lat[i / kSampleEvery] = now_ns() - start;
+          }
+        });
+      }
+      for (auto& t : threads) t.join();
+    });
+
+    int64_t total = 0;
+    for (auto& a : accounts) total += a.get_balance();
+    print("BankAccount (mutex each)", ms, latencies, total);
+  }
+
+  {
+    Ledger ledger(num_accounts);
+    {
+      LedgerClient client(ledger, 256);
+      for (AccountId id = 0; id < num_accounts; ++id) client.deposit(id, 100);
+    }
+    ledger.snapshot();  // initial deposits applied
+
+    std::vector<int64_t> submitted(num_threads * samples_per_thread);
+    std::vector<std::atomic<int64_t>> applied(submitted.size());
+    LedgerSnapshot result;
+    double ms = time_ms([&] {
+      std::vector<std::thread> threads;
+      for (int t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+          LedgerClient client(ledger);
+          const size_t base = t * samples_per_thread;
+          for (size_t i = 0; i < ops_per_thread; ++i) {
+            const Request& r = requests[t][i];
+            std::atomic<int64_t>* applied_at = nullptr;
+            if (i % kSampleEvery == 0 && i / kSampleEvery < samples_per_thread) {
+              submitted[base + i / kSampleEvery] = now_ns();
+              applied_at = &applied[base + i / kSampleEvery];
+            }
+            if (r.transfer) {
+              client.transfer(r.from, r.to, r.amount, applied_at);
+            } else {
+              client.deposit(r.to, r.amount, applied_at);
+            }
+          }
+        });
+      }
+      for (auto& t : threads) t.join();
+      result = ledger.snapshot();  // waits until everything is applied
+    });
+
+    std::vector<int64_t> latencies(submitted.size());
+    for (size_t i = 0; i < submitted.size(); ++i) {
+      latencies[i] = applied[i].load(std::memory_order_acquire) - submitted[i];
+    }
+    print("Ledger (sharded owners)", ms, latencies, result.total());
+  }
+}
+
+void benchmark_ledger() {
+  std::cout << "ledger: " << std::max(1u, std::thread::hardware_concurrency())
+            << " shard(s), 1M accounts, 80% transfers\n";
+  for (int num_threads : {1, 2, 4}) {
+    std::cout << num_threads << " client thread(s)\n";
+    std::cout << "design | ops/ms | p50 ns | p99 ns | p99.9 ns | money\n";
+    benchmark_ledger_with(1'000'000, num_threads, 1'000'000);
+  }
+}
+
+// ------------
+// Design Pattern: Barrier Pattern
+// ------------
+void test_barrier_pattern() {
+  constexpr int num_workers = 4;
+
+  std::barrier sync(num_workers);
+
+  std::vector<std::thread> workers;
+
+  for (int i = 0; i < num_workers; ++i) {
+    workers.emplace_back([&, i] {
+      std::cout << i << " finished phase 1\n";
+
+      sync.arrive_and_wait();
+
+      std::cout << i << " starting phase 2\n";
+    });
+  }
+
+  for (auto& t : workers) {
+    t.join();
+  }
+}
+
+// Many supersteps over partitioned data: 1-D heat equation, ends held at 0
+// and 100, relaxed (Jacobi) until nothing moves.
+void test_bsp_executor() {
+  BspExecutor bsp(4);
+  DoubleBuffer<double> cells(16, 0.0);
+  cells.current()[15] = cells.next()[15] = 100.0;  // fixed boundary
+
+  size_t steps = bsp.run(
+      100'000,
+      [&](size_t worker, size_t) {
+        auto [begin, end] = bsp.range(cells.size(), worker);
+        auto cur = cells.current();
+        auto next = cells.next();
+        double change = 0;
+        for (size_t i = std::max<size_t>(begin, 1);
+             i < std::min(end, cells.size() - 1); ++i) {
+          next[i] = (cur[i - 1] + cur[i + 1]) / 2;
+          change += std::abs(next[i] - cur[i]);
+        }
+        return change;
+      },
+      [&](size_t, double change) {
+        cells.swap();  // only thread running: safe
+        return change < 1e-9;
+      });
+
+  std::cout << "converged after " << steps << " supersteps:";
+  for (double c : cells.current()) std::cout << " " << std::lround(c);
+  std::cout << "\n";
+}
+
+// ------------
+// Design Pattern: Read-Write Lock Pattern
+// ------------
+
+// get() first asks a Bloom filter (bloom_filter.cpp) over the cached
+// symbols: unknown symbols, the common miss, are answered from one cache
+// line without taking the lock. When the map outgrows the filter, a filter
+// twice the size replaces it, as does load_snapshot(). Readers probe under
+// an epoch pin, so the replaced filter is retired to the epoch domain
+// (epoch_reclamation.cpp) and freed once no reader can still hold it.
+// DataCache(false) skips the filter, to compare.
+//
+// Symbols restored by load_snapshot() are not copied into the map: they
+// stay in the mapped snapshot file (|base|), found through a flat
+// open-addressing index of entry numbers, and only their prices are
+// copied, since update() changes them. Symbols first seen after the load
+// go into |data|; every symbol is in exactly one of the two.
+
+class DataCache {
+ private:
+  static constexpr size_t kInitialFilterItems = 1024;
+
+  std::unordered_map<std::string, double> data;
+  mutable std::shared_mutex mtx;
+  const bool use_filter;
+  std::atomic<BlockedBloomFilter*> filter{nullptr};  // owned
+
+  std::unique_ptr<SnapshotFile> base;
+  std::vector<double> base_prices;   // by entry
+  std::vector<uint32_t> base_index;  // entry + 1; 0: empty slot
+
+  // Caller holds the lock. Entry of |symbol| in |base|, or -1.
+  int64_t find_base(std::string_view symbol, uint64_t h) const {
+    if (base_index.empty()) {
+      return -1;
+    }
+    const size_t mask = base_index.size() - 1;
+    for (size_t i = h & mask;; i = (i + 1) & mask) {
+      const uint32_t e = base_index[i];
+      if (e == 0) {
+        return -1;
+      }
+      if (base->name(e - 1) == symbol) {
+        return e - 1;
+      }
+    }
+  }
+
+  // Caller holds the lock. Calls |fn(symbol, price)| for every symbol.
+  template <typename Fn>
+  void for_each_entry(Fn&& fn) const {
+    for (const auto& [symbol, price] : data) {
+      fn(std::string_view(symbol), price);
+    }
+    for (size_t i = 0; i < base_prices.size(); ++i) {
+      fn(base->name(i), base_prices[i]);
+    }
+  }
+
+  // Caller holds the write lock. Adds a symbol about to be inserted into
+  // |data|: first into the filter, so a get() that finds it in the map
+  // also passed the filter.
+  void add_to_filter(std::string_view symbol) {
+    if (!use_filter) {
+      return;
+    }
+    BlockedBloomFilter* current = filter.load(std::memory_order_relaxed);
+    const size_t size = data.size() + base_prices.size();
+    if (size + 1 > current->capacity()) {
+      current = new BlockedBloomFilter(2 * (size + 1));
+      for_each_entry([current](std::string_view name, double) {
+        current->insert(BlockedBloomFilter::hash(name));
+      });
+      publish_filter(current);
+    }
+    current->insert(BlockedBloomFilter::hash(symbol));
+  }
+
+  // Caller holds the write lock.
+  void publish_filter(BlockedBloomFilter* next) {
+    BlockedBloomFilter* old = filter.exchange(next, std::memory_order_seq_cst);
+    if (old) {
+      epoch_domain().retire(old);
+    }
+  }
+
+ public:
+  explicit DataCache(bool use_filter = true) : use_filter(use_filter) {
+    if (use_filter) {
+      publish_filter(new BlockedBloomFilter(kInitialFilterItems));
+    }
+  }
+
+  ~DataCache() { delete filter.load(std::memory_order_relaxed); }
+
+  DataCache(const DataCache&) = delete;
+  DataCache& operator=(const DataCache&) = delete;
+
+  void update(const std::string& symbol, double price) {
+    std::unique_lock<std::shared_mutex> locker(mtx);
+
+    auto it = data.find(symbol);
+    if (it != data.end()) {
+      it->second = price;
+      return;
+    }
+    if (!base_index.empty()) {
+      const int64_t e = find_base(symbol, BlockedBloomFilter::hash(symbol));
+      if (e >= 0) {
+        base_prices[e] = price;
+        return;
+      }
+    }
+    add_to_filter(symbol);
+    data.emplace(symbol, price);
+  }
+
+  double get(const std::string& symbol) const {
+    const uint64_t h = use_filter ? BlockedBloomFilter::hash(symbol) : 0;
+    if (use_filter) {
+      auto guard = epoch_domain().pin();
+      if (!filter.load(std::memory_order_seq_cst)->may_contain(h)) {
+        return 0.0;
+      }
+    }
+
+    std::shared_lock<std::shared_mutex> locker(mtx);
+
+    auto it = data.find(symbol);
+    if (it != data.end()) {
+      return it->second;
+    }
+    if (base_index.empty()) {
+      return 0.0;
+    }
+    const int64_t e =
+        find_base(symbol, use_filter ? h : BlockedBloomFilter::hash(symbol));
+    return e < 0 ? 0.0 : base_prices[e];
+  }
+
+  size_t size() const {
+    std::shared_lock<std::shared_mutex> locker(mtx);
+    return data.size() + base_prices.size();
+  }
+
+  // Writes the contents to |path| (snapshot.cpp). The shared lock is held
+  // only while the entries are copied out; sorting and the file write run
+  // after it is released, so writers wait for one pass over the map.
+  void save_snapshot(const std::string& path) const {
+    SnapshotImage image;
+    {
+      std::shared_lock<std::shared_mutex> locker(mtx);
+      image.entries.reserve(data.size() + base_prices.size());
+      for_each_entry([&image](std::string_view symbol, double price) {
+        add_snapshot_entry(image, symbol, price);
+      });
+    }
+    sort_snapshot_image(image);
+    write_snapshot(path, image);
+  }
+
+  // Replaces the contents with the snapshot at |path|, which stays mapped
+  // and backs the restored symbols (save_snapshot() to the same path is
+  // fine: it renames a new file over it, the mapping keeps the old one).
+  // Per entry, one pass hashes the name into the index and the filter and
+  // copies the price: no string or node is allocated. All of it happens
+  // before taking the lock; readers keep the old contents until the swap.
+  void load_snapshot(const std::string& path) {
+    auto snapshot = std::make_unique<SnapshotFile>(path);
+    const size_t n = snapshot->size();
+    if (n >= std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error("snapshot has too many entries");
+    }
+
+    std::vector<double> prices(n);
+    std::vector<uint32_t> index(n ? std::bit_ceil(2 * n) : 0);  // load <= 1/2
+    BlockedBloomFilter* fresh =
+        use_filter
+            ? new BlockedBloomFilter(std::max(2 * n, kInitialFilterItems))
+            : nullptr;
+    for (size_t e = 0; e < n; ++e) {
+      const uint64_t h = BlockedBloomFilter::hash(snapshot->name(e));
+      size_t i = h & (index.size() - 1);
+      while (index[i] != 0) i = (i + 1) & (index.size() - 1);
+      index[i] = uint32_t(e + 1);
+      prices[e] = snapshot->price(e);
+      if (fresh) fresh->insert(h);
+    }
+    snapshot->advise_random();  // lookups from now on
+
+    std::unordered_map<std::string, double> old_data;
+    {
+      std::unique_lock<std::shared_mutex> locker(mtx);
+      if (fresh) {
+        // before the contents: a get() that finds a symbol passed the filter
+        publish_filter(fresh);
+      }
+      data.swap(old_data);
+      base.swap(snapshot);
+      base_prices.swap(prices);
+      base_index.swap(index);
+    }
+    // the old contents are released here, outside the lock
+  }
+};
+
+void test_read_write_lock_pattern() {
+  DataCache cache;
+
+  cache.update("AAPL", 200);
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 3; ++i) {
+    readers.emplace_back([&] { std::cout << cache.get("AAPL") << "\n"; });
+  }
+
+  for (auto& t : readers) {
+    t.join();
+  }
+
+  // RCU variant (rcu_data_cache.cpp): same calls, lock-free reads
+  RcuDataCache rcu_cache;
+  rcu_cache.update("AAPL", 200);
+  rcu_cache.update_batch(std::vector<RcuDataCache::Update>{{"MSFT", 410},
+                                                           {"NVDA", 120}});
+
+  readers.clear();
+  for (int i = 0; i < 3; ++i) {
+    readers.emplace_back([&] {
+      std::cout << rcu_cache.get("AAPL") + rcu_cache.get("MSFT") << "\n";
+    });
+  }
+
+  for (auto& t : readers) {
+    t.join();
+  }
+
+  // sharded variant (sharded_data_cache.cpp): resolve symbols to ids once,
+  // then update/get by id without hashing strings
+  ShardedDataCache sharded_cache;
+  const SymbolId aapl = sharded_cache.intern("AAPL");
+  sharded_cache.update(aapl, 200);
+  sharded_cache.update_batch(std::vector<ShardedDataCache::Update>{
+      {"MSFT", 410}, {"NVDA", 120}});
+
+  readers.clear();
+  for (int i = 0; i < 3; ++i) {
+    readers.emplace_back([&] {
+      std::cout << sharded_cache.get(aapl) + sharded_cache.get("MSFT") << "\n";
+    });
+  }
+
+  for (auto& t : readers) {
+    t.join();
+  }
+}
+
+// |num_readers| threads call get() on 1000 symbols for |duration| while one
+// writer updates a price every 10us. Returns reads per ms over all readers.
+template <typename Cache>
+double measure_cache_reads(int num_readers,
+                           std::chrono::milliseconds duration) {
+  std::vector<std::string> symbols;
+  for (int i = 0; i < 1000; ++i) symbols.push_back("SYM" + std::to_string(i));
+
+  Cache cache;
+  for (auto& s : symbols) cache.update(s, 1.0);
+
+  std::atomic<bool> stop{false};
+  std::atomic<int64_t> total_reads{0};
+  std::atomic<double> checksum{0};  // keeps the reads from being optimized out
+
+  std::thread writer([&] {
+    for (size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+      cache.update(symbols[i % symbols.size()], double(i));
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }
+  });
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < num_readers; ++r) {
+    readers.emplace_back([&, r] {
+      int64_t reads = 0;
+      double sum = 0;
+      for (size_t i = r; !stop.load(std::memory_order_relaxed); i += 7) {
+        sum += cache.get(symbols[i % symbols.size()]);
+        ++reads;
+      }
+      total_reads.fetch_add(reads, std::memory_order_relaxed);
+      checksum.fetch_add(sum, std::memory_order_relaxed);
+    });
+  }
+
+  std::this_thread::sleep_for(duration);
+  stop.store(true, std::memory_order_relaxed);
+  writer.join();
+  for (auto& t : readers) t.join();
+
+  return double(total_reads.load()) / duration.count();
+}
+
+void benchmark_data_cache() {
+  const auto duration = std::chrono::milliseconds(200);
+
+  std::cout << "readers | DataCache (shared_mutex) | RcuDataCache  "
+               "(reads/ms, 1 writer)\n";
+  for (int num_readers : {1, 2, 4, 8}) {
+    double locked = measure_cache_reads<DataCache>(num_readers, duration);
+    double rcu = measure_cache_reads<RcuDataCache>(num_readers, duration);
+    std::cout << num_readers << "       | " << int64_t(locked) << " | "
+              << int64_t(rcu) << "\n";
+  }
+}
+
+// ------------
+// Tick replay
+// ------------
+//
+// Replays a recorded (here: generated) binary tick file into a DataCache,
+// paced at the recorded rate, to see how the cache behaves under a
+// realistic feed instead of a tight update() loop.
+
+void print_replay_report(const std::string& name, const ReplayReport& r) {
+  std::cout << name << ": " << r.updates << " updates in " << r.seconds
+            << " s, " << int64_t(r.updates_per_sec)
+            << " updates/s, latency ns p50=" << r.p50 << " p90=" << r.p90
+            << " p99=" << r.p99 << " p99.9=" << r.p999 << " max=" << r.max
+            << "\n";
+}
+
+void test_tick_replay() {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "mt_ticks_demo.bin").string();
+  write_tick_file(path, 20000, 50, 200'000);  // 0.1 s of ticks
+
+  {
+    TickFile file(path);
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < file.header().num_symbols; ++i) {
+      names.push_back("SYM" + std::to_string(i));
+    }
+
+    DataCache cache;
+    ReplayOptions options;
+    options.num_feeders = 2;
+    options.paced = true;
+    ReplayReport report = replay(file, options, [&](const TickRecord& tick) {
+      cache.update(names[tick.symbol], tick.price);
+    });
+
+    print_replay_report("paced, 2 feeders", report);
+    std::cout << "SYM0 last=" << cache.get("SYM0") << "\n";
+  }
+
+  std::filesystem::remove(path);
+}
+
+// ------------
+// Bloom filter
+// ------------
+//
+// BlockedBloomFilter (bloom_filter.cpp) in front of DataCache::get and
+// BoundedDataCache::get: unknown symbols are turned away before the lock.
+
+void test_bloom_filter() {
+  BlockedBloomFilter filter(1000);
+  for (int i = 0; i < 1000; ++i) {
+    filter.insert(BlockedBloomFilter::hash("SYM" + std::to_string(i)));
+  }
+
+  int false_positives = 0;
+  for (int i = 0; i < 100000; ++i) {
+    false_positives +=
+        filter.may_contain(BlockedBloomFilter::hash("UNK" + std::to_string(i)));
+  }
+  std::cout << "SYM42 maybe present: "
+            << filter.may_contain(BlockedBloomFilter::hash("SYM42"))
+            << ", false positives: " << false_positives << " / 100000 in "
+            << filter.memory_bytes() << " bytes\n";
+
+  DataCache cache;
+  for (int i = 0; i < 5000; ++i) {  // grows the filter a few times
+    cache.update("SYM" + std::to_string(i), i + 1);
+  }
+  std::cout << "SYM4999 " << cache.get("SYM4999") << ", UNK1 "
+            << cache.get("UNK1") << "\n";
+}
+
+// ------------
+// DataCache snapshots
+// ------------
+//
+// A DataCache saved to a snapshot file (snapshot.cpp) every so often comes
+// back warm after a restart instead of empty.
+
+void test_data_cache_snapshot() {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "mt_cache_demo.snap").string();
+
+  {
+    DataCache cache;
+    PeriodicSnapshot snapshots(std::chrono::milliseconds(10),
+                               [&] { cache.save_snapshot(path); });
+    cache.update("MSFT", 410);
+    cache.update("AAPL", 200);
+    std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    cache.update("GOOG", 170);
+    std::cout << "periodic saves so far: " << snapshots.saves() << "\n";
+  }  // final save on the way out
+
+  SnapshotFile file(path);
+  std::cout << "snapshot holds " << file.size() << " symbols, first "
+            << file.name(0) << ", GOOG " << file.find("GOOG").value_or(0)
+            << "\n";
+
+  DataCache restarted;
+  restarted.load_snapshot(path);
+  std::cout << "after restore: AAPL " << restarted.get("AAPL") << ", MSFT "
+            << restarted.get("MSFT") << ", GOOG " << restarted.get("GOOG")
+            << "\n";
+
+  std::filesystem::remove(path);
+}
+
+// ------------
+// Bounded DataCache
+// ------------
+//
+// BoundedDataCache (bounded_data_cache.cpp) caps the number of symbols and
+// evicts the ones not read recently (segmented CLOCK), optionally after a
+// TTL.
+
+void test_bounded_data_cache() {
+  BoundedDataCache cache(4, std::chrono::milliseconds(20), 1);
+
+  for (int i = 0; i < 4; ++i) cache.update("SYM" + std::to_string(i), i);
+  cache.get("SYM0");  // referenced: survives the next eviction
+  cache.update("SYM4", 4);
+
+  for (int i = 0; i < 5; ++i) {
+    double price;
+    std::string symbol = "SYM" + std::to_string(i);
+    std::cout << symbol << (cache.get(symbol, price) ? " hit" : " miss")
+              << (i < 4 ? ", " : "\n");
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  std::cout << "after the TTL: SYM0 " << cache.get("SYM0") << "\n";
+  cache.update("SYM5", 5);
+
+  auto stats = cache.stats();
+  std::cout << "hits=" << stats.hits << " misses=" << stats.misses
+            << " evictions=" << stats.evictions
+            << " expirations=" << stats.expirations << " size=" << stats.size
+            << "/" << cache.capacity() << "\n";
+}
+
+// ------------
+// Time-series DataCache
+// ------------
+//
+// TimeSeriesCache (tick_series.cpp) keeps the last ticks per symbol, so
+// readers can ask for VWAP / min / max over a window, not just the last
+// price. One feed thread appends, readers never lock.
+
+void test_time_series_cache() {
+  TimeSeriesCache cache(16, 1 << 12);
+  const SymbolId aapl = cache.intern("AAPL");
+  const int num_ticks = 100000;
+
+  std::atomic<bool> done{false};
+  std::thread feed([&] {
+    double price = 200;
+    for (int i = 0; i < num_ticks; ++i) {
+      price += ((i / 50) % 2 == 0) ? 0.01 : -0.01;
+      cache.append(aapl,
+                   {TimeSeriesCache::now_ns(), price, double(i % 10 + 1)});
+    }
+    done.store(true);
+  });
+
+  std::thread reader([&] {
+    int queries = 0;
+    bool ok = true;
+    while (!done.load()) {
+      WindowStats stats = cache.series(aapl)->last_n(1000);
+      ok &= stats.count == 0 || stats.min_price <= stats.vwap + 1e-9;
+      ok &= stats.count == 0 || stats.vwap <= stats.max_price + 1e-9;
+      ++queries;
+    }
+    std::cout << "reader: " << queries << " window queries during the feed, "
+              << (ok ? "all consistent" : "INCONSISTENT") << "\n";
+  });
+
+  feed.join();
+  reader.join();
+
+  const TickSeries& series = *cache.series(aapl);
+  WindowStats last100 = series.last_n(100);
+  WindowStats last_ms = series.last_duration(std::chrono::milliseconds(1),
+                                             TimeSeriesCache::now_ns());
+  std::cout << "AAPL last=" << cache.get("AAPL") << " history=" << series.size()
+            << "\nlast 100 ticks: min=" << last100.min_price
+            << " max=" << last100.max_price << " vwap=" << last100.vwap
+            << " volume=" << last100.volume
+            << "\nlast 1ms: " << last_ms.count << " ticks\n";
+}
+
+// Ingest rate of one feed thread, and latency of window aggregates against
+// the same loop over an array of Tick structs.
+void benchmark_time_series() {
+  const int num_symbols = 100;
+  const int num_ticks = 1 << 23;
+
+  TimeSeriesCache cache(num_symbols, 1 << 16);
+  std::vector<SymbolId> ids;
+  for (int i = 0; i < num_symbols; ++i) {
+    ids.push_back(cache.intern("SYM" + std::to_string(i)));
+  }
+
+  double ms = time_ms([&] {
+    for (int i = 0; i < num_ticks; ++i) {
+      cache.append(ids[i % num_symbols], {i, 100.0 + (i & 63), double(i & 7)});
+    }
+  });
+  std::cout << "append:        " << int64_t(num_ticks / ms * 1000)
+            << " ticks/s\n";
+
+  std::vector<Tick> batch(64);
+  ms = time_ms([&] {
+    for (int i = 0; i < num_ticks; i += 64) {
+      for (int j = 0; j < 64; ++j) {
+        batch[j] = {i + j, 100.0 + ((i + j) & 63), double(j & 7)};
+      }
+      cache.append_batch(ids[(i / 64) % num_symbols], batch);
+    }
+  });
+  std::cout << "append_batch:  " << int64_t(num_ticks / ms * 1000)
+            << " ticks/s\n";
+
+  // same data as an array of structs, aggregated with a plain loop
+  const TickSeries& series = *cache.series(ids[0]);
+  std::vector<Tick> aos(series.capacity());
+  for (size_t i = 0; i < aos.size(); ++i) {
+    aos[i] = {int64_t(i), 100.0 + (i & 63), double(i & 7)};
+  }
+
+  std::cout << "window | TickSeries::last_n | array of Tick  (ns per call)\n";
+  for (size_t window : {64, 1024, 16384}) {
+    const int reps = int((1 << 24) / window);
+    double checksum = 0;
+
+    double soa_ms = time_ms([&] {
+      for (int r = 0; r < reps; ++r) checksum += series.last_n(window).vwap;
+    });
+
+    double aos_ms = time_ms([&] {
+      for (int r = 0; r < reps; ++r) {
+        double volume = 0, notional = 0, lo = 1e300, hi = -1e300;
+        for (size_t i = aos.size() - window; i < aos.size(); ++i) {
+          volume += aos[i].size;
+          notional += aos[i].price * aos[i].size;
+          lo = std::min(lo, aos[i].price);
+          hi = std::max(hi, aos[i].price);
+        }
+        checksum += notional / volume + lo + hi;
+      }
+    });
+
+    volatile double sink = checksum;  // keeps both loops alive
+    (void)sink;
+    std::cout << window << " | " << soa_ms * 1e6 / reps << " | "
+              << aos_ms * 1e6 / reps << "\n";
+  }
+}
+
+// Replays a generated tick file into DataCache and ShardedDataCache while
+// two reader threads query them: as fast as possible for the sustained
+// update rate, then paced for the latency at a fixed arrival rate.
+template <typename Cache, typename Update>
+ReplayReport replay_under_reads(const TickFile& file,
+                                const ReplayOptions& options,
+                                const std::vector<std::string>& names,
+                                Cache& cache,
+                                Update update) {
+  std::atomic<bool> stop{false};
+  std::atomic<double> checksum{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; ++r) {
+    readers.emplace_back([&, r] {
+      double sum = 0;
+      for (uint32_t i = r; !stop.load(std::memory_order_relaxed); i += 7) {
+        sum += cache.get(names[i % names.size()]);
+      }
+      checksum.fetch_add(sum, std::memory_order_relaxed);
+    });
+  }
+
+  ReplayReport report = replay(file, options, [&](const TickRecord& tick) {
+    update(cache, tick);
+  });
+
+  stop.store(true, std::memory_order_relaxed);
+  for (auto& t : readers) t.join();
+  return report;
+}
+
+void benchmark_tick_replay() {
+  const auto dir = std::filesystem::temp_directory_path();
+  const std::string burst_path = (dir / "mt_ticks_burst.bin").string();
+  const std::string paced_path = (dir / "mt_ticks_paced.bin").string();
+  write_tick_file(burst_path, 2'000'000, 1000, 1e6);
+  write_tick_file(paced_path, 200'000, 1000, 1e6);  // 0.2 s at 1M ticks/s
+
+  std::vector<std::string> names;
+  for (int i = 0; i < 1000; ++i) names.push_back("SYM" + std::to_string(i));
+
+  auto run = [&](const std::string& path, ReplayOptions options) {
+    TickFile file(path);
+    std::string mode = (options.paced ? "paced, " : "max rate, ") +
+                       std::to_string(options.num_feeders) + " feeder(s)";
+
+    DataCache locked;
+    print_replay_report(
+        "DataCache        " + mode,
+        replay_under_reads(file, options, names, locked,
+                           [&](DataCache& c, const TickRecord& t) {
+                             c.update(names[t.symbol], t.price);
+                           }));
+
+    ShardedDataCache sharded;
+    std::vector<SymbolId> ids;
+    for (auto& name : names) ids.push_back(sharded.intern(name));
+    print_replay_report(
+        "ShardedDataCache " + mode,
+        replay_under_reads(file, options, names, sharded,
+                           [&](ShardedDataCache& c, const TickRecord& t) {
+                             c.update(ids[t.symbol], t.price);
+                           }));
+  };
+
+  for (int num_feeders : {1, 2, 4}) {
+    run(burst_path, {num_feeders, false});
+  }
+  run(paced_path, {1, true});
+  run(paced_path, {2, true});
+
+  std::filesystem::remove(burst_path);
+  std::filesystem::remove(paced_path);
+}
+
+// |count| key indices in [0, num_keys), Zipf-distributed with exponent
+// |s|: key k is drawn with probability proportional to 1 / (k + 1)^s.
+std::vector<uint32_t> zipf_keys(size_t num_keys,
+                                double s,
+                                size_t count,
+                                uint64_t seed) {
+  std::vector<double> cdf(num_keys);
+  double sum = 0;
+  for (size_t k = 0; k < num_keys; ++k) {
+    sum += 1.0 / std::pow(double(k + 1), s);
+    cdf[k] = sum;
+  }
+
+  std::vector<uint32_t> keys(count);
+  uint64_t rng = seed;
+  for (auto& key : keys) {
+    rng = rng * 6364136223846793005ull + 1442695040888963407ull;  // LCG
+    double u = double(rng >> 11) / double(uint64_t{1} << 53) * sum;
+    key = uint32_t(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+    key = std::min<uint32_t>(key, uint32_t(num_keys - 1));
+  }
+  return keys;
+}
+
+// False-positive rate against memory, then DataCache::get latency for
+// unknown and known symbols with and without the filter.
+void benchmark_bloom_filter() {
+  const int num_keys = 1'000'000;
+  std::vector<uint64_t> present, absent;
+  for (int i = 0; i < num_keys; ++i) {
+    present.push_back(BlockedBloomFilter::hash("SYM" + std::to_string(i)));
+    absent.push_back(BlockedBloomFilter::hash("UNK" + std::to_string(i)));
+  }
+
+  std::cout << "bits/key | memory | false positive rate\n";
+  for (double bits : {4.0, 6.0, 8.0, 10.0, 12.0, 16.0}) {
+    BlockedBloomFilter filter(num_keys, bits);
+    for (uint64_t h : present) filter.insert(h);
+    int false_positives = 0;
+    for (uint64_t h : absent) false_positives += filter.may_contain(h);
+    std::cout << bits << " | " << filter.memory_bytes() / 1024 << " KiB | "
+              << 100.0 * false_positives / num_keys << "%\n";
+  }
+
+  // the probe alone, hashes precomputed: a 16K-key filter (20 KiB) stays
+  // in L1/L2 and shows the compute; 512K keys (640 KiB) add cache misses
+  for (int keys : {1 << 14, 1 << 19}) {
+    BlockedBloomFilter filter(keys);
+    for (int i = 0; i < keys; ++i) filter.insert(present[i]);
+    const int probes = 1 << 24;
+    int found = 0;
+    double ms = time_ms([&] {
+      for (int i = 0; i < probes; ++i) {
+        found += filter.may_contain(absent[i & (keys - 1)]) +
+                 filter.may_contain(present[i & (keys - 1)]);
+      }
+    });
+    std::cout << "may_contain, " << keys << " keys: "
+              << ms * 1e6 / (2.0 * probes) << " ns/probe (" << found
+              << " maybe)\n";
+  }
+
+  const int num_symbols = 100'000;
+  std::vector<std::string> known, unknown;
+  for (int i = 0; i < num_symbols; ++i) {
+    known.push_back("SYM" + std::to_string(i));
+    unknown.push_back("UNK" + std::to_string(i));
+  }
+
+  std::cout << "threads | lookups | DataCache(false) | DataCache  "
+               "(ns per get)\n";
+  for (int num_threads : {1, 4}) {
+    for (bool hits : {false, true}) {
+      const auto& lookups = hits ? known : unknown;
+      double ns[2];
+      for (bool use_filter : {false, true}) {
+        DataCache cache(use_filter);
+        for (int i = 0; i < num_symbols; ++i) cache.update(known[i], i + 1);
+
+        const int rounds = 10;
+        std::atomic<double> checksum{0};
+        double ms = time_ms([&] {
+          std::vector<std::thread> threads;
+          for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&] {
+              double sum = 0;
+              for (int r = 0; r < rounds; ++r) {
+                for (const auto& symbol : lookups) sum += cache.get(symbol);
+              }
+              checksum.fetch_add(sum);
+            });
+          }
+          for (auto& t : threads) t.join();
+        });
+        ns[use_filter] = ms * 1e6 * num_threads / (rounds * num_symbols);
+      }
+      std::cout << num_threads << " | " << (hits ? "known" : "unknown")
+                << " | " << ns[0] << " | " << ns[1] << "\n";
+    }
+  }
+}
+
+// Warm restart of a DataCache with |num_symbols| symbols: refill through
+// update() vs load_snapshot() from a file in the page cache, and get() on
+// each: from the map, or through the index into the mapped file.
+void benchmark_data_cache_snapshot(size_t num_symbols) {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "mt_cache_bench.snap").string();
+
+  std::vector<std::string> symbols;
+  symbols.reserve(num_symbols);
+  for (size_t i = 0; i < num_symbols; ++i) {
+    symbols.push_back("SYM" + std::to_string(i));
+  }
+
+  // random known symbols
+  auto get_ns = [&](const DataCache& cache) {
+    const int lookups = 1'000'000;
+    double sum = 0;
+    uint64_t x = 1;
+    double ms = time_ms([&] {
+      for (int i = 0; i < lookups; ++i) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;  // LCG
+        sum += cache.get(symbols[(x >> 33) % num_symbols]);
+      }
+    });
+    volatile double sink = sum;
+    (void)sink;
+    return ms * 1e6 / lookups;
+  };
+
+  double save_ms = 0;
+  {
+    DataCache cache;
+    double rebuild_ms = time_ms([&] {
+      for (size_t i = 0; i < num_symbols; ++i) cache.update(symbols[i], i);
+    });
+    std::cout << "rebuild via update(): " << rebuild_ms << " ms, get() "
+              << get_ns(cache) << " ns\n";
+
+    // a writer keeps updating during the save: its slowest update() is
+    // about how long the save held the lock (plus, on a shared core, the
+    // time slices the save ran in)
+    std::atomic<bool> saving{true};
+    int64_t max_stall_ns = 0;
+    std::thread writer([&] {
+      using Clock = std::chrono::steady_clock;
+      for (size_t i = 0; saving.load(std::memory_order_relaxed); ++i) {
+        const Clock::time_point t0 = Clock::now();
+        cache.update(symbols[i % num_symbols], double(i));
+        max_stall_ns = std::max<int64_t>(max_stall_ns,
+                                         (Clock::now() - t0).count());
+      }
+    });
+    save_ms = time_ms([&] { cache.save_snapshot(path); });
+    saving.store(false, std::memory_order_relaxed);
+    writer.join();
+    std::cout << "save_snapshot:        " << save_ms << " ms, "
+              << std::filesystem::file_size(path) / (1 << 20)
+              << " MiB, slowest concurrent update() "
+              << max_stall_ns / 1'000'000 << " ms\n";
+  }
+
+  DataCache restored;
+  double load_ms = time_ms([&] { restored.load_snapshot(path); });
+  std::cout << "load_snapshot:        " << load_ms << " ms, "
+            << restored.size() << " symbols, get() " << get_ns(restored)
+            << " ns\n";
+
+  std::filesystem::remove(path);
+}
+
+// Read-through cache: |num_threads| threads look up Zipf-distributed
+// symbols and fill misses with update(). Returns {hit ratio, lookups/us}.
+template <typename Cache>
+std::pair<double, double> measure_read_through(
+    Cache& cache,
+    const std::vector<std::string>& symbols,
+    const std::vector<std::vector<uint32_t>>& keys) {
+  std::atomic<int64_t> hits{0}, lookups{0};
+
+  double ms = time_ms([&] {
+    std::vector<std::thread> threads;
+    for (auto& thread_keys : keys) {
+      threads.emplace_back([&] {
+        int64_t local_hits = 0;
+        for (uint32_t k : thread_keys) {
+          // prices are >= 1, so 0.0 means not cached
+          if (cache.get(symbols[k]) != 0.0) {
+            ++local_hits;
+          } else {
+            cache.update(symbols[k], k + 1.0);
+          }
+        }
+        hits.fetch_add(local_hits);
+        lookups.fetch_add(int64_t(thread_keys.size()));
+      });
+    }
+    for (auto& t : threads) t.join();
+  });
+
+  return {double(hits.load()) / lookups.load(), lookups.load() / ms / 1000};
+}
+
+// "+ scan": every 4th lookup instead reads the next of another 100k
+// symbols in order, each seen once per pass (a report walking the whole
+// universe). The scan cannot hit; it shows how much of the hot set it
+// pushes out.
+void benchmark_bounded_data_cache() {
+  const size_t num_keys = 100'000;
+  const size_t lookups_per_thread = 1'000'000;
+
+  std::vector<std::string> symbols;
+  for (size_t i = 0; i < 2 * num_keys; ++i) {  // upper half: scanned only
+    symbols.push_back("SYM" + std::to_string(i));
+  }
+
+  struct Workload {
+    double s;
+    bool scan;
+  };
+  for (Workload w : {Workload{0.8, false}, Workload{0.8, true},
+                     Workload{0.99, false}, Workload{0.99, true}}) {
+    for (int num_threads : {1, 4}) {
+      std::vector<std::vector<uint32_t>> keys;
+      for (int t = 0; t < num_threads; ++t) {
+        keys.push_back(zipf_keys(num_keys, w.s, lookups_per_thread, 7 + t));
+        for (size_t i = 3; w.scan && i < lookups_per_thread; i += 4) {
+          keys.back()[i] = uint32_t(num_keys + (t * 7919 + i / 4) % num_keys);
+        }
+      }
+      std::cout << "zipf s=" << w.s << (w.scan ? " + scan" : "") << ", "
+                << num_threads << " thread(s)\n";
+      std::cout << "cache | hit ratio | lookups/us\n";
+
+      DataCache unbounded;
+      auto [hit_ratio, rate] = measure_read_through(unbounded, symbols, keys);
+      std::cout << "DataCache (unbounded) | " << hit_ratio << " | " << rate
+                << "\n";
+
+      for (size_t capacity : {num_keys / 100, num_keys / 10}) {
+        BoundedDataCache bounded(capacity);
+        auto [hit_ratio, rate] = measure_read_through(bounded, symbols, keys);
+        std::cout << "BoundedDataCache(" << capacity << ") | " << hit_ratio
+                  << " | " << rate << "\n";
+      }
+    }
+  }
+}
+
+// |num_threads| threads each run |num_ops| operations on 1000 symbols, one
+// in |write_every| an update, the rest gets. |update| / |get| receive the
+// symbol index. Returns the elapsed ms.
+template <typename Update, typename Get>
+double run_mixed_cache_ops(int num_threads,
+                           int num_ops,
+                           int write_every,
+                           Update update,
+                           Get get) {
+  std::atomic<double> checksum{0};
+
+  return time_ms([&] {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back([&, t] {
+        double sum = 0;
+        uint32_t rng = 12345 + t;
+        for (int i = 0; i < num_ops; ++i) {
+          rng = rng * 1664525 + 1013904223;  // LCG
+          int symbol = (rng >> 8) % 1000;
+          if (i % write_every == 0) {
+            update(symbol, double(i));
+          } else {
+            sum += get(symbol);
+          }
+        }
+        checksum.fetch_add(sum, std::memory_order_relaxed);
+      });
+    }
+    for (auto& t : threads) t.join();
+  });
+}
+
+void benchmark_sharded_data_cache() {
+  const int num_ops = 1 << 18;
+
+  std::vector<std::string> symbols;
+  for (int i = 0; i < 1000; ++i) symbols.push_back("SYM" + std::to_string(i));
+
+  for (int write_every : {10, 2}) {
+    std::cout << "1 write per " << write_every << " ops, " << num_ops
+              << " ops per thread\n";
+    std::cout << "threads | DataCache | ShardedDataCache (strings) | "
+                 "ShardedDataCache (ids)\n";
+
+    for (int num_threads : {1, 2, 4, 8}) {
+      DataCache locked;
+      double locked_ms = run_mixed_cache_ops(
+          num_threads, num_ops, write_every,
+          [&](int s, double p) { locked.update(symbols[s], p); },
+          [&](int s) { return locked.get(symbols[s]); });
+
+      ShardedDataCache by_name;
+      double by_name_ms = run_mixed_cache_ops(
+          num_threads, num_ops, write_every,
+          [&](int s, double p) { by_name.update(symbols[s], p); },
+          [&](int s) { return by_name.get(symbols[s]); });
+
+      ShardedDataCache by_id;
+      std::vector<SymbolId> ids;
+      for (auto& symbol : symbols) ids.push_back(by_id.intern(symbol));
+      double by_id_ms = run_mixed_cache_ops(
+          num_threads, num_ops, write_every,
+          [&](int s, double p) { by_id.update(ids[s], p); },
+          [&](int s) { return by_id.get(ids[s]); });
+
+      std::cout << num_threads << "       | " << locked_ms << " ms | "
+                << by_name_ms << " ms | " << by_id_ms << " ms\n";
+    }
+  }
+
+  // 1000 updates per call: one lock per shard vs one update() each
+  ShardedDataCache cache;
+  std::vector<ConcurrentPriceMap::Entry> batch;
+  for (auto& symbol : symbols) batch.emplace_back(cache.intern(symbol), 1.0);
+
+  double single_ms = time_ms([&] {
+    for (int round = 0; round < 100; ++round) {
+      for (auto& [id, price] : batch) cache.update(id, price + round);
+    }
+  });
+  double batch_ms = time_ms([&] {
+    for (int round = 0; round < 100; ++round) cache.update_batch(batch);
+  });
+  std::cout << "100 x 1000 updates: update() " << single_ms
+            << " ms, update_batch() " << batch_ms << " ms\n";
+}
+
+int run() {
+  std::cout << "=== Thread ===\n";
+  test_thread();
+
+  std::cout << "=== Mutex & Lock guard ===\n";
+  test_mutex_and_lock_guard();
+
+  std::cout << "=== Condition Variable (Producer-Consumer Pattern) ===\n";
+  test_condition_variable();
+
+  std::cout << "=== Lock-free SPSC Ring Buffer ===\n";
+  test_spsc_queue();
+
+  std::cout << "=== Bounded MPMC Queue ===\n";
+  test_mpmc_queue();
+
+  std::cout << "=== Staged Pipeline ===\n";
+  test_pipeline();
 
   std::cout << "=== Deadlock ===\n";
   test_deadlock();
@@ -907,6 +4119,9 @@ int run() {
   std::cout << "=== Atomic and Memory Order Model ===\n";
   test_atomic_and_memory_order_model();
 
+  std::cout << "=== Lock-free Stack ===\n";
+  test_lock_free_stack();
+
   std::cout << "=== Promise and Future Pattern ===\n";
   test_promise_and_future();
   test_promise_and_future_exception();
@@ -920,15 +4135,130 @@ int run() {
   std::cout << "=== Thread Pool Pattern ===\n";
   test_thread_pool();
 
+  std::cout << "=== Thread Pool Lanes ===\n";
+  test_thread_pool_lanes();
+
+  std::cout << "=== Thread Pool Stats ===\n";
+  test_thread_pool_stats();
+
+  std::cout << "=== Timer Wheel ===\n";
+  test_timer_wheel();
+
+  std::cout << "=== Coroutine Tasks ===\n";
+  test_coroutine_task();
+
+  std::cout << "=== Task Graph ===\n";
+  test_task_graph();
+
   std::cout << "=== Monitor Object Pattern ===\n";
   test_monitor_object_pattern();
 
+  std::cout << "=== Sharded Ledger ===\n";
+  test_ledger();
+
   std::cout << "=== Barrier Pattern ===\n";
   test_barrier_pattern();
 
+  std::cout << "=== BSP Executor ===\n";
+  test_bsp_executor();
+
   std::cout << "=== Read-Write Lock Pattern ===\n";
   test_read_write_lock_pattern();
 
+  std::cout << "=== Bloom Filter ===\n";
+  test_bloom_filter();
+
+  std::cout << "=== DataCache Snapshots ===\n";
+  test_data_cache_snapshot();
+
+  std::cout << "=== Bounded DataCache ===\n";
+  test_bounded_data_cache();
+
+  std::cout << "=== Time-series DataCache ===\n";
+  test_time_series_cache();
+
+  std::cout << "=== Tick Replay ===\n";
+  test_tick_replay();
+
+  return 0;
+}
+
+int run_benchmarks() {
+  std::cout << "=== Thread Pool: fan-out/fan-in of 100k tasks ===\n";
+  benchmark_fan_out_fan_in(100'000);
+
+  std::cout << "=== Thread pool lanes: critical latency under bulk load ===\n";
+  benchmark_thread_pool_lanes();
+
+  std::cout << "=== Thread pool idle strategies: wake latency vs CPU ===\n";
+  benchmark_idle_strategies();
+
+  std::cout << "=== Thread pool affinity: pinned vs unpinned workers ===\n";
+  benchmark_thread_pool_affinity();
+
+  std::cout << "=== Timer wheel vs priority queue: 1M pending timers ===\n";
+  benchmark_timer_wheel();
+
+  std::cout << "=== Coroutine Task vs Future: suspend/resume, call chains ===\n";
+  benchmark_coroutines();
+
+  std::cout << "=== Generator pipelines vs materialized vectors ===\n";
+  benchmark_generator();
+
+  std::cout << "=== Task graph vs barrier per level ===\n";
+  benchmark_task_graph();
+
+  std::cout << "=== parallel_for / parallel_reduce ===\n";
+  benchmark_parallel_loops();
+
+  std::cout << "=== BSP executor: Jacobi and PageRank strong scaling ===\n";
+  benchmark_bsp();
+
+  std::cout << "=== SPSC ring buffer vs SafeQueue ===\n";
+  benchmark_spsc_queue();
+
+  std::cout << "=== MPMC queue vs mutex+deque ===\n";
+  benchmark_mpmc_queue();
+
+  std::cout << "=== Staged pipeline: backpressure from a slow stage ===\n";
+  benchmark_pipeline();
+
+  std::cout << "=== Lock-free stack vs mutex stack ===\n";
+  benchmark_lock_free_stack();
+
+  std::cout << "=== Locks: throughput and fairness ===\n";
+  benchmark_locks();
+
+  std::cout << "=== Reader-writer locks: read scalability ===\n";
+  benchmark_shared_locks();
+
+  std::cout << "=== Ledger vs per-account mutex ===\n";
+  benchmark_ledger();
+
+  std::cout << "=== ShardedCounter vs atomic fetch_add ===\n";
+  benchmark_sharded_counter();
+
+  std::cout << "=== DataCache: shared_mutex vs RCU reads ===\n";
+  benchmark_data_cache();
+
+  std::cout << "=== DataCache vs sharded map: mixed reads/writes ===\n";
+  benchmark_sharded_data_cache();
+
+  std::cout << "=== Bloom filter: false positives and DataCache misses ===\n";
+  benchmark_bloom_filter();
+
+  std::cout << "=== DataCache warm restart: 10M symbols ===\n";
+  benchmark_data_cache_snapshot(10'000'000);
+
+  std::cout << "=== Bounded DataCache: segmented CLOCK on Zipf keys ===\n";
+  benchmark_bounded_data_cache();
+
+  std::cout << "=== Time-series store: ingest and window aggregates ===\n";
+  benchmark_time_series();
+
+  std::cout << "=== Tick replay into DataCache ===\n";
+  benchmark_tick_replay();
+
   return 0;
 }
 }  // namespace MT
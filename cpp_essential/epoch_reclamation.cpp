@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace MT {
+
+// ------------
+// Epoch-based reclamation (EBR)
+// ------------
+//
+// Problem: a lock-free reader may still hold a pointer to a node that a
+// writer has just unlinked, so the writer cannot `delete` it right away.
+//
+// EBR:
+//   - readers "pin" the current global epoch for the duration of an
+//     operation (Guard), unpin when done
+//   - an unlinked node is "retired" together with the epoch it was
+//     retired in
+//   - the global epoch only advances when every pinned thread has seen the
+//     current one; once it advanced twice past a node's retire epoch, no
+//     reader can still hold that node and it is freed
+//
+// Cost for readers: one atomic write to a thread-private (padded) record on
+// entry and exit. Writers batch retired nodes and scan the records every
+// |kRetireBatch| retirements.
+//
+// One process-wide domain: epoch_domain().
+
+class EpochDomain {
+  struct ThreadRecord;
+
+ public:
+  static constexpr int kMaxThreads = 256;
+
+  // RAII pin of the current epoch. Nestable; only the outermost guard of a
+  // thread announces/clears the epoch.
+  class Guard {
+   public:
+    explicit Guard(EpochDomain& domain) : record(domain.local_record()) {
+      if (record->nesting++ == 0) {
+        uint64_t e = domain.global_epoch.load(std::memory_order_seq_cst);
+        // exchange (not store) so the announcement is ordered before the
+        // loads of shared pointers that follow
+        record->state.exchange((e << 1) | 1, std::memory_order_seq_cst);
+      }
+    }
+
+    ~Guard() {
+      if (--record->nesting == 0) {
+        record->state.store(0, std::memory_order_release);
+      }
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    ThreadRecord* record;
+  };
+
+  ~EpochDomain() {
+    // process exit: nobody can be pinned any more
+    for (auto& record : records) {
+      for (auto& r : record.limbo) r.deleter(r.ptr);
+    }
+    for (auto& r : orphans) r.deleter(r.ptr);
+  }
+
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  Guard pin() { return Guard(*this); }
+
+  // Schedules |deleter(ptr)| for when no pinned thread can reach |ptr|.
+  // Call after |ptr| was unlinked from the shared structure.
+  void retire(void* ptr, void (*deleter)(void*)) {
+    ThreadRecord* record = local_record();
+    uint64_t e = global_epoch.load(std::memory_order_seq_cst);
+    record->limbo.push_back({ptr, deleter, e});
+
+    // every |kRetireBatch| retirements, not whenever the list is long: a
+    // thread stuck in a pinned section would otherwise make every retire
+    // rescan everything
+    if (++record->retired % kRetireBatch == 0) {
+      try_advance();
+      reclaim(*record);
+    }
+  }
+
+  template <typename T>
+  void retire(T* ptr) {
+    retire(ptr, [](void* p) { delete static_cast<T*>(p); });
+  }
+
+  // Blocks until everything retired so far by this thread is freed. Only
+  // for quiescent points (tests, shutdown); must not be called while
+  // pinned.
+  void drain() {
+    ThreadRecord* record = local_record();
+    while (!record->limbo.empty() || has_orphans()) {
+      try_advance();
+      reclaim(*record);
+      std::this_thread::yield();
+    }
+  }
+
+  uint64_t epoch() const {
+    return global_epoch.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // the per-thread record cache below assumes a single instance
+  EpochDomain() = default;
+  friend EpochDomain& epoch_domain();
+
+  static constexpr size_t kRetireBatch = 64;
+
+  struct Retired {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  struct alignas(64) ThreadRecord {
+    // (epoch << 1) | 1 while pinned, 0 otherwise
+    std::atomic<uint64_t> state{0};
+    std::atomic<bool> in_use{false};
+
+    // owner-thread only
+    int nesting = 0;
+    size_t retired = 0;
+    std::vector<Retired> limbo;
+  };
+
+  // Frees a thread's record (and hands over its pending nodes) at exit.
+  struct Registration {
+    EpochDomain* domain = nullptr;
+    ThreadRecord* record = nullptr;
+
+    ~Registration() {
+      if (!record) return;
+      domain->try_advance();
+      domain->reclaim(*record);
+      {
+        std::lock_guard<std::mutex> lock(domain->orphans_mtx);
+        for (auto& r : record->limbo) domain->orphans.push_back(r);
+      }
+      record->limbo.clear();
+      record->in_use.store(false, std::memory_order_release);
+    }
+  };
+
+  ThreadRecord* local_record() {
+    thread_local Registration registration;
+    if (registration.record) {
+      return registration.record;
+    }
+
+    for (auto& record : records) {
+      bool expected = false;
+      if (!record.in_use.load(std::memory_order_relaxed) &&
+          record.in_use.compare_exchange_strong(expected, true)) {
+        registration.domain = this;
+        registration.record = &record;
+
+        int used = static_cast<int>(&record - records) + 1;
+        int seen = num_records.load(std::memory_order_relaxed);
+        while (seen < used &&
+               !num_records.compare_exchange_weak(seen, used)) {
+        }
+        return &record;
+      }
+    }
+    throw std::runtime_error("EpochDomain: too many threads");
+  }
+
+  // Advances the global epoch if every pinned thread has observed it.
+  void try_advance() {
+    uint64_t e = global_epoch.load(std::memory_order_seq_cst);
+    const int n = num_records.load(std::memory_order_seq_cst);
+    for (int i = 0; i < n; ++i) {
+      uint64_t s = records[i].state.load(std::memory_order_seq_cst);
+      if ((s & 1) && (s >> 1) != e) {
+        return;  // someone is still in an older epoch
+      }
+    }
+    global_epoch.compare_exchange_strong(e, e + 1, std::memory_order_seq_cst);
+  }
+
+  // Frees nodes retired at least two epochs ago.
+  void reclaim(ThreadRecord& record) {
+    const uint64_t e = global_epoch.load(std::memory_order_seq_cst);
+
+    auto safe = [e](const Retired& r) { return r.epoch + 2 <= e; };
+    auto it = std::partition(record.limbo.begin(), record.limbo.end(),
+                             [&](const Retired& r) { return !safe(r); });
+    for (auto p = it; p != record.limbo.end(); ++p) p->deleter(p->ptr);
+    record.limbo.erase(it, record.limbo.end());
+
+    if (has_orphans()) {
+      std::lock_guard<std::mutex> lock(orphans_mtx);
+      auto mid = std::partition(orphans.begin(), orphans.end(),
+                                [&](const Retired& r) { return !safe(r); });
+      for (auto p = mid; p != orphans.end(); ++p) p->deleter(p->ptr);
+      orphans.erase(mid, orphans.end());
+      num_orphans.store(orphans.size(), std::memory_order_relaxed);
+    }
+  }
+
+  bool has_orphans() const {
+    return num_orphans.load(std::memory_order_relaxed) != 0;
+  }
+
+  alignas(64) std::atomic<uint64_t> global_epoch{2};
+  ThreadRecord records[kMaxThreads];
+  // high-water mark of records ever handed out, bounds the scan
+  std::atomic<int> num_records{0};
+
+  std::mutex orphans_mtx;
+  std::vector<Retired> orphans;
+  std::atomic<size_t> num_orphans{0};
+};
+
+// The process-wide domain.
+inline EpochDomain& epoch_domain() {
+  static EpochDomain domain;
+  return domain;
+}
+
+}  // namespace MT
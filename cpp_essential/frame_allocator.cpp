@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace MT {
+
+// ------------
+// Coroutine frame allocator
+// ------------
+//
+// Every coroutine call allocates a frame; short-lived ones (a Task awaited
+// once, a Generator stage) make that allocation a large part of their cost.
+// promise_type::operator new/delete route frames here:
+//   - per-thread free lists by 64-byte size class, frames up to 1 KiB
+//   - allocate pops a recycled block of the class, or takes a new one from
+//     the heap; deallocate pushes it back
+//   - no locks: each thread only touches its own lists
+// Larger frames go straight to the heap.
+
+namespace detail {
+
+class FrameAllocator {
+ public:
+  static void* allocate(size_t size) {
+    const size_t c = size_class(size);
+    if (c >= kClasses || cache_gone) {
+      return ::operator new(size);
+    }
+    Cache& cache = local();
+    if (FreeBlock* block = cache.heads[c]) {
+      cache.heads[c] = block->next;
+      --cache.counts[c];
+      return block;
+    }
+    return ::operator new((c + 1) * kGranule);
+  }
+
+  // Frames often finish on another thread than the one that made them; the
+  // block then joins that thread's list (bounded, extra goes back to the
+  // heap).
+  static void deallocate(void* p, size_t size) noexcept {
+    const size_t c = size_class(size);
+    if (c >= kClasses || cache_gone) {
+      ::operator delete(p);
+      return;
+    }
+    Cache& cache = local();
+    if (cache.counts[c] >= kMaxCached) {
+      ::operator delete(p);
+      return;
+    }
+    auto* block = static_cast<FreeBlock*>(p);
+    block->next = cache.heads[c];
+    cache.heads[c] = block;
+    ++cache.counts[c];
+  }
+
+ private:
+  static constexpr size_t kGranule = 64;
+  static constexpr size_t kClasses = 16;  // frames up to 1 KiB
+  static constexpr uint32_t kMaxCached = 256;
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct Cache {
+    FreeBlock* heads[kClasses] = {};
+    uint32_t counts[kClasses] = {};
+
+    ~Cache() {
+      cache_gone = true;  // frames freed later in thread exit use the heap
+      for (FreeBlock* head : heads) {
+        while (head) {
+          ::operator delete(std::exchange(head, head->next));
+        }
+      }
+    }
+  };
+
+  static size_t size_class(size_t size) {
+    return size == 0 ? 0 : (size - 1) / kGranule;
+  }
+
+  static Cache& local() {
+    thread_local Cache cache;
+    return cache;
+  }
+
+  static inline thread_local bool cache_gone = false;
+};
+
+}  // namespace detail
+
+}  // namespace MT
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#include "frame_allocator.cpp"
+
+namespace MT {
+
+// ------------
+// Generator<T>
+// ------------
+//
+// A coroutine that produces a sequence lazily: the body runs up to the next
+// co_yield each time the consumer advances, so a pipeline of generators
+// holds one element per stage instead of one vector per stage.
+//
+// Generator<T> is an input range and a view:
+//   for (const auto& x : gen) ...
+//   gen | std::views::filter(...) | std::views::take(10)
+// Single pass: begin() may be called once.
+//
+// Yield by reference, no copies: co_yield stores the address of the
+// yielded object (a local, or a temporary that lives until the generator
+// resumes) and operator* returns a reference to it. The reference type is
+// const T& for a value T, or T itself when T is a reference (Generator<X&>
+// lets the consumer modify the yielded object).
+//
+// Nested generators: co_yield elements_of(sub) yields everything |sub|
+// yields. The nested generators form a stack, and the outermost one keeps
+// a pointer to the innermost ("leaf"):
+//   - advancing resumes the leaf directly, O(1) whatever the depth
+//   - a finished leaf transfers back to its parent (symmetric transfer)
+//     and the parent becomes the leaf
+// Re-yielding with `for (auto& x : sub) co_yield x` instead costs one
+// resume per level for every element.
+//
+// Exceptions from the body propagate out of begin() / operator++; from a
+// nested generator, out of the parent's co_yield elements_of.
+//
+// Frames come from FrameAllocator (frame_allocator.cpp).
+
+template <typename T>
+class Generator;
+
+template <typename T>
+struct ElementsOf {
+  Generator<T> generator;
+};
+
+template <typename T>
+ElementsOf<T> elements_of(Generator<T> generator) {
+  return {std::move(generator)};
+}
+
+namespace detail {
+
+template <typename T>
+class GeneratorPromise {
+ public:
+  using reference = std::conditional_t<std::is_reference_v<T>, T, const T&>;
+  using Handle = std::coroutine_handle<GeneratorPromise>;
+
+  static void* operator new(size_t size) {
+    return FrameAllocator::allocate(size);
+  }
+  static void operator delete(void* p, size_t size) noexcept {
+    FrameAllocator::deallocate(p, size);
+  }
+
+  Generator<T> get_return_object() noexcept {
+    return Generator<T>(Handle::from_promise(*this));
+  }
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    // a nested generator hands control back to its parent
+    std::coroutine_handle<> await_suspend(Handle self) noexcept {
+      GeneratorPromise& p = self.promise();
+      if (p.parent) {
+        p.root->leaf = p.parent;
+        return p.parent;
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+
+  std::suspend_always yield_value(reference value) noexcept {
+    root->current = std::addressof(value);
+    return {};
+  }
+
+  auto yield_value(ElementsOf<T> nested) noexcept {
+    struct Awaiter {
+      Generator<T> child;  // owned until the parent moves on
+
+      bool await_ready() const noexcept { return !child.handle; }
+
+      std::coroutine_handle<> await_suspend(Handle parent) noexcept {
+        GeneratorPromise& c = child.handle.promise();
+        c.root = parent.promise().root;
+        c.parent = parent;
+        c.root->leaf = child.handle;
+        return child.handle;
+      }
+
+      void await_resume() {
+        if (child.handle && child.handle.promise().error) {
+          std::rethrow_exception(child.handle.promise().error);
+        }
+      }
+    };
+    return Awaiter{std::move(nested.generator)};
+  }
+
+  void return_void() const noexcept {}
+
+  void unhandled_exception() {
+    if (!parent) {
+      throw;  // out of the consumer's resume()
+    }
+    error = std::current_exception();  // rethrown in the parent
+  }
+
+  // generators produce values, they do not wait for anything
+  void await_transform() = delete;
+
+ private:
+  friend class Generator<T>;
+
+  GeneratorPromise* root = this;
+  Handle leaf = Handle::from_promise(*this);  // root only
+  std::add_pointer_t<reference> current = nullptr;  // root only
+  Handle parent;
+  std::exception_ptr error;
+};
+
+}  // namespace detail
+
+template <typename T>
+class [[nodiscard]] Generator
+    : public std::ranges::view_interface<Generator<T>> {
+ public:
+  using promise_type = detail::GeneratorPromise<T>;
+  using value_type = std::remove_cvref_t<T>;
+  using reference = typename promise_type::reference;
+
+  class iterator {
+   public:
+    using iterator_concept = std::input_iterator_tag;
+    using value_type = Generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+    iterator(iterator&& other) noexcept
+        : handle(std::exchange(other.handle, {})) {}
+    iterator& operator=(iterator&& other) noexcept {
+      handle = std::exchange(other.handle, {});
+      return *this;
+    }
+
+    reference operator*() const {
+      return static_cast<reference>(*handle.promise().current);
+    }
+
+    iterator& operator++() {
+      handle.promise().leaf.resume();
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    friend bool operator==(const iterator& it, std::default_sentinel_t) {
+      return it.handle.done();
+    }
+
+   private:
+    friend class Generator;
+
+    explicit iterator(typename promise_type::Handle h) : handle(h) {}
+
+    typename promise_type::Handle handle;  // the root
+  };
+
+  Generator() = default;
+
+  Generator(Generator&& other) noexcept
+      : handle(std::exchange(other.handle, {})) {}
+
+  Generator& operator=(Generator&& other) noexcept {
+    if (this != &other) {
+      if (handle) handle.destroy();
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+
+  ~Generator() {
+    if (handle) handle.destroy();
+  }
+
+  // Runs the body to its first co_yield.
+  iterator begin() {
+    handle.resume();
+    return iterator(handle);
+  }
+
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+ private:
+  friend promise_type;
+
+  explicit Generator(typename promise_type::Handle h) : handle(h) {}
+
+  typename promise_type::Handle handle;
+};
+
+}  // namespace MT
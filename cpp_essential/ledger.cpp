@@ -0,0 +1,465 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "mpmc_queue.cpp"
+#include "spinlock.cpp"
+
+namespace MT {
+
+// ------------
+// Sharded ledger
+// ------------
+//
+// BankAccount guards each balance with its own mutex: every deposit is a
+// lock round trip, and a transfer locks two accounts. Ledger instead
+// partitions accounts over shards, each owned by one thread that is the
+// only one to ever touch its balances, so applying an operation takes no
+// lock at all:
+//   - account id -> shard id % num_shards, slot id / num_shards
+//   - clients submit operations into the shard's MPMC queue (used as
+//     many-producer / single-consumer); LedgerClient buffers them per shard
+//     and pushes a whole batch with one CAS
+//   - the owner pops a batch at a time and applies it in a tight loop (the
+//     owner is a permanent "flat combiner" for its shard)
+//
+// A transfer between shards runs in two phases, in order:
+//   1. the source shard checks funds and debits (or rejects)
+//   2. it sends a credit to the destination shard, which adds it
+// Money is never created: a credit only exists after its debit. Between
+// the two it is "in transit".
+//
+// Consistent snapshots (a cut where every debit has its credit):
+//   - snapshot() sends a marker to every shard; on the marker a shard stops
+//     and waits for the others (barrier), so no new credits are sent
+//   - each shard then takes in every credit already sent to it (per-pair
+//     counters say how many) and sets everything else aside for later
+//   - it copies its balances, plus the credits it has not managed to push
+//     yet (its destination was full); those are added to the destination
+//     accounts in the snapshot
+//   - second barrier, then every shard resumes with the operations it set
+//     aside
+//
+// Credits never block: if the destination queue is full they wait in the
+// sender's outbox, so two shards crediting each other cannot deadlock.
+
+using AccountId = uint64_t;
+using Amount = int64_t;
+
+class Ledger;
+
+namespace detail {
+
+struct LedgerSnapshotRequest;
+
+struct LedgerOp {
+  enum Kind : uint8_t { kDeposit, kTransfer, kCredit, kSnapshot, kStop };
+
+  Kind kind = kDeposit;
+  AccountId from = 0;
+  AccountId to = 0;
+  Amount amount = 0;
+  // optional: set to the steady-clock time the operation was applied
+  std::atomic<int64_t>* applied_at = nullptr;
+  LedgerSnapshotRequest* snapshot = nullptr;
+};
+
+}  // namespace detail
+
+// Balances and counters at one consistent cut.
+class LedgerSnapshot {
+ public:
+  Amount balance(AccountId id) const {
+    return balances[id % balances.size()][id / balances.size()];
+  }
+
+  Amount total() const {
+    Amount sum = 0;
+    for (const auto& shard : balances) {
+      for (Amount b : shard) sum += b;
+    }
+    return sum;
+  }
+
+  uint64_t applied = 0;   // deposits and transfers done
+  uint64_t rejected = 0;  // transfers refused for lack of funds
+
+ private:
+  friend class Ledger;
+  std::vector<std::vector<Amount>> balances;  // [shard][slot]
+};
+
+namespace detail {
+
+struct LedgerSnapshotRequest {
+  explicit LedgerSnapshotRequest(size_t num_shards)
+      : paused(std::ptrdiff_t(num_shards)),
+        recorded(std::ptrdiff_t(num_shards)),
+        balances(num_shards),
+        in_transit(num_shards),
+        applied(num_shards),
+        rejected(num_shards) {}
+
+  std::barrier<> paused;
+  std::barrier<> recorded;
+  std::vector<std::vector<Amount>> balances;
+  std::vector<std::vector<LedgerOp>> in_transit;
+  std::vector<uint64_t> applied;
+  std::vector<uint64_t> rejected;
+  // last touch of the request by each shard; the requester waits for all
+  std::atomic<size_t> finished{0};
+};
+
+}  // namespace detail
+
+class Ledger {
+ public:
+  using Op = detail::LedgerOp;
+
+  explicit Ledger(size_t num_accounts,
+                  size_t num_shards = default_shards(),
+                  size_t queue_capacity = 1 << 14)
+      : shards(std::max<size_t>(num_shards, 1)) {
+    for (size_t s = 0; s < shards.size(); ++s) {
+      shards[s] = std::make_unique<Shard>(
+          queue_capacity, (num_accounts + shards.size() - 1 - s) / shards.size(),
+          shards.size());
+    }
+    for (size_t s = 0; s < shards.size(); ++s) {
+      shards[s]->owner = std::thread([this, s] { run(s); });
+    }
+  }
+
+  ~Ledger() {
+    for (size_t s = 0; s < shards.size(); ++s) {
+      Op stop;
+      stop.kind = Op::kStop;
+      shards[s]->queue.push(stop);
+    }
+    for (auto& shard : shards) shard->owner.join();
+  }
+
+  Ledger(const Ledger&) = delete;
+  Ledger& operator=(const Ledger&) = delete;
+
+  size_t num_shards() const { return shards.size(); }
+  size_t shard_of(AccountId id) const { return id % shards.size(); }
+
+  // Single operations; LedgerClient batches them.
+  void deposit(AccountId to, Amount amount) {
+    Op op;
+    op.to = to;
+    op.amount = amount;
+    submit(shard_of(to), std::span<const Op>(&op, 1));
+  }
+
+  void transfer(AccountId from, AccountId to, Amount amount) {
+    Op op;
+    op.kind = Op::kTransfer;
+    op.from = from;
+    op.to = to;
+    op.amount = amount;
+    submit(shard_of(from), std::span<const Op>(&op, 1));
+  }
+
+  // Pushes |ops| (all for |shard|) in as few CAS as the queue allows,
+  // waiting while it is full.
+  void submit(size_t shard, std::span<const Op> ops) {
+    Backoff backoff;
+    while (!ops.empty()) {
+      size_t n = shards[shard]->queue.try_push_bulk(ops);
+      ops = ops.subspan(n);
+      if (n == 0) backoff.pause();
+    }
+  }
+
+  // Includes every operation submitted before the call (by this thread, or
+  // by threads that finished before it).
+  LedgerSnapshot snapshot() {
+    std::lock_guard<std::mutex> locker(snapshot_mtx);
+
+    detail::LedgerSnapshotRequest request(shards.size());
+    for (auto& shard : shards) {
+      Op marker;
+      marker.kind = Op::kSnapshot;
+      marker.snapshot = &request;
+      shard->queue.push(marker);
+    }
+    while (request.finished.load(std::memory_order_acquire) < shards.size()) {
+      std::this_thread::yield();
+    }
+
+    LedgerSnapshot result;
+    result.balances = std::move(request.balances);
+    for (size_t s = 0; s < shards.size(); ++s) {
+      result.applied += request.applied[s];
+      result.rejected += request.rejected[s];
+      for (const Op& credit : request.in_transit[s]) {
+        result.balances[shard_of(credit.to)][credit.to / shards.size()] +=
+            credit.amount;
+      }
+    }
+    return result;
+  }
+
+ private:
+  static constexpr size_t kBatch = 256;
+
+  struct Shard {
+    Shard(size_t queue_capacity, size_t num_accounts, size_t num_shards)
+        : queue(queue_capacity),
+          balances(num_accounts, 0),
+          credits_sent(num_shards, 0) {}
+
+    MpmcQueue<Op, true> queue;
+
+    // owner thread only (read by other owners between snapshot barriers)
+    std::vector<Amount> balances;
+    std::vector<uint64_t> credits_sent;  // pushed to shard i, cumulative
+    uint64_t credits_received = 0;
+    uint64_t applied = 0;
+    uint64_t rejected = 0;
+    std::vector<Op> outbox;  // credits whose destination was full
+    std::vector<Op> set_aside;  // popped while draining for a snapshot
+
+    std::thread owner;
+  };
+
+  static size_t default_shards() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  Amount& balance(Shard& shard, AccountId id) {
+    return shard.balances[id / shards.size()];
+  }
+
+  void run(size_t s) {
+    Shard& shard = *shards[s];
+    std::vector<Op> batch(kBatch);
+    bool running = true;
+    Backoff backoff;
+
+    while (running) {
+      flush_outbox(shard);
+      size_t n = shard.queue.try_pop_bulk(batch);
+      if (n == 0) {
+        if (!shard.outbox.empty()) {
+          backoff.pause();  // keep retrying the outbox, do not sleep
+          continue;
+        }
+        batch[0] = shard.queue.pop();
+        n = 1 + shard.queue.try_pop_bulk(std::span(batch).subspan(1));
+      }
+      backoff = Backoff();
+
+      for (size_t i = 0; i < n && running; ++i) {
+        if (batch[i].kind == Op::kSnapshot) {
+          // the rest of the batch is already off the queue: hand it over
+          running = take_snapshot(s, *batch[i].snapshot,
+                                  std::span(batch).subspan(i + 1, n - i - 1));
+          break;
+        }
+        running = apply(s, batch[i]);
+      }
+    }
+  }
+
+  // Returns false on kStop.
+  bool apply(size_t s, const Op& op) {
+    Shard& shard = *shards[s];
+    switch (op.kind) {
+      case Op::kDeposit:
+        balance(shard, op.to) += op.amount;
+        ++shard.applied;
+        break;
+      case Op::kTransfer: {
+        Amount& from = balance(shard, op.from);
+        if (from < op.amount) {
+          ++shard.rejected;
+          break;
+        }
+        from -= op.amount;  // phase 1
+        ++shard.applied;
+        if (shard_of(op.to) == s) {
+          balance(shard, op.to) += op.amount;
+        } else {
+          Op credit;
+          credit.kind = Op::kCredit;
+          credit.to = op.to;
+          credit.amount = op.amount;
+          send_credit(shard, credit);  // phase 2 on the other shard
+        }
+        break;
+      }
+      case Op::kCredit:
+        balance(shard, op.to) += op.amount;
+        ++shard.credits_received;
+        break;
+      case Op::kSnapshot:  // handled by run()
+        return true;
+      case Op::kStop:
+        return false;
+    }
+    if (op.applied_at) {
+      op.applied_at->store(now_ns(), std::memory_order_release);
+    }
+    return true;
+  }
+
+  void send_credit(Shard& shard, const Op& credit) {
+    const size_t dest = shard_of(credit.to);
+    // keep the order of credits to one destination: behind the outbox
+    if (shard.outbox.empty() && shards[dest]->queue.try_push(credit)) {
+      ++shard.credits_sent[dest];
+    } else {
+      shard.outbox.push_back(credit);
+    }
+  }
+
+  void flush_outbox(Shard& shard) {
+    size_t kept = 0;
+    for (const Op& credit : shard.outbox) {
+      const size_t dest = shard_of(credit.to);
+      if (shards[dest]->queue.try_push(credit)) {
+        ++shard.credits_sent[dest];
+      } else {
+        shard.outbox[kept++] = credit;
+      }
+    }
+    shard.outbox.resize(kept);
+  }
+
+  // |popped|: operations behind the marker in the batch being applied.
+  // Returns false if one of them was kStop.
+  bool take_snapshot(size_t s,
+                     detail::LedgerSnapshotRequest& request,
+                     std::span<const Op> popped) {
+    Shard& shard = *shards[s];
+
+    // 1. every shard stops sending credits
+    request.paused.arrive_and_wait();
+
+    for (const Op& op : popped) {
+      if (op.kind == Op::kCredit) {
+        apply(s, op);
+      } else {
+        shard.set_aside.push_back(op);
+      }
+    }
+
+    // 2. take in the credits sent to us before the cut
+    uint64_t expected = 0;
+    for (auto& other : shards) expected += other->credits_sent[s];
+    Backoff backoff;
+    while (shard.credits_received < expected) {
+      Op op;
+      if (!shard.queue.try_pop(op)) {
+        backoff.pause();
+        continue;
+      }
+      if (op.kind == Op::kCredit) {
+        apply(s, op);
+      } else {
+        shard.set_aside.push_back(op);
+      }
+    }
+
+    // 3. record
+    request.balances[s] = shard.balances;
+    request.in_transit[s] = shard.outbox;
+    request.applied[s] = shard.applied;
+    request.rejected[s] = shard.rejected;
+
+    // 4. nobody resumes (and sends new credits) until all have recorded
+    request.recorded.arrive_and_wait();
+    request.finished.fetch_add(1, std::memory_order_release);
+
+    std::vector<Op> later;
+    later.swap(shard.set_aside);
+    bool running = true;
+    for (const Op& op : later) {
+      running &= apply(s, op);
+    }
+    return running;
+  }
+
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::mutex snapshot_mtx;
+};
+
+// Buffers operations per shard and submits a shard's buffer as one batch
+// when it fills, on flush(), and on destruction. One per client thread.
+class LedgerClient {
+ public:
+  explicit LedgerClient(Ledger& ledger, size_t batch_size = 64)
+      : ledger(ledger), batch_size(batch_size), buffers(ledger.num_shards()) {
+    for (auto& buffer : buffers) buffer.reserve(batch_size);
+  }
+
+  ~LedgerClient() { flush(); }
+
+  LedgerClient(const LedgerClient&) = delete;
+  LedgerClient& operator=(const LedgerClient&) = delete;
+
+  // |applied_at|, if given, receives the time the operation was applied.
+  void deposit(AccountId to,
+               Amount amount,
+               std::atomic<int64_t>* applied_at = nullptr) {
+    Ledger::Op op;
+    op.to = to;
+    op.amount = amount;
+    op.applied_at = applied_at;
+    add(ledger.shard_of(to), op);
+  }
+
+  void transfer(AccountId from,
+                AccountId to,
+                Amount amount,
+                std::atomic<int64_t>* applied_at = nullptr) {
+    Ledger::Op op;
+    op.kind = Ledger::Op::kTransfer;
+    op.from = from;
+    op.to = to;
+    op.amount = amount;
+    op.applied_at = applied_at;
+    add(ledger.shard_of(from), op);
+  }
+
+  void flush() {
+    for (size_t s = 0; s < buffers.size(); ++s) {
+      ledger.submit(s, buffers[s]);
+      buffers[s].clear();
+    }
+  }
+
+ private:
+  void add(size_t shard, const Ledger::Op& op) {
+    buffers[shard].push_back(op);
+    if (buffers[shard].size() >= batch_size) {
+      ledger.submit(shard, buffers[shard]);
+      buffers[shard].clear();
+    }
+  }
+
+  Ledger& ledger;
+  const size_t batch_size;
+  std::vector<std::vector<Ledger::Op>> buffers;
+};
+
+}  // namespace MT
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "epoch_reclamation.cpp"
+
+namespace MT {
+
+// ------------
+// Lock-free stack (Treiber stack)
+// ------------
+//
+// |head| points at the top node; push and pop are a single CAS on it.
+//
+// What makes the naive version (push_stack) unsafe once pop exists:
+//   - use-after-free: pop reads |top->next| while another thread may have
+//     popped and deleted |top| already
+//     -> popped nodes are retired through epoch-based reclamation and only
+//        reused once no pinned thread can still hold them
+//   - ABA: pop loads top = A, next = B; meanwhile A and B are popped and A
+//     is pushed again; the CAS "head == A" succeeds and installs the stale
+//     B
+//     -> |head| is a tagged pointer: every successful CAS bumps a 16-bit
+//        counter stored next to the address, so a recycled A no longer
+//        compares equal. EBR already keeps A from coming back while the
+//        thread holding it is pinned; the tag makes the CAS correct on its
+//        own and costs nothing (still one 64-bit CAS).
+//   - one allocation per push
+//     -> nodes are recycled through a lock-free pool shared by every
+//        LockFreeStack<T>; only surplus nodes are deleted
+
+namespace detail {
+
+// 48-bit address + 16-bit tag in one 64-bit word. User-space addresses on
+// x86-64 and arm64 fit in 48 bits.
+template <typename T>
+struct TaggedPtr {
+  static_assert(sizeof(void*) == 8, "TaggedPtr needs 64-bit pointers");
+
+  static constexpr int kTagShift = 48;
+  static constexpr uint64_t kPtrMask = (uint64_t{1} << kTagShift) - 1;
+
+  uint64_t bits = 0;
+
+  T* ptr() const { return reinterpret_cast<T*>(bits & kPtrMask); }
+  uint16_t tag() const { return static_cast<uint16_t>(bits >> kTagShift); }
+
+  // |ptr| with the tag bumped, the value to CAS in
+  TaggedPtr with(T* ptr) const {
+    uint64_t tag = static_cast<uint16_t>(this->tag() + 1);
+    return {reinterpret_cast<uint64_t>(ptr) | (tag << kTagShift)};
+  }
+};
+
+}  // namespace detail
+
+template <typename T>
+class LockFreeStack {
+ public:
+  LockFreeStack() = default;
+
+  // No concurrent users left: remaining nodes go straight back to the pool.
+  ~LockFreeStack() {
+    Node* node = head.load(std::memory_order_relaxed).ptr();
+    while (node) {
+      Node* next = node->next.load(std::memory_order_relaxed);
+      give_back(node);
+      node = next;
+    }
+  }
+
+  LockFreeStack(const LockFreeStack&) = delete;
+  LockFreeStack& operator=(const LockFreeStack&) = delete;
+
+  template <typename U>
+  void push(U&& value) {
+    Node* node = pool().acquire();
+    node->value = std::forward<U>(value);
+
+    Tagged top = head.load(std::memory_order_relaxed);
+    do {
+      node->next.store(top.ptr(), std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(top,
+                                         top.with(node),
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  // Pops the top element into |out|. Returns false when empty.
+  bool try_pop(T& out) {
+    // pinned: |top| cannot be recycled while we read |top->next|
+    auto guard = epoch_domain().pin();
+
+    // seq_cst so the loads are ordered after the pin (see EpochDomain)
+    Tagged top = head.load(std::memory_order_seq_cst);
+    while (Node* node = top.ptr()) {
+      Node* next = node->next.load(std::memory_order_relaxed);
+      if (head.compare_exchange_weak(top,
+                                     top.with(next),
+                                     std::memory_order_seq_cst,
+                                     std::memory_order_seq_cst)) {
+        // unlinked: only this thread touches |value| from here on
+        out = std::move(node->value);
+        epoch_domain().retire(node, [](void* p) {
+          give_back(static_cast<Node*>(p));
+        });
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // A snapshot: may be stale as soon as it returns.
+  bool empty() const {
+    return head.load(std::memory_order_relaxed).ptr() == nullptr;
+  }
+
+ private:
+  struct Node {
+    T value{};
+    // atomic: a stale popper may read it while the node is being reused
+    std::atomic<Node*> next{nullptr};
+  };
+
+  using Tagged = detail::TaggedPtr<Node>;
+
+  // Free list of nodes shared by all stacks of this T. Nodes only come back
+  // after their grace period, so a pooled node is never still in use.
+  // Keeps at most |kMaxCached| nodes, deletes the rest.
+  class NodePool {
+   public:
+    NodePool() = default;
+
+    // static destruction: single-threaded
+    ~NodePool() {
+      Node* node = free_head.load(std::memory_order_relaxed).ptr();
+      while (node) {
+        Node* next = node->next.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+      }
+      destroyed = true;
+    }
+
+    Node* acquire() {
+      // pinned for the same reason as try_pop: |top->next| is read from a
+      // node that another thread may be taking at the same time
+      auto guard = epoch_domain().pin();
+
+      Tagged top = free_head.load(std::memory_order_acquire);
+      while (Node* node = top.ptr()) {
+        Node* next = node->next.load(std::memory_order_relaxed);
+        if (free_head.compare_exchange_weak(top,
+                                            top.with(next),
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+          cached.fetch_sub(1, std::memory_order_relaxed);
+          return node;
+        }
+      }
+      return new Node();
+    }
+
+    // |node| must be unreachable for every other thread.
+    void release(Node* node) {
+      if (cached.load(std::memory_order_relaxed) >= kMaxCached) {
+        delete node;
+        return;
+      }
+      cached.fetch_add(1, std::memory_order_relaxed);
+
+      Tagged top = free_head.load(std::memory_order_relaxed);
+      do {
+        node->next.store(top.ptr(), std::memory_order_relaxed);
+      } while (!free_head.compare_exchange_weak(top,
+                                                top.with(node),
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed));
+    }
+
+   private:
+    static constexpr size_t kMaxCached = 1 << 16;
+
+    alignas(64) std::atomic<Tagged> free_head{};
+    alignas(64) std::atomic<size_t> cached{0};
+  };
+
+  static NodePool& pool() {
+    static NodePool instance;
+    return instance;
+  }
+
+  // Returns an unreachable node to the pool. The epoch domain and static
+  // stacks may still do so after the pool was destroyed at exit.
+  static void give_back(Node* node) {
+    if (destroyed) {
+      delete node;
+    } else {
+      pool().release(node);
+    }
+  }
+
+  static inline bool destroyed = false;
+
+  alignas(64) std::atomic<Tagged> head{};
+};
+
+}  // namespace MT
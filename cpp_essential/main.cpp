@@ -22,6 +22,8 @@ int main() {
   MD::run();
 #elif defined(TEST_MT)
   MT::run();
+#elif defined(TEST_MT_BENCH)
+  MT::run_benchmarks();
 #elif defined(TEST_DP)
   DP::run_visitor();
 #endif
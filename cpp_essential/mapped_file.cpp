@@ -0,0 +1,88 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace MT {
+
+// ------------
+// Read-only file mapping
+// ------------
+//
+// The file's pages are mapped straight from the page cache: reading the
+// contents is reading memory, no copy into a user buffer and no parsing.
+// Pages are faulted in on first touch, so opening a large file is O(1).
+//
+// Throws std::system_error if the file cannot be opened or mapped. An
+// empty file maps to an empty span.
+
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(), "fstat " + path);
+    }
+    length = size_t(st.st_size);
+
+    if (length > 0) {
+      void* p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), "mmap " + path);
+      }
+      base = static_cast<const std::byte*>(p);
+    }
+    ::close(fd);  // the mapping keeps the file open
+  }
+
+  ~MappedFile() {
+    if (base) ::munmap(const_cast<std::byte*>(base), length);
+  }
+
+  MappedFile(MappedFile&& other) noexcept
+      : base(std::exchange(other.base, nullptr)),
+        length(std::exchange(other.length, 0)) {}
+
+  MappedFile& operator=(MappedFile other) noexcept {
+    std::swap(base, other.base);
+    std::swap(length, other.length);
+    return *this;
+  }
+
+  std::span<const std::byte> bytes() const { return {base, length}; }
+
+  // Tells the kernel the file is read front to back: larger read-ahead,
+  // pages behind the reader can be dropped first.
+  void advise_sequential() const {
+    if (base) ::madvise(const_cast<std::byte*>(base), length, MADV_SEQUENTIAL);
+  }
+
+  // Tells the kernel accesses are scattered: no read-ahead around faults.
+  void advise_random() const {
+    if (base) ::madvise(const_cast<std::byte*>(base), length, MADV_RANDOM);
+  }
+
+ private:
+  const std::byte* base = nullptr;
+  size_t length = 0;
+};
+
+}  // namespace MT
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "benchmark.cpp"
+#include "sharded_counter.cpp"
 
 namespace MM {
 
@@ -329,6 +330,8 @@ struct AlignedCounter {
   alignas(64) std::atomic<size_t> value{0};
 };
 
+// One such counter per core: MT::ShardedCounter (sharded_counter.cpp)
+
 //////////////////////////////////////////////////////////////
 // (48) Memory layout - polymorphic log entry
 //////////////////////////////////////////////////////////////
@@ -494,7 +497,11 @@ class Logger {
   // std::vector<LogHandler> queue;
   std::vector<LogPtr> queue;
 
-  AlignedCounter write_count;  // avoid false sharing
+  // NOTE: log() itself is NOT thread-safe (|pool| and |queue| are plain
+  // containers): callers serialize it. The counter only makes count()
+  // safe to read from another thread (a monitor) while log() runs, and
+  // stays uncontended if log() is ever made concurrent.
+  MT::ShardedCounter<size_t> write_count;
 
   FilePtr file;
 
@@ -510,7 +517,7 @@ class Logger {
 
     queue.emplace_back(raw, PoolDeleter{&pool});  // RAII ownership
 
-    write_count.value.fetch_add(1, std::memory_order_relaxed);
+    write_count.increment();
   }
 
   void flush() {
@@ -521,7 +528,7 @@ class Logger {
     queue.clear();  // triggers destruction -> return to pool
   }
 
-  size_t count() const { return write_count.value.load(); }
+  size_t count() const { return write_count.load(); }
 };
 
 //////////////////////////////////////////////////////////////
@@ -1,9 +1,15 @@
 #include <array>
+#include <cstdint>
 #include <iostream>
+#include <ranges>
 #include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "generator.cpp"
+
 namespace MD {
 
 // ------------
@@ -322,7 +328,76 @@ void test_if_constexpr() {
 //   - generators
 //   - task systems
 //
-// **no example code**
+// Examples:
+//   - generator.cpp (Generator<T>), used below
+//   - task.cpp (Task<T>, schedule_on, sleep_for, co_await on a Future),
+//     exercised by test_coroutine_task in concurrency_and_parallelism.cpp
+
+// Infinite: only computes what the consumer asks for.
+MT::Generator<uint64_t> fibonacci() {
+  uint64_t a = 0, b = 1;
+  while (true) {
+    co_yield a;
+    a = std::exchange(b, a + b);
+  }
+}
+
+// Lines of |text| as views into it: nothing is copied or collected.
+MT::Generator<std::string_view> split_lines(std::string_view text) {
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    co_yield text.substr(0, end);
+    text = end == std::string_view::npos ? "" : text.substr(end + 1);
+  }
+}
+
+struct TreeNode {
+  int value;
+  TreeNode* left = nullptr;
+  TreeNode* right = nullptr;
+};
+
+// Recursive in-order walk. elements_of hands the subtree's generator to the
+// consumer directly, so each node costs one resume, not one per level.
+MT::Generator<const TreeNode&> in_order(const TreeNode* node) {
+  if (!node) {
+    co_return;
+  }
+  co_yield MT::elements_of(in_order(node->left));
+  co_yield *node;  // by reference, no copy
+  co_yield MT::elements_of(in_order(node->right));
+}
+
+void test_generator() {
+  std::cout << "fibonacci:";
+  for (uint64_t f : fibonacci() | std::views::take(10)) {
+    std::cout << " " << f;
+  }
+  std::cout << "\n";
+
+  std::string_view csv = "AAPL,189.5\n# comment\nMSFT,411.2\n\nNVDA,880.1";
+  auto symbols = split_lines(csv) |
+                 std::views::filter([](std::string_view line) {
+                   return !line.empty() && line[0] != '#';
+                 }) |
+                 std::views::transform([](std::string_view line) {
+                   return line.substr(0, line.find(','));
+                 });
+  std::cout << "symbols:";
+  for (std::string_view s : symbols) {
+    std::cout << " " << s;
+  }
+  std::cout << "\n";
+
+  TreeNode n1{1}, n3{3}, n5{5}, n7{7};
+  TreeNode n2{2, &n1, &n3}, n6{6, &n5, &n7};
+  TreeNode root{4, &n2, &n6};
+  std::cout << "in-order:";
+  for (const TreeNode& node : in_order(&root)) {
+    std::cout << " " << node.value;
+  }
+  std::cout << "\n";
+}
 
 // -----------
 // std::span
@@ -378,6 +453,9 @@ int run() {
   std::cout << "=== if constexpr ===\n";
   test_if_constexpr();
 
+  std::cout << "=== Generator ===\n";
+  test_generator();
+
   std::cout << "=== std::span ===\n";
   test_span();
 
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+
+#include "spin_wait.cpp"
+
+namespace MT {
+
+// ------------
+// Bounded MPMC queue (Dmitry Vyukov's sequence-numbered cells)
+// ------------
+//
+// Every cell carries a |sequence| number that says whose turn it is:
+//   sequence == pos       cell is free for the producer that claims |pos|
+//   sequence == pos + 1   cell holds the item for the consumer of |pos|
+// after the consumer is done it sets sequence = pos + capacity, i.e. free
+// for the producer one lap later.
+//
+// A producer claims a position with one CAS on |enqueue_pos|, a consumer
+// with one CAS on |dequeue_pos|; the two sides never touch the same
+// counter, and different items live in different (padded) cells, so
+// producers and consumers only contend among themselves.
+//
+// Blocking = true adds push()/pop() that park on an epoch counter with
+// std::atomic::wait. Publishing then uses seq_cst so that a sleeper's
+// "arm, then re-check" cannot miss an item published concurrently.
+
+template <typename T, bool Blocking = false>
+class MpmcQueue {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit MpmcQueue(size_t capacity)
+      : mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        cells(std::make_unique<Cell[]>(mask + 1)) {
+    for (size_t i = 0; i <= mask; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpmcQueue(const MpmcQueue&) = delete;
+  MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+  size_t capacity() const { return mask + 1; }
+
+  template <typename U>
+  bool try_push(U&& value) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+    while (true) {
+      Cell& cell = cells[pos & mask];
+      size_t seq = cell.sequence.load(kLoad);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          cell.data = std::forward<U>(value);
+          cell.sequence.store(pos + 1, kStore);
+          wake(pop_armed, not_empty);
+          return true;
+        }
+        // CAS failed: |pos| now holds the current enqueue_pos
+      } else if (diff < 0) {
+        return false;  // full: cell still holds last lap's item
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T& out) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+    while (true) {
+      Cell& cell = cells[pos & mask];
+      size_t seq = cell.sequence.load(kLoad);
+      intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+      if (diff == 0) {
+        if (dequeue_pos.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed)) {
+          out = std::move(cell.data);
+          cell.sequence.store(pos + capacity(), kStore);
+          wake(push_armed, not_full);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // empty: producer of |pos| has not published yet
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Claims up to |items.size()| consecutive free cells with a single CAS and
+  // fills them. Returns the number pushed (0 when full).
+  size_t try_push_bulk(std::span<const T> items) {
+    if (items.empty()) {
+      return 0;
+    }
+
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+    while (true) {
+      // count the free cells starting at |pos|; they cannot be taken by
+      // anyone else unless enqueue_pos moves, which the CAS detects
+      size_t n = 0;
+      while (n < items.size() &&
+             cells[(pos + n) & mask].sequence.load(kLoad) == pos + n) {
+        ++n;
+      }
+
+      if (n == 0) {
+        size_t seq = cells[pos & mask].sequence.load(kLoad);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos) < 0) {
+          return 0;
+        }
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (enqueue_pos.compare_exchange_weak(
+              pos, pos + n, std::memory_order_relaxed)) {
+        for (size_t i = 0; i < n; ++i) {
+          Cell& cell = cells[(pos + i) & mask];
+          cell.data = items[i];
+          cell.sequence.store(pos + i + 1, kStore);
+        }
+        wake(pop_armed, not_empty);
+        return n;
+      }
+    }
+  }
+
+  // Claims up to |out.size()| consecutive published cells with a single CAS.
+  // Returns the number popped (0 when empty).
+  size_t try_pop_bulk(std::span<T> out) {
+    if (out.empty()) {
+      return 0;
+    }
+
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+    while (true) {
+      size_t n = 0;
+      while (n < out.size() &&
+             cells[(pos + n) & mask].sequence.load(kLoad) == pos + n + 1) {
+        ++n;
+      }
+
+      if (n == 0) {
+        size_t seq = cells[pos & mask].sequence.load(kLoad);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) {
+          return 0;
+        }
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+        continue;
+      }
+
+      if (dequeue_pos.compare_exchange_weak(
+              pos, pos + n, std::memory_order_relaxed)) {
+        for (size_t i = 0; i < n; ++i) {
+          Cell& cell = cells[(pos + i) & mask];
+          out[i] = std::move(cell.data);
+          cell.sequence.store(pos + i + capacity(), kStore);
+        }
+        wake(push_armed, not_full);
+        return n;
+      }
+    }
+  }
+
+  // --- blocking wrappers (Blocking = true only) ---
+
+  template <typename U>
+    requires Blocking
+  void push(U&& value) {
+    // |value| is only consumed when try_push succeeds
+    wait_until(push_armed, not_full, [&] {
+      return try_push(std::forward<U>(value));
+    });
+  }
+
+  T pop()
+    requires Blocking
+  {
+    T out;
+    wait_until(pop_armed, not_empty, [&] { return try_pop(out); });
+    return out;
+  }
+
+ private:
+  struct alignas(64) Cell {
+    std::atomic<size_t> sequence;
+    T data;
+  };
+
+  // Retries |attempt| until it succeeds: spin first, then park on |epoch|.
+  //
+  // Sleeper:  e = epoch; armed = 1; attempt(); wait(epoch, e)
+  // Waker:    publish cell; if (armed.exchange(0)) { epoch++; notify_all }
+  // All of these are seq_cst: either the sleeper's attempt() sees the cell,
+  // or the waker sees |armed| (or another waker cleared it, and bumped the
+  // epoch after the sleeper read it). Only the first publish after someone
+  // armed pays for the futex wake, not every item.
+  template <typename Attempt>
+  void wait_until(std::atomic<uint32_t>& armed,
+                  std::atomic<uint32_t>& epoch,
+                  Attempt attempt) {
+    for (int i = 0; i < spin_count(); ++i) {
+      if (attempt()) {
+        return;
+      }
+      cpu_relax();
+    }
+
+    while (true) {
+      uint32_t e = epoch.load(std::memory_order_seq_cst);
+      armed.store(1, std::memory_order_seq_cst);
+      if (attempt()) {
+        return;
+      }
+      epoch.wait(e, std::memory_order_seq_cst);
+    }
+  }
+
+  void wake(std::atomic<uint32_t>& armed, std::atomic<uint32_t>& epoch) {
+    if constexpr (Blocking) {
+      if (armed.load(std::memory_order_seq_cst) &&
+          armed.exchange(0, std::memory_order_seq_cst)) {
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        epoch.notify_all();
+      }
+    }
+  }
+
+  // Spinning only helps when the other side runs on another core.
+  static int spin_count() {
+    static const int count =
+        std::thread::hardware_concurrency() > 1 ? 128 : 0;
+    return count;
+  }
+
+  static constexpr std::memory_order kLoad =
+      Blocking ? std::memory_order_seq_cst : std::memory_order_acquire;
+  static constexpr std::memory_order kStore =
+      Blocking ? std::memory_order_seq_cst : std::memory_order_release;
+
+  alignas(64) std::atomic<size_t> enqueue_pos{0};
+  alignas(64) std::atomic<size_t> dequeue_pos{0};
+
+  // sleeper bookkeeping, untouched while nobody sleeps
+  alignas(64) std::atomic<uint32_t> push_armed{0};
+  std::atomic<uint32_t> pop_armed{0};
+  alignas(64) std::atomic<uint32_t> not_full{0};
+  alignas(64) std::atomic<uint32_t> not_empty{0};
+
+  alignas(64) const size_t mask;
+  std::unique_ptr<Cell[]> cells;
+};
+
+}  // namespace MT
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.cpp"
+
+namespace MT {
+
+// ------------
+// parallel_for / parallel_reduce
+// ------------
+//
+// Lazy binary splitting on top of ThreadPool:
+//   - the caller starts with the whole range and walks it |grain| elements
+//     at a time
+//   - between two grain steps, if some worker is idle, the remaining range is
+//     halved and the upper half is enqueued; the new task does the same
+//   - so a loop splits as deep as there are idle workers to take the pieces,
+//     and stays one chunk when the pool is busy
+//
+// Compared with `num_iters / num_threads` static slices:
+//   - no thread creation per call, workers are reused
+//   - uneven iterations get rebalanced because idle workers pull more halves
+//   - a task is a shared_ptr + two indices, stored inline in UniqueFunction,
+//     so splitting does not allocate
+//
+// The calling thread participates, and while it waits for the last chunks
+// it runs queued pool tasks, so nested calls from a worker do not deadlock.
+
+namespace detail {
+
+// Padded so partial results of different workers never share a cache line
+// (see AlignedAtomic / spawn_threads3)
+template <typename T>
+struct alignas(64) PaddedSlot {
+  T value;
+};
+
+// Default grain: a handful of chunks per participant, capped so the
+// "is anyone idle?" check still runs often on huge ranges.
+inline size_t auto_grain(size_t n, size_t participants) {
+  return std::clamp<size_t>(n / (8 * participants), 1, 4096);
+}
+
+// State shared by all chunks of one parallel_for / parallel_reduce call.
+// |Body| is called as body(begin, end) on index sub-ranges.
+template <typename Body>
+class SplitContext : public std::enable_shared_from_this<SplitContext<Body>> {
+ public:
+  SplitContext(ThreadPool& pool, Body& body, size_t grain)
+      : pool(pool), body(body), grain(grain) {}
+
+  void run(size_t begin, size_t end) {
+    try {
+      while (begin < end) {
+        if (end - begin > 2 * grain && pool.idle_workers() > 0) {
+          size_t mid = begin + (end - begin) / 2;
+          pending.fetch_add(1, std::memory_order_relaxed);
+          pool.enqueue([self = this->shared_from_this(), mid, end]() {
+            self->run(mid, end);
+          });
+          end = mid;
+        }
+
+        size_t stop = std::min(end, begin + grain);
+        body(begin, stop);
+        begin = stop;
+      }
+    } catch (...) {
+      if (!failed.exchange(true, std::memory_order_acq_rel)) {
+        error = std::current_exception();
+      }
+    }
+
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      pending.notify_all();
+    }
+  }
+
+  // Runs [begin, end) with the caller participating, then waits for the
+  // chunks that were handed out. Rethrows the first exception from |body|.
+  void run_and_wait(size_t begin, size_t end) {
+    run(begin, end);
+
+    while (true) {
+      size_t p = pending.load(std::memory_order_acquire);
+      if (p == 0) {
+        break;
+      }
+      if (!pool.try_run_one()) {
+        pending.wait(p, std::memory_order_acquire);
+      }
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  ThreadPool& pool;
+  Body& body;
+  const size_t grain;
+
+  // chunks not yet finished; starts at 1 for the caller's own chunk
+  std::atomic<size_t> pending{1};
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+};
+
+template <typename Body>
+void split_and_run(ThreadPool& pool, size_t n, size_t grain, Body& body) {
+  if (n == 0) {
+    return;
+  }
+  if (grain == 0) {
+    grain = auto_grain(n, pool.size() + 1);
+  }
+
+  auto ctx = std::make_shared<SplitContext<Body>>(pool, body, grain);
+  ctx->run_and_wait(0, n);
+}
+
+}  // namespace detail
+
+// Calls |fn(element)| for every element of |range| (any sized random-access
+// range: vector, span, std::views::iota(0, n), ...). |grain| = 0 picks a
+// grain from the range size and pool size.
+template <std::ranges::random_access_range R, typename F>
+  requires std::ranges::sized_range<R>
+void parallel_for(ThreadPool& pool, R&& range, size_t grain, F&& fn) {
+  auto first = std::ranges::begin(range);
+
+  auto body = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      fn(first[i]);
+    }
+  };
+
+  detail::split_and_run(pool, std::ranges::size(range), grain, body);
+}
+
+// Folds |range| with |op| starting from |identity|. |op| must be
+// associative and commutative: partial results are combined in whatever
+// order chunks finish.
+//
+// Every worker accumulates into its own padded slot (plain stores, no
+// atomics); the caller combines the slots at the end.
+template <std::ranges::random_access_range R, typename T, typename Op>
+  requires std::ranges::sized_range<R>
+T parallel_reduce(ThreadPool& pool,
+                  R&& range,
+                  T identity,
+                  Op op,
+                  size_t grain = 0) {
+  auto first = std::ranges::begin(range);
+
+  // slots [0, size()) belong to the workers, the last one to every other
+  // thread (the caller, or someone else helping through try_run_one)
+  std::vector<detail::PaddedSlot<T>> slots(pool.size() + 1,
+                                           detail::PaddedSlot<T>{identity});
+  std::atomic_flag outside_lock = ATOMIC_FLAG_INIT;
+
+  auto body = [&](size_t begin, size_t end) {
+    T local = identity;
+    for (size_t i = begin; i < end; ++i) {
+      local = op(std::move(local), first[i]);
+    }
+
+    int index = pool.worker_index();
+    if (index >= 0) {
+      slots[index].value = op(std::move(slots[index].value), std::move(local));
+    } else {
+      while (outside_lock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      T& slot = slots.back().value;
+      slot = op(std::move(slot), std::move(local));
+      outside_lock.clear(std::memory_order_release);
+    }
+  };
+
+  detail::split_and_run(pool, std::ranges::size(range), grain, body);
+
+  T result = identity;
+  for (auto& slot : slots) {
+    result = op(std::move(result), std::move(slot.value));
+  }
+  return result;
+}
+
+}  // namespace MT
@@ -0,0 +1,468 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mpmc_queue.cpp"
+
+namespace MT {
+
+// ------------
+// Staged pipeline
+// ------------
+//
+// Ingestion as a chain of stages, each with its own threads:
+//   auto pipeline = PipelineBuilder<std::string>(options)
+//                       .stage("parse", 2, parse)          // string -> Row
+//                       .stage("transform", 4, transform)  // Row -> Row
+//                       .sink("write", 1, write);          // Row -> void
+//   for (...) pipeline.push(line);
+//   pipeline.finish();  // drains, joins, rethrows a stage's exception
+//
+// Stages are linked by bounded MpmcQueues, so a slow stage pushes back:
+// its input queue fills, the stage before it blocks on push, its own input
+// fills, and so on up to push(). Memory stays bounded by
+// queue_capacity x batch_size items per link, whatever the rates.
+//
+// Items travel in batches of |batch_size|: one queue operation (and one
+// possible wake-up) per batch, not per item.
+//
+// ordered = true keeps the input order all the way to the sink: batches
+// are numbered at the source, and a stage with several workers releases
+// its output batches in number order (a worker that finishes early parks
+// its batch until the earlier ones are out; one too far ahead waits). A
+// sink with several workers still sees batches in parallel, so give it one
+// worker to write in order.
+//
+// Metrics, readable while running (stats()): per stage, items processed
+// and the time its workers spent
+//   - busy: in the stage function
+//   - starved: waiting on an empty input queue (upstream is slower)
+//   - stalled: waiting on a full output queue (downstream is slower)
+// plus the current and maximum depth of its input queue, in batches. The
+// bottleneck is the stage upstream of which everything stalls and
+// downstream of which everything starves.
+//
+// push() is called from one thread. After an exception a stage drops the
+// rest of its items (upstream keeps flowing); finish() rethrows the first
+// one, in stage order.
+
+struct PipelineOptions {
+  size_t batch_size = 64;      // items per batch
+  size_t queue_capacity = 16;  // batches per link, rounded up to 2^n
+  bool ordered = false;
+};
+
+struct PipelineStageStats {
+  std::string name;
+  size_t workers = 0;
+  uint64_t items = 0;
+  double busy_ms = 0;     // summed over the workers
+  double starved_ms = 0;
+  double stalled_ms = 0;
+  size_t queue_depth = 0;  // input queue, in batches
+  size_t max_queue_depth = 0;
+};
+
+namespace detail {
+
+inline int64_t pipeline_now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+template <typename T>
+struct PipelineBatch {
+  static constexpr uint64_t kEnd = ~uint64_t{0};  // one per worker, last
+
+  uint64_t seq = 0;
+  std::vector<T> items;
+};
+
+// A bounded queue of batches that also tracks its depth.
+template <typename T>
+class PipelineLink {
+ public:
+  explicit PipelineLink(size_t capacity) : queue(capacity) {}
+
+  // Returns the ns spent blocked on a full queue.
+  int64_t push(PipelineBatch<T>&& batch) {
+    int64_t blocked = 0;
+    if (!queue.try_push(std::move(batch))) {
+      const int64_t start = pipeline_now_ns();
+      queue.push(std::move(batch));
+      blocked = pipeline_now_ns() - start;
+    }
+    const int64_t d = depth.fetch_add(1, std::memory_order_relaxed) + 1;
+    int64_t m = max_depth.load(std::memory_order_relaxed);
+    while (d > m && !max_depth.compare_exchange_weak(
+                        m, d, std::memory_order_relaxed)) {
+    }
+    return blocked;
+  }
+
+  // Returns the ns spent blocked on an empty queue.
+  int64_t pop(PipelineBatch<T>& out) {
+    int64_t blocked = 0;
+    if (!queue.try_pop(out)) {
+      const int64_t start = pipeline_now_ns();
+      out = queue.pop();
+      blocked = pipeline_now_ns() - start;
+    }
+    depth.fetch_sub(1, std::memory_order_relaxed);
+    return blocked;
+  }
+
+  // |depth| moves after the queue does, so it can be off by a concurrent
+  // push/pop or two: clamp it to what the queue can hold
+  size_t size() const { return clamp(depth.load(std::memory_order_relaxed)); }
+  size_t max_size() const {
+    return clamp(max_depth.load(std::memory_order_relaxed));
+  }
+
+ private:
+  size_t clamp(int64_t d) const {
+    return std::min(size_t(std::max<int64_t>(d, 0)), queue.capacity());
+  }
+
+  MpmcQueue<PipelineBatch<T>, true> queue;
+  std::atomic<int64_t> depth{0};
+  std::atomic<int64_t> max_depth{0};
+};
+
+class PipelineStageBase {
+ public:
+  virtual ~PipelineStageBase() = default;
+
+  virtual void start() = 0;
+  virtual void join() = 0;
+  virtual PipelineStageStats stats() const = 0;
+
+  std::exception_ptr error;  // read after join()
+  size_t downstream_workers = 0;
+};
+
+template <typename In, typename Out, typename Fn>
+class PipelineStage final : public PipelineStageBase {
+ public:
+  static constexpr bool kSink = std::is_void_v<Out>;
+  using OutItem = std::conditional_t<kSink, char, Out>;  // unused by a sink
+
+  PipelineStage(std::string name,
+                size_t workers,
+                Fn fn,
+                const PipelineOptions& options)
+      : input(options.queue_capacity),
+        name(std::move(name)),
+        workers(std::max<size_t>(workers, 1)),
+        fn(std::move(fn)),
+        ordered(options.ordered),
+        window(std::max(options.queue_capacity, this->workers)) {}
+
+  void start() override {
+    remaining.store(workers, std::memory_order_relaxed);
+    for (size_t w = 0; w < workers; ++w) {
+      threads.emplace_back([this] { work(); });
+    }
+  }
+
+  void join() override {
+    for (auto& t : threads) t.join();
+    threads.clear();
+  }
+
+  PipelineStageStats stats() const override {
+    return {name,
+            workers,
+            items.load(std::memory_order_relaxed),
+            busy_ns.load(std::memory_order_relaxed) / 1e6,
+            starved_ns.load(std::memory_order_relaxed) / 1e6,
+            stalled_ns.load(std::memory_order_relaxed) / 1e6,
+            input.size(),
+            input.max_size()};
+  }
+
+  PipelineLink<In> input;
+  PipelineLink<OutItem>* output = nullptr;  // wired by the builder
+
+ private:
+  void work() {
+    PipelineBatch<In> in;
+    while (true) {
+      starved_ns.fetch_add(input.pop(in), std::memory_order_relaxed);
+      if (in.seq == PipelineBatch<In>::kEnd) {
+        break;
+      }
+
+      const int64_t start = pipeline_now_ns();
+      if constexpr (kSink) {
+        if (!failed.load(std::memory_order_relaxed)) {
+          try {
+            for (In& item : in.items) fn(std::move(item));
+          } catch (...) {
+            fail();
+          }
+        }
+        busy_ns.fetch_add(pipeline_now_ns() - start,
+                          std::memory_order_relaxed);
+      } else {
+        // a failed stage still forwards (empty) batches: ordered
+        // downstream stages wait for every number
+        PipelineBatch<OutItem> out{in.seq, {}};
+        if (!failed.load(std::memory_order_relaxed)) {
+          try {
+            out.items.reserve(in.items.size());
+            for (In& item : in.items) out.items.push_back(fn(std::move(item)));
+          } catch (...) {
+            out.items.clear();
+            fail();
+          }
+        }
+        busy_ns.fetch_add(pipeline_now_ns() - start,
+                          std::memory_order_relaxed);
+        deliver(std::move(out));
+      }
+      items.fetch_add(in.items.size(), std::memory_order_relaxed);
+    }
+
+    // the last worker out: every batch of this stage has been delivered
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if constexpr (!kSink) {
+        for (size_t w = 0; w < downstream_workers; ++w) {
+          output->push({PipelineBatch<OutItem>::kEnd, {}});
+        }
+      }
+    }
+  }
+
+  void deliver(PipelineBatch<OutItem>&& batch) {
+    if (!ordered || workers == 1) {
+      stalled_ns.fetch_add(output->push(std::move(batch)),
+                           std::memory_order_relaxed);
+      return;
+    }
+
+    const int64_t start = pipeline_now_ns();
+    std::unique_lock<std::mutex> locker(reorder_mtx);
+    // the batch numbered |next_seq| is being worked on by someone who is
+    // not waiting here, so this always makes progress
+    reorder_cv.wait(locker, [&] { return batch.seq < next_seq + window; });
+    held.emplace(batch.seq, std::move(batch));
+
+    bool released = false;
+    for (auto it = held.begin(); it != held.end() && it->first == next_seq;
+         it = held.erase(it)) {
+      output->push(std::move(it->second));  // in order: under the lock
+      ++next_seq;
+      released = true;
+    }
+    locker.unlock();
+    if (released) {
+      reorder_cv.notify_all();
+    }
+    stalled_ns.fetch_add(pipeline_now_ns() - start, std::memory_order_relaxed);
+  }
+
+  void fail() {
+    std::lock_guard<std::mutex> locker(error_mtx);
+    if (!error) {
+      error = std::current_exception();
+    }
+    failed.store(true, std::memory_order_relaxed);
+  }
+
+  const std::string name;
+  const size_t workers;
+  Fn fn;
+  const bool ordered;
+  const size_t window;  // batches a worker may run ahead of the oldest
+
+  std::atomic<uint64_t> items{0};
+  std::atomic<int64_t> busy_ns{0};
+  std::atomic<int64_t> starved_ns{0};
+  std::atomic<int64_t> stalled_ns{0};
+
+  std::atomic<bool> failed{false};
+  std::mutex error_mtx;
+
+  // ordered only: output batches waiting for their turn
+  std::mutex reorder_mtx;
+  std::condition_variable reorder_cv;
+  std::map<uint64_t, PipelineBatch<OutItem>> held;
+  uint64_t next_seq = 0;
+
+  std::atomic<size_t> remaining{0};
+  std::vector<std::thread> threads;
+};
+
+template <typename In>
+struct PipelineCore {
+  explicit PipelineCore(PipelineOptions options)
+      : options(options) {
+    this->options.batch_size = std::max<size_t>(options.batch_size, 1);
+  }
+
+  PipelineOptions options;
+  std::vector<std::unique_ptr<PipelineStageBase>> stages;
+  PipelineLink<In>* head = nullptr;
+  size_t head_workers = 0;
+};
+
+}  // namespace detail
+
+template <typename In>
+class Pipeline {
+ public:
+  Pipeline(Pipeline&&) = default;
+
+  ~Pipeline() {
+    try {
+      finish();
+    } catch (...) {
+      // call finish() to see it
+    }
+  }
+
+  // Blocks while the first stage's queue is full.
+  void push(In item) {
+    pending.items.push_back(std::move(item));
+    ++pushed;
+    if (pending.items.size() == core->options.batch_size) {
+      flush();
+    }
+  }
+
+  // Pushes what is buffered, waits for every stage to drain and stop, and
+  // rethrows the first exception a stage threw. Call once; the pipeline
+  // cannot be fed afterwards.
+  void finish() {
+    if (!core || finished) {
+      return;
+    }
+    finished = true;
+    if (!pending.items.empty()) {
+      flush();
+    }
+    for (size_t w = 0; w < core->head_workers; ++w) {
+      core->head->push({detail::PipelineBatch<In>::kEnd, {}});
+    }
+    for (auto& stage : core->stages) {
+      stage->join();
+    }
+    for (auto& stage : core->stages) {
+      if (stage->error) {
+        std::rethrow_exception(stage->error);
+      }
+    }
+  }
+
+  // Source first (its stalled time is push() blocked on backpressure),
+  // then every stage in order.
+  std::vector<PipelineStageStats> stats() const {
+    std::vector<PipelineStageStats> all;
+    PipelineStageStats source;
+    source.name = "source";
+    source.workers = 1;
+    source.items = pushed;
+    source.stalled_ms = source_stalled_ns / 1e6;
+    all.push_back(source);
+    for (auto& stage : core->stages) {
+      all.push_back(stage->stats());
+    }
+    return all;
+  }
+
+ private:
+  template <typename, typename>
+  friend class PipelineBuilder;
+
+  explicit Pipeline(std::unique_ptr<detail::PipelineCore<In>> c)
+      : core(std::move(c)) {
+    for (auto& stage : core->stages) {
+      stage->start();
+    }
+  }
+
+  void flush() {
+    pending.seq = next_seq++;
+    source_stalled_ns += core->head->push(std::move(pending));
+    pending.items.clear();  // moved-from: valid, unspecified
+    pending.items.reserve(core->options.batch_size);
+  }
+
+  std::unique_ptr<detail::PipelineCore<In>> core;
+  detail::PipelineBatch<In> pending;
+  uint64_t next_seq = 0;
+  uint64_t pushed = 0;             // push() thread only
+  int64_t source_stalled_ns = 0;  // push() thread only
+  bool finished = false;
+};
+
+// Builds the chain stage by stage; T is the item type the next stage
+// receives. Each stage function takes a T (by value or const&) and returns
+// the next stage's item; the sink's returns void.
+template <typename In, typename T = In>
+class PipelineBuilder {
+ public:
+  explicit PipelineBuilder(PipelineOptions options = {})
+    requires std::is_same_v<In, T>
+      : core(std::make_unique<detail::PipelineCore<In>>(options)),
+        tail(&core->head) {}
+
+  template <typename Fn>
+  auto stage(std::string name, size_t workers, Fn fn) && {
+    using Out = std::remove_cvref_t<std::invoke_result_t<Fn&, T&&>>;
+    static_assert(!std::is_void_v<Out>, "use sink() for the last stage");
+    auto* s = append<Out>(std::move(name), workers, std::move(fn));
+    return PipelineBuilder<In, Out>(std::move(core), &s->output);
+  }
+
+  template <typename Fn>
+  Pipeline<In> sink(std::string name, size_t workers, Fn fn) && {
+    append<void>(std::move(name), workers, std::move(fn));
+    return Pipeline<In>(std::move(core));
+  }
+
+ private:
+  template <typename, typename>
+  friend class PipelineBuilder;
+
+  PipelineBuilder(std::unique_ptr<detail::PipelineCore<In>> core,
+                  detail::PipelineLink<T>** tail)
+      : core(std::move(core)), tail(tail) {}
+
+  template <typename Out, typename Fn>
+  auto* append(std::string name, size_t workers, Fn fn) {
+    auto stage = std::make_unique<detail::PipelineStage<T, Out, Fn>>(
+        std::move(name), workers, std::move(fn), core->options);
+    auto* s = stage.get();
+    *tail = &s->input;
+    const size_t n = std::max<size_t>(workers, 1);
+    if (core->stages.empty()) {
+      core->head_workers = n;
+    } else {
+      core->stages.back()->downstream_workers = n;
+    }
+    core->stages.push_back(std::move(stage));
+    return s;
+  }
+
+  std::unique_ptr<detail::PipelineCore<In>> core;
+  detail::PipelineLink<T>** tail;  // the previous stage's output
+};
+
+}  // namespace MT
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "epoch_reclamation.cpp"
+
+namespace MT {
+
+// ------------
+// Read-copy-update (RCU) price cache
+// ------------
+//
+// Same interface as DataCache (update/get), for read-mostly data.
+//
+// DataCache::get takes a shared lock: even readers write the lock word, so
+// with many readers its cache line bounces between cores and reads stop
+// scaling.
+//
+// RcuDataCache:
+//   - readers: pin the epoch (a write to a thread-private line), load the
+//     current snapshot pointer, look up, unpin; no shared writes, no waiting
+//   - writers: copy the current snapshot, apply the change, publish the copy
+//     with one atomic exchange; writers serialize on a mutex
+//   - the replaced snapshot is retired to the epoch domain and freed once
+//     no reader can still be looking at it
+//
+// Every update copies the whole map, so batch writes with update_batch()
+// when they arrive together.
+
+class RcuDataCache {
+ public:
+  using Update = std::pair<std::string, double>;
+
+  RcuDataCache() : current(new Snapshot()) {}
+
+  ~RcuDataCache() { delete current.load(std::memory_order_relaxed); }
+
+  RcuDataCache(const RcuDataCache&) = delete;
+  RcuDataCache& operator=(const RcuDataCache&) = delete;
+
+  void update(const std::string& symbol, double price) {
+    Update single(symbol, price);
+    update_batch(std::span<const Update>(&single, 1));
+  }
+
+  // Applies all |updates| in one new snapshot: readers see either none or
+  // all of them.
+  void update_batch(std::span<const Update> updates) {
+    std::lock_guard<std::mutex> locker(writer_mtx);
+
+    // only writers replace |current|, and we hold the writer lock
+    const Snapshot* old = current.load(std::memory_order_relaxed);
+    auto* next = new Snapshot(*old);
+    for (const auto& [symbol, price] : updates) {
+      next->data[symbol] = price;
+    }
+
+    current.exchange(next, std::memory_order_seq_cst);
+    epoch_domain().retire(const_cast<Snapshot*>(old));
+  }
+
+  double get(const std::string& symbol) const {
+    auto guard = epoch_domain().pin();
+
+    // seq_cst to stay ordered after the pin; a plain load on x86
+    const Snapshot* snapshot = current.load(std::memory_order_seq_cst);
+    auto it = snapshot->data.find(symbol);
+
+    return it == snapshot->data.end() ? 0.0 : it->second;
+  }
+
+ private:
+  struct Snapshot {
+    std::unordered_map<std::string, double> data;
+  };
+
+  alignas(64) std::atomic<const Snapshot*> current;
+  alignas(64) std::mutex writer_mtx;
+};
+
+}  // namespace MT
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace MT {
+
+// ------------
+// Sharded counter
+// ------------
+//
+// spawn_threads* in one class:
+//   - spawn_threads:  one atomic, every increment bounces the same line
+//   - spawn_threads2: one atomic per thread, but packed -> false sharing
+//   - spawn_threads3: one atomic per thread, each on its own cache line
+//
+// ShardedCounter keeps one padded atomic per shard (shards = cores rounded
+// up to a power of two). add() goes to the shard of the CPU the thread runs
+// on (Linux) or of the thread itself, so concurrent writers rarely share a
+// line. Reads sum all shards: O(shards), meant for counters that are
+// written far more often than read (stats, hit counts, log counts).
+//
+// load() is not a snapshot: adds that race with it may or may not be
+// included. Once writers are done it is exact.
+//
+// load_approx() reuses the last sum while it is younger than |max_age|, so
+// frequent readers pay O(1) and see a value at most |max_age| old.
+
+template <typename T>
+  requires std::is_arithmetic_v<T>
+class ShardedCounter {
+ public:
+  explicit ShardedCounter(size_t num_shards = default_shards())
+      : mask(std::bit_ceil(std::max<size_t>(num_shards, 1)) - 1),
+        shards(std::make_unique<Shard[]>(mask + 1)) {}
+
+  ShardedCounter(const ShardedCounter&) = delete;
+  ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+  void add(T delta) {
+    shards[shard_index() & mask].value.fetch_add(delta,
+                                                 std::memory_order_relaxed);
+  }
+
+  void increment() { add(T{1}); }
+
+  T load() const {
+    T sum{};
+    for (size_t i = 0; i <= mask; ++i) {
+      sum += shards[i].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+
+  T load_approx(std::chrono::nanoseconds max_age) const {
+    const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count();
+    if (now - cache.taken_at.load(std::memory_order_acquire) <
+        max_age.count()) {
+      return cache.sum.load(std::memory_order_relaxed);
+    }
+
+    // several readers may refresh at once; any of their sums is fine
+    T sum = load();
+    cache.sum.store(sum, std::memory_order_relaxed);
+    cache.taken_at.store(now, std::memory_order_release);
+    return sum;
+  }
+
+  size_t num_shards() const { return mask + 1; }
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<T> value{};
+  };
+
+  struct alignas(64) Cache {
+    std::atomic<T> sum{};
+    std::atomic<int64_t> taken_at{INT64_MIN / 2};
+  };
+
+  static size_t default_shards() {
+    return std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // CPU id where available: threads that time-share a core also share a
+  // shard, which is harmless since they never run at the same time.
+  // Otherwise a per-thread index handed out round-robin.
+  static size_t shard_index() {
+#if defined(__linux__)
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+      return static_cast<size_t>(cpu);
+    }
+#endif
+    return thread_index();
+  }
+
+  static size_t thread_index() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+  }
+
+  const size_t mask;
+  std::unique_ptr<Shard[]> shards;
+  mutable Cache cache;
+};
+
+}  // namespace MT
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "epoch_reclamation.cpp"
+#include "spinlock.cpp"
+#include "symbol_table.cpp"
+
+namespace MT {
+
+// ------------
+// Sharded concurrent price map
+// ------------
+//
+// SymbolId -> price, split into independent shards so writers to different
+// symbols do not share a lock:
+//   - shard = high bits of a multiplicative hash of the id
+//   - inside a shard: open addressing with linear probing over a flat
+//     array of (key, value) slots, no per-entry allocation
+//   - writers take the shard's TtasLock and bracket their stores with a
+//     sequence counter (seqlock): odd while writing
+//   - readers take no lock: read the counter, probe, re-read the counter,
+//     retry if a write overlapped
+//
+// A shard grows by building a table twice the size and publishing it; the
+// old table is retired to the epoch domain, readers are pinned while they
+// probe.
+//
+// Seqlock ordering without fences (ThreadSanitizer does not model them):
+// writers store the data with release after the relaxed "odd" store,
+// readers load the data with acquire before the relaxed re-read of the
+// counter. Both compile to plain moves on x86.
+
+class ConcurrentPriceMap {
+ public:
+  using Entry = std::pair<SymbolId, double>;
+
+  explicit ConcurrentPriceMap(size_t num_shards = 64)
+      : shard_bits(std::countr_zero(
+            std::bit_ceil(std::max<size_t>(num_shards, 2)))),
+        shards(std::make_unique<Shard[]>(this->num_shards())) {
+    for (size_t i = 0; i < this->num_shards(); ++i) {
+      shards[i].table.store(new Table(kInitialCapacity),
+                            std::memory_order_relaxed);
+    }
+  }
+
+  ~ConcurrentPriceMap() {
+    for (size_t i = 0; i < num_shards(); ++i) {
+      delete shards[i].table.load(std::memory_order_relaxed);
+    }
+  }
+
+  ConcurrentPriceMap(const ConcurrentPriceMap&) = delete;
+  ConcurrentPriceMap& operator=(const ConcurrentPriceMap&) = delete;
+
+  size_t num_shards() const { return size_t{1} << shard_bits; }
+
+  void put(SymbolId id, double price) {
+    Shard& shard = shard_of(hash(id));
+    std::lock_guard<TtasLock> locker(shard.lock);
+    WriteSection section(shard);
+    insert(shard, id, price);
+  }
+
+  // Groups |entries| by shard (counting sort, keeps their order so later
+  // entries for the same id still win) and takes every shard lock once.
+  void put_batch(std::span<const Entry> entries) {
+    std::vector<uint32_t> begin(num_shards() + 1, 0);
+    for (const Entry& e : entries) {
+      ++begin[shard_index(hash(e.first)) + 1];
+    }
+    for (size_t s = 0; s < num_shards(); ++s) {
+      begin[s + 1] += begin[s];
+    }
+
+    std::vector<const Entry*> grouped(entries.size());
+    std::vector<uint32_t> next(begin.begin(), begin.end() - 1);
+    for (const Entry& e : entries) {
+      grouped[next[shard_index(hash(e.first))]++] = &e;
+    }
+
+    for (size_t s = 0; s < num_shards(); ++s) {
+      if (begin[s] == begin[s + 1]) {
+        continue;
+      }
+      Shard& shard = shards[s];
+      std::lock_guard<TtasLock> locker(shard.lock);
+      WriteSection section(shard);
+      for (uint32_t i = begin[s]; i < begin[s + 1]; ++i) {
+        insert(shard, grouped[i]->first, grouped[i]->second);
+      }
+    }
+  }
+
+  // Returns false if |id| was never put.
+  bool get(SymbolId id, double& out) const {
+    auto guard = epoch_domain().pin();
+    return read(id, out);
+  }
+
+  // out[i] = price of ids[i], or |missing|. One epoch pin for the batch.
+  void get_batch(std::span<const SymbolId> ids,
+                 std::span<double> out,
+                 double missing = 0.0) const {
+    auto guard = epoch_domain().pin();
+    for (size_t i = 0; i < ids.size(); ++i) {
+      if (!read(ids[i], out[i])) {
+        out[i] = missing;
+      }
+    }
+  }
+
+ private:
+  static constexpr SymbolId kEmpty = std::numeric_limits<SymbolId>::max();
+  static constexpr size_t kInitialCapacity = 16;
+
+  struct Slot {
+    std::atomic<SymbolId> key{kEmpty};
+    std::atomic<double> value{0.0};
+  };
+
+  struct Table {
+    explicit Table(size_t capacity)
+        : mask(capacity - 1), slots(std::make_unique<Slot[]>(capacity)) {}
+
+    const size_t mask;
+    std::unique_ptr<Slot[]> slots;
+  };
+
+  struct alignas(64) Shard {
+    TtasLock lock;
+    alignas(64) std::atomic<uint64_t> seq{0};
+    std::atomic<Table*> table{nullptr};
+    size_t size = 0;  // guarded by |lock|
+  };
+
+  // Marks the shard as being written for the lifetime of the object.
+  struct WriteSection {
+    explicit WriteSection(Shard& shard) : shard(shard) {
+      shard.seq.store(shard.seq.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+    }
+    ~WriteSection() {
+      shard.seq.store(shard.seq.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_release);
+    }
+    Shard& shard;
+  };
+
+  static uint64_t hash(SymbolId id) {
+    return (uint64_t{id} + 1) * 0x9E3779B97F4A7C15ull;
+  }
+
+  size_t shard_index(uint64_t h) const { return h >> (64 - shard_bits); }
+  Shard& shard_of(uint64_t h) const { return shards[shard_index(h)]; }
+
+  bool read(SymbolId id, double& out) const {
+    const uint64_t h = hash(id);
+    const Shard& shard = shard_of(h);
+
+    Backoff backoff;
+    while (true) {
+      const uint64_t before = shard.seq.load(std::memory_order_acquire);
+      if (before & 1) {
+        backoff.pause();  // a writer is mid-update
+        continue;
+      }
+
+      const Table* table = shard.table.load(std::memory_order_acquire);
+      bool found = false;
+      for (size_t i = h; ; ++i) {
+        const Slot& slot = table->slots[i & table->mask];
+        SymbolId key = slot.key.load(std::memory_order_acquire);
+        if (key == id) {
+          out = slot.value.load(std::memory_order_acquire);
+          found = true;
+          break;
+        }
+        if (key == kEmpty) {
+          break;
+        }
+      }
+
+      if (shard.seq.load(std::memory_order_relaxed) == before) {
+        return found;
+      }
+    }
+  }
+
+  // Caller holds the shard lock inside a WriteSection.
+  void insert(Shard& shard, SymbolId id, double price) {
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if ((shard.size + 1) * 2 > table->mask + 1) {
+      table = grow(shard, table);
+    }
+
+    for (size_t i = hash(id); ; ++i) {
+      Slot& slot = table->slots[i & table->mask];
+      SymbolId key = slot.key.load(std::memory_order_relaxed);
+      if (key == id) {
+        slot.value.store(price, std::memory_order_release);
+        return;
+      }
+      if (key == kEmpty) {
+        // value first: a reader that sees the key sees the value
+        slot.value.store(price, std::memory_order_release);
+        slot.key.store(id, std::memory_order_release);
+        ++shard.size;
+        return;
+      }
+    }
+  }
+
+  Table* grow(Shard& shard, Table* old) {
+    auto* bigger = new Table(2 * (old->mask + 1));
+    for (size_t s = 0; s <= old->mask; ++s) {
+      SymbolId key = old->slots[s].key.load(std::memory_order_relaxed);
+      if (key == kEmpty) {
+        continue;
+      }
+      for (size_t i = hash(key); ; ++i) {
+        Slot& slot = bigger->slots[i & bigger->mask];
+        if (slot.key.load(std::memory_order_relaxed) == kEmpty) {
+          slot.value.store(old->slots[s].value.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+          slot.key.store(key, std::memory_order_relaxed);
+          break;
+        }
+      }
+    }
+
+    shard.table.store(bigger, std::memory_order_release);
+    epoch_domain().retire(old);
+    return bigger;
+  }
+
+  const int shard_bits;
+  std::unique_ptr<Shard[]> shards;
+};
+
+// ------------
+// DataCache on interned symbols
+// ------------
+//
+// Same update/get interface as DataCache, plus id-based calls for callers
+// that resolve their symbols once up front.
+
+class ShardedDataCache {
+ public:
+  using Update = std::pair<std::string, double>;
+
+  SymbolId intern(const std::string& symbol) { return symbols.intern(symbol); }
+
+  void update(const std::string& symbol, double price) {
+    prices.put(symbols.intern(symbol), price);
+  }
+
+  void update(SymbolId id, double price) { prices.put(id, price); }
+
+  double get(const std::string& symbol) const {
+    auto id = symbols.find(symbol);
+    return id ? get(*id) : 0.0;
+  }
+
+  double get(SymbolId id) const {
+    double price;
+    return prices.get(id, price) ? price : 0.0;
+  }
+
+  void update_batch(std::span<const Update> updates) {
+    std::vector<ConcurrentPriceMap::Entry> entries;
+    entries.reserve(updates.size());
+    for (const auto& [symbol, price] : updates) {
+      entries.emplace_back(symbols.intern(symbol), price);
+    }
+    prices.put_batch(entries);
+  }
+
+  void update_batch(std::span<const ConcurrentPriceMap::Entry> entries) {
+    prices.put_batch(entries);
+  }
+
+  void get_batch(std::span<const SymbolId> ids, std::span<double> out) const {
+    prices.get_batch(ids, out);
+  }
+
+ private:
+  SymbolTable symbols;
+  ConcurrentPriceMap prices;
+};
+
+}  // namespace MT
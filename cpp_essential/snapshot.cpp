@@ -0,0 +1,321 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.cpp"
+
+namespace MT {
+
+// ------------
+// Price snapshot file
+// ------------
+//
+// symbol -> price pairs, sorted by symbol, in a layout that is used in
+// place after mapping the file:
+//
+//   SnapshotHeader | SnapshotEntry[num_entries] | names (concatenated)
+//
+// Each entry points into the names blob by (offset, size), so loading
+// never parses or allocates per entry just to read a name, and a lookup
+// can binary search the mapped file without loading it at all.
+//
+// Files are written atomically: to "<path>.tmp", fsync'ed, then renamed
+// over |path|. A crash mid-write leaves the previous snapshot intact.
+
+struct SnapshotHeader {
+  char magic[4] = {'S', 'N', 'A', 'P'};
+  uint32_t version = 1;
+  uint64_t num_entries = 0;
+  uint64_t names_size = 0;
+};
+
+struct SnapshotEntry {
+  uint32_t name_offset;
+  uint32_t name_size;
+  double price;
+};
+
+// A snapshot built in memory, ready to be written.
+struct SnapshotImage {
+  std::vector<SnapshotEntry> entries;
+  std::string names;
+};
+
+// Appends one (name, price) pair. The image is unsorted until
+// sort_snapshot_image(); names are copied, so |name| may go away after.
+inline void add_snapshot_entry(SnapshotImage& image,
+                               std::string_view name,
+                               double price) {
+  if (image.names.size() + name.size() >
+      std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("snapshot names exceed 4 GiB");
+  }
+  image.entries.push_back(
+      {uint32_t(image.names.size()), uint32_t(name.size()), price});
+  image.names.append(name);
+}
+
+// Sorts the entries by name. The names blob stays in insertion order: an
+// entry finds its name by offset, so only the 16-byte entries move.
+inline void sort_snapshot_image(SnapshotImage& image) {
+  const char* names = image.names.data();
+  std::sort(image.entries.begin(), image.entries.end(),
+            [names](const SnapshotEntry& a, const SnapshotEntry& b) {
+              return std::string_view(names + a.name_offset, a.name_size) <
+                     std::string_view(names + b.name_offset, b.name_size);
+            });
+}
+
+// Packs (name, price) pairs from |data| (any range of pairs whose first is
+// convertible to string_view, e.g. a map) into a sorted image. A caller
+// that must lock |data| can instead copy under the lock with
+// add_snapshot_entry() and sort after releasing it.
+template <typename Map>
+SnapshotImage make_snapshot_image(const Map& data) {
+  SnapshotImage image;
+  image.entries.reserve(data.size());
+  for (const auto& [name, price] : data) {
+    add_snapshot_entry(image, name, price);
+  }
+  sort_snapshot_image(image);
+  return image;
+}
+
+namespace detail {
+
+inline void write_all(int fd,
+                      const void* data,
+                      size_t size,
+                      const std::string& path) {
+  auto* p = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t n = ::write(fd, p, size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      throw std::system_error(errno, std::generic_category(),
+                              "write " + path);
+    }
+    p += n;
+    size -= size_t(n);
+  }
+}
+
+}  // namespace detail
+
+inline void write_snapshot(const std::string& path,
+                           const SnapshotImage& image) {
+  const std::string tmp = path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + tmp);
+  }
+
+  try {
+    SnapshotHeader header;
+    header.num_entries = image.entries.size();
+    header.names_size = image.names.size();
+    detail::write_all(fd, &header, sizeof(header), tmp);
+    detail::write_all(fd, image.entries.data(),
+                      image.entries.size() * sizeof(SnapshotEntry), tmp);
+    detail::write_all(fd, image.names.data(), image.names.size(), tmp);
+
+    // data on disk before the rename makes it visible
+    if (::fsync(fd) != 0) {
+      throw std::system_error(errno, std::generic_category(), "fsync " + tmp);
+    }
+  } catch (...) {
+    ::close(fd);
+    ::unlink(tmp.c_str());
+    throw;
+  }
+  ::close(fd);
+
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    int err = errno;
+    ::unlink(tmp.c_str());
+    throw std::system_error(err, std::generic_category(), "rename " + tmp);
+  }
+
+  // and the rename itself on disk
+  std::string dir = std::filesystem::path(path).parent_path().string();
+  int dir_fd = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+  if (dir_fd >= 0) {
+    ::fsync(dir_fd);
+    ::close(dir_fd);
+  }
+}
+
+// A mapped snapshot file. Names are string_views into the mapping: valid
+// while the SnapshotFile lives.
+class SnapshotFile {
+ public:
+  explicit SnapshotFile(const std::string& path) : file(path) {
+    if (!valid()) {
+      throw std::runtime_error("Not a snapshot file: " + path);
+    }
+    file.advise_sequential();
+  }
+
+  size_t size() const { return size_t(header().num_entries); }
+
+  std::string_view name(size_t i) const {
+    const SnapshotEntry& e = entries()[i];
+    return {names() + e.name_offset, e.name_size};
+  }
+
+  double price(size_t i) const { return entries()[i].price; }
+
+  // For a file kept open for lookups after a front-to-back pass: drops the
+  // sequential read-ahead the constructor asked for.
+  void advise_random() const { file.advise_random(); }
+
+  // Calls |fn(name, price)| for every entry, in name order.
+  template <typename Fn>
+  void for_each(Fn&& fn) const {
+    for (size_t i = 0; i < size(); ++i) {
+      fn(name(i), price(i));
+    }
+  }
+
+  // Binary search on the mapped entries; touches O(log n) pages.
+  std::optional<double> find(std::string_view symbol) const {
+    size_t lo = 0, hi = size();
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (name(mid) < symbol) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    if (lo < size() && name(lo) == symbol) {
+      return price(lo);
+    }
+    return std::nullopt;
+  }
+
+ private:
+  const SnapshotHeader& header() const {
+    return *reinterpret_cast<const SnapshotHeader*>(file.bytes().data());
+  }
+
+  const SnapshotEntry* entries() const {
+    return reinterpret_cast<const SnapshotEntry*>(file.bytes().data() +
+                                                  sizeof(SnapshotHeader));
+  }
+
+  const char* names() const {
+    return reinterpret_cast<const char*>(entries() + size());
+  }
+
+  bool valid() const {
+    const size_t length = file.bytes().size();
+    if (length < sizeof(SnapshotHeader)) {
+      return false;
+    }
+    const SnapshotHeader& h = header();
+    if (std::memcmp(h.magic, "SNAP", 4) != 0 || h.version != 1 ||
+        h.num_entries > (length - sizeof(SnapshotHeader)) /
+                            sizeof(SnapshotEntry) ||
+        length != sizeof(SnapshotHeader) +
+                      h.num_entries * sizeof(SnapshotEntry) + h.names_size) {
+      return false;
+    }
+    // every name inside the blob
+    for (size_t i = 0; i < size(); ++i) {
+      const SnapshotEntry& e = entries()[i];
+      if (uint64_t{e.name_offset} + e.name_size > h.names_size) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  MappedFile file;
+};
+
+// ------------
+// Periodic snapshots
+// ------------
+//
+// Calls |save| every |interval| on a background thread, and once more on
+// destruction so a clean shutdown leaves an up-to-date file. A failed save
+// is reported and retried at the next interval.
+
+class PeriodicSnapshot {
+ public:
+  PeriodicSnapshot(std::chrono::milliseconds interval,
+                   std::function<void()> save)
+      : interval(interval), save(std::move(save)), worker([this] { loop(); }) {}
+
+  ~PeriodicSnapshot() {
+    {
+      std::lock_guard<std::mutex> locker(mtx);
+      stopping = true;
+    }
+    cv.notify_one();
+    worker.join();
+    save_once();
+  }
+
+  PeriodicSnapshot(const PeriodicSnapshot&) = delete;
+  PeriodicSnapshot& operator=(const PeriodicSnapshot&) = delete;
+
+  uint64_t saves() const { return num_saves.load(); }
+
+ private:
+  void loop() {
+    std::unique_lock<std::mutex> locker(mtx);
+    while (!cv.wait_for(locker, interval, [this] { return stopping; })) {
+      locker.unlock();
+      save_once();
+      locker.lock();
+    }
+  }
+
+  void save_once() {
+    try {
+      save();
+      num_saves.fetch_add(1);
+    } catch (const std::exception& e) {
+      std::cerr << "snapshot failed: " << e.what() << "\n";
+    }
+  }
+
+  const std::chrono::milliseconds interval;
+  std::function<void()> save;
+  std::atomic<uint64_t> num_saves{0};
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool stopping = false;  // guarded by |mtx|
+
+  std::thread worker;  // last: starts after the members it uses
+};
+
+}  // namespace MT
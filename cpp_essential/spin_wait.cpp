@@ -0,0 +1,32 @@
+#pragma once
+
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace MT {
+
+// ------------
+// cpu_relax
+// ------------
+//
+// Body of every busy-wait loop. Tells the core it is spinning:
+//   - x86 `pause`: backs off the pipeline, gives the sibling hyper-thread
+//     the execution units, avoids the memory-order flush when the loop exits
+//   - arm64 `yield`: same hint for SMT cores
+//
+// Falls back to yielding the time slice on other targets.
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#else
+  std::this_thread::yield();
+#endif
+}
+
+}  // namespace MT
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+
+#include "spin_wait.cpp"
+
+namespace MT {
+
+// ------------
+// Spinlocks
+// ------------
+//
+// All locks model Lockable (lock / try_lock / unlock), like std::mutex, so
+// they work with std::lock_guard / std::unique_lock and can be swapped in
+// templates.
+//
+//   TtasLock          test-and-test-and-set + exponential backoff
+//                     cheapest uncontended, unfair
+//   TicketLock        FIFO: take a number, wait until it is served
+//                     fair, but every waiter polls the same line
+//   McsLock           FIFO queue of per-thread nodes, each waiter spins on
+//                     its own line; one cache miss per hand-over
+//   SpinThenParkLock  spin briefly, then sleep with std::atomic::wait
+//                     (a futex on Linux); for critical sections that may
+//                     be long or threads > cores
+//
+// Pure spinning only makes sense when the holder is running on another
+// core; all spinners fall back to yielding once the backoff is exhausted so
+// an oversubscribed machine does not burn whole time slices.
+
+template <typename L>
+concept Lockable = requires(L& lock) {
+  lock.lock();
+  { lock.try_lock() } -> std::convertible_to<bool>;
+  lock.unlock();
+};
+
+// Exponential backoff for spin loops: 1, 2, 4, ... cpu_relax() per call up
+// to |kMaxPauses|, then yields the time slice.
+class Backoff {
+ public:
+  void pause() {
+    if (pauses <= kMaxPauses) {
+      for (int i = 0; i < pauses; ++i) cpu_relax();
+      pauses *= 2;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  static constexpr int kMaxPauses = 64;
+  int pauses = 1;
+};
+
+// Spins on a plain load ("test") and only tries the exchange ("test-and-set")
+// once the lock looks free: waiters share the line read-only instead of
+// bouncing it with writes.
+class TtasLock {
+ public:
+  void lock() {
+    Backoff backoff;
+    while (locked.exchange(true, std::memory_order_acquire)) {
+      while (locked.load(std::memory_order_relaxed)) {
+        backoff.pause();
+      }
+    }
+  }
+
+  bool try_lock() {
+    return !locked.load(std::memory_order_relaxed) &&
+           !locked.exchange(true, std::memory_order_acquire);
+  }
+
+  void unlock() { locked.store(false, std::memory_order_release); }
+
+ private:
+  alignas(64) std::atomic<bool> locked{false};
+};
+
+// Threads are served in arrival order. Backoff is proportional to the
+// number of tickets ahead.
+class TicketLock {
+ public:
+  void lock() {
+    const uint32_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+    int spins = 0;
+    while (true) {
+      const uint32_t served = serving.load(std::memory_order_acquire);
+      if (served == ticket) {
+        return;
+      }
+      if (++spins > kMaxSpins) {
+        std::this_thread::yield();
+        continue;
+      }
+      for (uint32_t i = 0; i < ticket - served; ++i) cpu_relax();
+    }
+  }
+
+  bool try_lock() {
+    uint32_t served = serving.load(std::memory_order_relaxed);
+    uint32_t expected = served;
+    return next.compare_exchange_strong(
+        expected, served + 1, std::memory_order_acquire);
+  }
+
+  // only the holder writes |serving|
+  void unlock() {
+    serving.store(serving.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+  }
+
+ private:
+  static constexpr int kMaxSpins = 1024;
+
+  alignas(64) std::atomic<uint32_t> next{0};
+  alignas(64) std::atomic<uint32_t> serving{0};
+};
+
+// Mellor-Crummey & Scott queue lock. |tail| points at the last waiter;
+// a new thread appends its node and spins on the node's own |locked| flag,
+// the holder hands over by clearing its successor's flag.
+//
+// lock() takes a node from a small thread-local set, so a thread can hold
+// up to |kNodesPerThread| McsLocks at the same time.
+class McsLock {
+ public:
+  void lock() {
+    Node* node = local_nodes().take();
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+
+    Node* prev = tail.exchange(node, std::memory_order_acq_rel);
+    if (prev) {
+      prev->next.store(node, std::memory_order_release);
+      spin_while([&] { return node->locked.load(std::memory_order_acquire); });
+    }
+    holder = node;
+  }
+
+  bool try_lock() {
+    Node* node = local_nodes().take();
+    node->next.store(nullptr, std::memory_order_relaxed);
+
+    Node* expected = nullptr;
+    if (tail.compare_exchange_strong(
+            expected, node, std::memory_order_acquire)) {
+      holder = node;
+      return true;
+    }
+    local_nodes().give_back(node);
+    return false;
+  }
+
+  void unlock() {
+    Node* node = holder;
+    Node* next = node->next.load(std::memory_order_acquire);
+    if (!next) {
+      Node* expected = node;
+      if (tail.compare_exchange_strong(
+              expected, nullptr, std::memory_order_release)) {
+        local_nodes().give_back(node);
+        return;
+      }
+      // a successor swapped itself into |tail| but has not linked yet
+      spin_while([&] {
+        next = node->next.load(std::memory_order_acquire);
+        return next == nullptr;
+      });
+    }
+    next->locked.store(false, std::memory_order_release);
+    local_nodes().give_back(node);
+  }
+
+ private:
+  struct alignas(64) Node {
+    std::atomic<Node*> next{nullptr};
+    std::atomic<bool> locked{false};
+  };
+
+  static constexpr int kNodesPerThread = 8;
+
+  struct NodeSet {
+    Node nodes[kNodesPerThread];
+    uint32_t used = 0;  // bit i set: nodes[i] is in some lock's queue
+
+    Node* take() {
+      for (int i = 0; i < kNodesPerThread; ++i) {
+        if (!(used & (1u << i))) {
+          used |= 1u << i;
+          return &nodes[i];
+        }
+      }
+      throw std::runtime_error("McsLock: too many locks held by one thread");
+    }
+
+    void give_back(Node* node) { used &= ~(1u << (node - nodes)); }
+  };
+
+  static NodeSet& local_nodes() {
+    thread_local NodeSet set;
+    return set;
+  }
+
+  template <typename Pred>
+  static void spin_while(Pred pred) {
+    Backoff backoff;
+    while (pred()) backoff.pause();
+  }
+
+  alignas(64) std::atomic<Node*> tail{nullptr};
+  // written and read only by the current holder
+  Node* holder = nullptr;
+};
+
+// Three states (Drepper, "Futexes are tricky"):
+//   0 unlocked, 1 locked, 2 locked and someone may be sleeping
+// unlock() only pays for notify_one when the state was 2.
+class SpinThenParkLock {
+ public:
+  void lock() {
+    uint32_t expected = 0;
+    for (int i = 0; i < spin_count(); ++i) {
+      if (state.load(std::memory_order_relaxed) == 0 &&
+          state.compare_exchange_weak(
+              expected, 1, std::memory_order_acquire)) {
+        return;
+      }
+      expected = 0;
+      cpu_relax();
+    }
+
+    // announce a sleeper; acquiring here leaves state 2, which costs at
+    // most one spurious notify
+    while (state.exchange(2, std::memory_order_acquire) != 0) {
+      state.wait(2, std::memory_order_relaxed);
+    }
+  }
+
+  bool try_lock() {
+    uint32_t expected = 0;
+    return state.compare_exchange_strong(
+        expected, 1, std::memory_order_acquire);
+  }
+
+  void unlock() {
+    if (state.exchange(0, std::memory_order_release) == 2) {
+      state.notify_one();
+    }
+  }
+
+ private:
+  // Spinning only helps when the holder runs on another core.
+  static int spin_count() {
+    static const int count =
+        std::thread::hardware_concurrency() > 1 ? 100 : 0;
+    return count;
+  }
+
+  alignas(64) std::atomic<uint32_t> state{0};
+};
+
+}  // namespace MT
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <utility>
+
+#include "spin_wait.cpp"
+
+namespace MT {
+
+// ------------
+// SPSC ring buffer
+// ------------
+//
+// Bounded single-producer / single-consumer queue, lock-free and wait-free
+// for try_push/try_pop.
+//
+// Layout: each side owns one cache line
+//   - producer line: |tail| (published) + |cached_head| (private copy)
+//   - consumer line: |head| (published) + |cached_tail| (private copy)
+// The cached copy of the other side's index is only refreshed when the
+// queue looks full/empty, so in steady state each side reads the other's
+// cache line once per "lap" instead of once per element.
+//
+// |head| and |tail| only grow; slot = index & mask, size = tail - head.
+//
+// Blocking = true adds push()/pop() that sleep with std::atomic::wait once
+// the queue stays full/empty. The waker side then publishes with seq_cst
+// and checks a sleep flag on every operation; with Blocking = false the
+// try_* paths carry no such cost.
+
+template <typename T, bool Blocking = false>
+class SpscQueue {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity)
+      : mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        slots(std::make_unique<T[]>(mask + 1)) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  size_t capacity() const { return mask + 1; }
+
+  // --- producer side ---
+
+  template <typename U>
+  bool try_push(U&& value) {
+    const size_t t = producer.tail.load(std::memory_order_relaxed);
+    if (t - producer.cached_head == capacity()) {
+      producer.cached_head = consumer.head.load(std::memory_order_acquire);
+      if (t - producer.cached_head == capacity()) {
+        return false;
+      }
+    }
+
+    slots[t & mask] = std::forward<U>(value);
+    producer.tail.store(t + 1, kPublish);
+    wake(consumer_sleeping, producer.tail);
+    return true;
+  }
+
+  // Pushes as many leading elements of |items| as fit, publishes them with a
+  // single store. Returns the number pushed.
+  size_t try_push_bulk(std::span<const T> items) {
+    const size_t t = producer.tail.load(std::memory_order_relaxed);
+    size_t free = capacity() - (t - producer.cached_head);
+    if (free < items.size()) {
+      producer.cached_head = consumer.head.load(std::memory_order_acquire);
+      free = capacity() - (t - producer.cached_head);
+    }
+
+    const size_t n = std::min(free, items.size());
+    if (n == 0) {
+      return 0;
+    }
+
+    // at most two contiguous runs: up to the end of the array, then wrap
+    const size_t first = std::min(n, capacity() - (t & mask));
+    std::copy_n(items.begin(), first, slots.get() + (t & mask));
+    std::copy_n(items.begin() + first, n - first, slots.get());
+
+    producer.tail.store(t + n, kPublish);
+    wake(consumer_sleeping, producer.tail);
+    return n;
+  }
+
+  // --- consumer side ---
+
+  bool try_pop(T& out) {
+    const size_t h = consumer.head.load(std::memory_order_relaxed);
+    if (h == consumer.cached_tail) {
+      consumer.cached_tail = producer.tail.load(std::memory_order_acquire);
+      if (h == consumer.cached_tail) {
+        return false;
+      }
+    }
+
+    out = std::move(slots[h & mask]);
+    consumer.head.store(h + 1, kPublish);
+    wake(producer_sleeping, consumer.head);
+    return true;
+  }
+
+  // Pops up to |out.size()| elements, releases the slots with a single store.
+  // Returns the number popped.
+  size_t try_pop_bulk(std::span<T> out) {
+    const size_t h = consumer.head.load(std::memory_order_relaxed);
+    size_t available = consumer.cached_tail - h;
+    if (available < out.size()) {
+      consumer.cached_tail = producer.tail.load(std::memory_order_acquire);
+      available = consumer.cached_tail - h;
+    }
+
+    const size_t n = std::min(available, out.size());
+    if (n == 0) {
+      return 0;
+    }
+
+    const size_t first = std::min(n, capacity() - (h & mask));
+    std::move(slots.get() + (h & mask),
+              slots.get() + (h & mask) + first,
+              out.begin());
+    std::move(slots.get(), slots.get() + (n - first), out.begin() + first);
+
+    consumer.head.store(h + n, kPublish);
+    wake(producer_sleeping, consumer.head);
+    return n;
+  }
+
+  // --- blocking wrappers (Blocking = true only) ---
+
+  template <typename U>
+    requires Blocking
+  void push(U&& value) {
+    while (!try_push(std::forward<U>(value))) {
+      // |value| is only consumed when try_push succeeds
+      sleep_while(producer_sleeping, consumer.head, [&] {
+        return producer.tail.load(std::memory_order_relaxed) -
+                   consumer.head.load(std::memory_order_relaxed) ==
+               capacity();
+      });
+    }
+  }
+
+  T pop()
+    requires Blocking
+  {
+    T out;
+    while (!try_pop(out)) {
+      sleep_while(consumer_sleeping, producer.tail, [&] {
+        return consumer.head.load(std::memory_order_relaxed) ==
+               producer.tail.load(std::memory_order_relaxed);
+      });
+    }
+    return out;
+  }
+
+ private:
+  // Spins briefly, then parks on |index| while |blocked()| holds.
+  //
+  // Sleeper:  sleeping = 1; re-check index; wait(index)
+  // Waker:    index = i + 1; if (sleeping) { sleeping = 0; notify }
+  // Both sides use seq_cst for the flag and the index, so they cannot both
+  // miss each other's store. Only the first publish after the sleeper
+  // parked pays for the notify.
+  template <typename Blocked>
+  void sleep_while(std::atomic<uint32_t>& sleeping,
+                   const std::atomic<size_t>& index,
+                   Blocked blocked) {
+    for (int i = 0; i < spin_count(); ++i) {
+      if (!blocked()) {
+        return;
+      }
+      cpu_relax();
+    }
+
+    const size_t seen = index.load(std::memory_order_relaxed);
+    sleeping.store(1, std::memory_order_seq_cst);
+    if (blocked() && index.load(std::memory_order_seq_cst) == seen) {
+      index.wait(seen, std::memory_order_relaxed);
+    }
+    sleeping.store(0, std::memory_order_relaxed);
+  }
+
+  void wake(std::atomic<uint32_t>& sleeping, std::atomic<size_t>& index) {
+    if constexpr (Blocking) {
+      if (sleeping.load(std::memory_order_seq_cst) &&
+          sleeping.exchange(0, std::memory_order_relaxed)) {
+        index.notify_one();
+      }
+    }
+  }
+
+  // Spinning only helps when the other side runs on another core.
+  static int spin_count() {
+    static const int count =
+        std::thread::hardware_concurrency() > 1 ? 256 : 0;
+    return count;
+  }
+
+  // Blocking queues publish with seq_cst so the store is ordered before
+  // the |sleeping| check in wake().
+  static constexpr std::memory_order kPublish =
+      Blocking ? std::memory_order_seq_cst : std::memory_order_release;
+
+  struct alignas(64) Producer {
+    std::atomic<size_t> tail{0};
+    size_t cached_head = 0;
+  };
+
+  struct alignas(64) Consumer {
+    std::atomic<size_t> head{0};
+    size_t cached_tail = 0;
+  };
+
+  Producer producer;
+  Consumer consumer;
+
+  // sleep flags live on their own line: written only around sleeping
+  alignas(64) std::atomic<uint32_t> producer_sleeping{0};
+  std::atomic<uint32_t> consumer_sleeping{0};
+
+  // read-only after construction
+  alignas(64) const size_t mask;
+  std::unique_ptr<T[]> slots;
+};
+
+}  // namespace MT
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace MT {
+
+// ------------
+// Symbol interning
+// ------------
+//
+// Maps each distinct symbol string to a dense id 0, 1, 2, ... once, so hot
+// paths hash and compare a uint32_t instead of a std::string.
+//
+// Ids are never reused and names never move (std::deque keeps references
+// stable), so name(id) can hand out a reference.
+
+using SymbolId = uint32_t;
+
+class SymbolTable {
+ public:
+  // Returns the id of |symbol|, assigning the next one on first sight.
+  SymbolId intern(std::string_view symbol) {
+    if (auto id = find(symbol)) {
+      return *id;
+    }
+
+    std::unique_lock<std::shared_mutex> locker(mtx);
+    auto [it, inserted] = ids.try_emplace(std::string(symbol),
+                                          static_cast<SymbolId>(names.size()));
+    if (inserted) {
+      names.push_back(it->first);
+    }
+    return it->second;
+  }
+
+  std::optional<SymbolId> find(std::string_view symbol) const {
+    std::shared_lock<std::shared_mutex> locker(mtx);
+    auto it = ids.find(symbol);
+    if (it == ids.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  const std::string& name(SymbolId id) const {
+    std::shared_lock<std::shared_mutex> locker(mtx);
+    return names[id];
+  }
+
+  size_t size() const {
+    std::shared_lock<std::shared_mutex> locker(mtx);
+    return names.size();
+  }
+
+ private:
+  // heterogeneous lookup: find(string_view) without building a std::string
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+
+  mutable std::shared_mutex mtx;
+  std::unordered_map<std::string, SymbolId, Hash, std::equal_to<>> ids;
+  std::deque<std::string> names;
+};
+
+}  // namespace MT
@@ -0,0 +1,389 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "frame_allocator.cpp"
+#include "thread_pool.cpp"
+
+namespace MT {
+
+// ------------
+// Coroutine Task<T>
+// ------------
+//
+// A Task<T> is a lazily started coroutine returning T. Awaiting it from
+// another coroutine:
+//   - starts it on the awaiting thread (symmetric transfer: the awaiter's
+//     await_suspend returns the child's handle, so the jump is a tail call)
+//   - when it finishes, its final_suspend transfers straight back to the
+//     awaiter, no queue and no thread in between
+// A chain of awaits is a chain of plain jumps: nothing blocks, and since
+// every transfer is a tail call, the stack does not grow with the depth of
+// the chain. (Clang emits that tail call at every -O level; GCC only when
+// optimizing: in an -O0 GCC or sanitizer build every transfer nests, and a
+// long chain, or a long loop of awaits, can run out of stack.)
+//
+// Threads change only at explicit points:
+//   - co_await schedule_on(pool): continue on a pool worker
+//   - co_await sleep_for(pool, d): continue on a pool worker after |d|
+//   - co_await future (a Future<T> from ThreadPool::submit): continue on
+//     the thread that fulfils it
+// So a coroutine waiting for something holds no worker; Future::get()
+// would park one.
+//
+// From plain code: start(task) runs it until its first suspension and
+// returns a Future; sync_wait(task) blocks for the result (never call it
+// from a worker of a pool the task needs).
+//
+// Frames come from FrameAllocator (frame_allocator.cpp), so the frame of a
+// short-lived task is usually a free-list pop, not a malloc.
+
+namespace detail {
+
+struct TaskPromiseBase {
+  static void* operator new(size_t size) {
+    return FrameAllocator::allocate(size);
+  }
+  static void operator delete(void* p, size_t size) noexcept {
+    FrameAllocator::deallocate(p, size);
+  }
+
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    // back to whoever awaited us, or to nobody
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> self) noexcept {
+      if (std::coroutine_handle<> next = self.promise().continuation) {
+        return next;
+      }
+      return std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() noexcept { error = std::current_exception(); }
+
+  std::coroutine_handle<> continuation;
+  std::exception_ptr error;
+};
+
+}  // namespace detail
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+  Task<T> get_return_object() noexcept;
+
+  template <typename U>
+  void return_value(U&& v) {
+    value.emplace(std::forward<U>(v));
+  }
+
+  T take() {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return std::move(*value);
+  }
+
+  std::optional<T> value;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+  Task<void> get_return_object() noexcept;
+
+  void return_void() const noexcept {}
+
+  void take() const {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+};
+
+}  // namespace detail
+
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  using promise_type = detail::TaskPromise<T>;
+
+  Task() = default;
+
+  Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle) handle.destroy();
+      handle = std::exchange(other.handle, {});
+    }
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() {
+    if (handle) handle.destroy();
+  }
+
+  bool valid() const { return bool(handle); }
+
+  // Starts the task on the awaiting thread; resumes the awaiter when it is
+  // done, with its value or exception. Await each task once.
+  auto operator co_await() noexcept {
+    struct Awaiter {
+      std::coroutine_handle<promise_type> child;
+
+      bool await_ready() const noexcept { return false; }
+
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<> awaiter) noexcept {
+        child.promise().continuation = awaiter;
+        return child;
+      }
+
+      T await_resume() { return child.promise().take(); }
+    };
+    return Awaiter{handle};
+  }
+
+ private:
+  friend promise_type;
+
+  explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+  return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+  return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+// Starts eagerly and frees its own frame when it finishes.
+struct Detached {
+  struct promise_type {
+    static void* operator new(size_t size) {
+      return FrameAllocator::allocate(size);
+    }
+    static void operator delete(void* p, size_t size) noexcept {
+      FrameAllocator::deallocate(p, size);
+    }
+
+    Detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+template <typename T>
+Detached run_into(Task<T> task, Promise<T> promise) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await task;
+      promise.set_value();
+    } else {
+      promise.set_value(co_await task);
+    }
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+}
+
+}  // namespace detail
+
+// Runs |task| on the calling thread until it first suspends; the Future
+// receives its value or exception.
+template <typename T>
+Future<T> start(Task<T> task) {
+  Promise<T> promise;
+  Future<T> future = promise.get_future();
+  detail::run_into(std::move(task), std::move(promise));
+  return future;
+}
+
+// Blocks the calling thread until |task| finishes.
+template <typename T>
+T sync_wait(Task<T> task) {
+  return start(std::move(task)).get();
+}
+
+// co_await schedule_on(pool): the rest of the coroutine runs on a worker
+// of |pool| (always a hop through the queue, even from one of its workers,
+// so it also serves as a yield).
+inline auto schedule_on(ThreadPool& pool) {
+  struct Awaiter {
+    ThreadPool& pool;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+      pool.enqueue([h] { h.resume(); });
+    }
+    void await_resume() const noexcept {}
+  };
+  return Awaiter{pool};
+}
+
+// co_await on a Future: suspends without holding a thread and resumes on
+// the thread that fulfils it (inline if it is already ready).
+template <typename T>
+auto operator co_await(Future<T>&& future) {
+  struct Awaiter {
+    Future<T> future;
+
+    bool await_ready() const { return future.is_ready(); }
+    void await_suspend(std::coroutine_handle<> h) {
+      future.on_ready([h] { h.resume(); });
+    }
+    T await_resume() { return future.get(); }
+  };
+  return Awaiter{std::move(future)};
+}
+
+// ------------
+// Coroutine timers
+// ------------
+//
+// One thread sleeps until the earliest deadline in a min-heap, then hands
+// each expired coroutine to its pool. Sleeping coroutines hold no thread
+// at all. Timers still pending at destruction are dropped (and their
+// coroutines never resumed).
+
+class TimerService {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  TimerService() : thread([this] { loop(); }) {}
+
+  ~TimerService() {
+    {
+      std::lock_guard<std::mutex> locker(mtx);
+      stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  TimerService(const TimerService&) = delete;
+  TimerService& operator=(const TimerService&) = delete;
+
+  // Enqueues |h| on |pool| once |deadline| has passed.
+  void schedule(Clock::time_point deadline,
+                ThreadPool& pool,
+                std::coroutine_handle<> h) {
+    bool earliest;
+    {
+      std::lock_guard<std::mutex> locker(mtx);
+      timers.push({deadline, next_seq++, &pool, h});
+      earliest = timers.top().seq == next_seq - 1;
+    }
+    if (earliest) {
+      cv.notify_one();  // sleeping past it otherwise
+    }
+  }
+
+  static TimerService& instance() {
+    static TimerService service;
+    return service;
+  }
+
+ private:
+  struct Timer {
+    Clock::time_point deadline;
+    uint64_t seq;  // FIFO among equal deadlines
+    ThreadPool* pool;
+    std::coroutine_handle<> h;
+
+    bool operator>(const Timer& other) const {
+      return deadline != other.deadline ? deadline > other.deadline
+                                        : seq > other.seq;
+    }
+  };
+
+  void loop() {
+    std::unique_lock<std::mutex> locker(mtx);
+    while (!stopping) {
+      if (timers.empty()) {
+        cv.wait(locker);
+        continue;
+      }
+      Timer first = timers.top();
+      if (Clock::now() < first.deadline) {
+        cv.wait_until(locker, first.deadline);
+        continue;
+      }
+      timers.pop();
+      locker.unlock();
+      first.pool->enqueue([h = first.h] { h.resume(); });
+      locker.lock();
+    }
+  }
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers;
+  uint64_t next_seq = 0;
+  bool stopping = false;
+
+  std::thread thread;  // last: starts after the members it uses
+};
+
+// co_await sleep_until / sleep_for: resumes on a worker of |pool| once the
+// time has come (right away, without a hop, if it already has).
+inline auto sleep_until(ThreadPool& pool, TimerService::Clock::time_point t) {
+  struct Awaiter {
+    ThreadPool& pool;
+    TimerService::Clock::time_point deadline;
+
+    bool await_ready() const {
+      return TimerService::Clock::now() >= deadline;
+    }
+    void await_suspend(std::coroutine_handle<> h) {
+      TimerService::instance().schedule(deadline, pool, h);
+    }
+    void await_resume() const noexcept {}
+  };
+  return Awaiter{pool, t};
+}
+
+template <typename Rep, typename Period>
+auto sleep_for(ThreadPool& pool, std::chrono::duration<Rep, Period> d) {
+  return sleep_until(
+      pool, TimerService::Clock::now() +
+                std::chrono::duration_cast<TimerService::Clock::duration>(d));
+}
+
+}  // namespace MT
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.cpp"
+
+namespace MT {
+
+// ------------
+// Task graph
+// ------------
+//
+// A job whose steps depend on each other, declared once and run on a
+// ThreadPool:
+//   auto load = graph.emplace([] { ... });
+//   auto parse = graph.emplace([] { ... });
+//   graph.precede(load, parse);  // load before parse
+//   graph.run(pool);
+//
+// Scheduling is driven by the dependencies themselves:
+//   - every node has an atomic count of unfinished predecessors
+//   - a finishing node decrements its successors' counts; the ones that
+//     reach zero are ready: the finishing worker keeps one to run next
+//     itself (no queue round trip) and enqueues the rest
+// So a node starts the moment its inputs are done, with no level-by-level
+// barrier and no worker parked waiting on a predecessor.
+//
+// Re-runnable: run() resets counters and allocates one small completion
+// record; the graph is not rebuilt. The record is shared by every task of
+// the run, so the worker finishing the last node can still notify it after
+// run() has returned and the graph is gone.
+//
+// Node kinds:
+//   - emplace(fn): plain work
+//   - emplace_condition(fn): fn() returns the index of the one successor to
+//     run next (in precede() order); the others are skipped. Its edges are
+//     "weak": they do not count as dependencies, so a condition can point
+//     back to an earlier node and form a loop
+//   - emplace_subflow(fn): fn(sub) builds a graph at run time, which runs
+//     to completion before the node counts as finished
+// A node's counter is re-armed when it starts, so nodes inside a loop are
+// ready to count down again.
+//
+// Nodes without any predecessor start the run. Exceptions: the first one is
+// rethrown by run(); the work of nodes not yet started is skipped.
+
+class TaskGraph {
+ public:
+  using NodeId = uint32_t;
+
+  TaskGraph() = default;
+  TaskGraph(const TaskGraph&) = delete;
+  TaskGraph& operator=(const TaskGraph&) = delete;
+
+  NodeId emplace(UniqueFunction work) {
+    Node& node = add(Node::kWork);
+    node.work = std::move(work);
+    return NodeId(nodes.size() - 1);
+  }
+
+  NodeId emplace_condition(std::function<size_t()> condition) {
+    Node& node = add(Node::kCondition);
+    node.condition = std::move(condition);
+    return NodeId(nodes.size() - 1);
+  }
+
+  NodeId emplace_subflow(std::function<void(TaskGraph&)> build) {
+    Node& node = add(Node::kSubflow);
+    node.build = std::move(build);
+    return NodeId(nodes.size() - 1);
+  }
+
+  // |before| runs before |after|.
+  void precede(NodeId before, NodeId after) {
+    Node& from = nodes[before];
+    from.successors.push_back(after);
+    ++nodes[after].predecessors;
+    if (from.kind != Node::kCondition) {
+      ++nodes[after].strong_predecessors;
+    }
+  }
+
+  size_t size() const { return nodes.size(); }
+
+  void clear() { nodes.clear(); }
+
+  // Runs the graph and returns when every node that was reached has
+  // finished. The calling thread runs queued pool tasks while it waits, so
+  // run() may be called from a worker (a subflow does).
+  void run(ThreadPool& pool) {
+    executor = &pool;
+    failed.store(false, std::memory_order_relaxed);
+    error = nullptr;
+
+    size_t roots = 0;
+    for (Node& node : nodes) {
+      node.pending.store(node.strong_predecessors, std::memory_order_relaxed);
+      roots += node.predecessors == 0;
+    }
+    if (roots == 0) {
+      return;
+    }
+
+    auto run = std::make_shared<Run>();
+    run->in_flight.store(roots, std::memory_order_relaxed);
+    NodeId own = 0;
+    bool have_own = false;
+    for (NodeId id = 0; id < nodes.size(); ++id) {
+      if (nodes[id].predecessors != 0) continue;
+      if (!have_own) {
+        own = id;  // the caller starts on one root itself
+        have_own = true;
+      } else {
+        enqueue(id, run);
+      }
+    }
+    execute(own, run);
+
+    while (true) {
+      size_t n = run->in_flight.load(std::memory_order_acquire);
+      if (n == 0) {
+        break;
+      }
+      if (!pool.try_run_one()) {
+        run->in_flight.wait(n, std::memory_order_acquire);
+      }
+    }
+
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+ private:
+  static constexpr NodeId kNone = ~NodeId{0};
+
+  struct Node {
+    enum Kind : uint8_t { kWork, kCondition, kSubflow };
+
+    explicit Node(Kind kind) : kind(kind) {}
+
+    Kind kind;
+    UniqueFunction work;
+    std::function<size_t()> condition;
+    std::function<void(TaskGraph&)> build;
+    std::unique_ptr<TaskGraph> subflow;  // kept between runs
+
+    std::vector<NodeId> successors;
+    uint32_t predecessors = 0;
+    uint32_t strong_predecessors = 0;  // not from a condition
+    std::atomic<uint32_t> pending{0};
+  };
+
+  // Lives as long as the last task of a run holds it, not as the graph.
+  struct Run {
+    std::atomic<size_t> in_flight{0};  // scheduled and not yet finished
+  };
+
+  Node& add(Node::Kind kind) { return nodes.emplace_back(kind); }
+
+  void enqueue(NodeId id, const std::shared_ptr<Run>& run) {
+    executor->enqueue([this, id, run] { execute(id, run); });
+  }
+
+  // Runs |id|, then the successor it kept for itself, and so on. Once the
+  // last node is counted out, run() may return and the graph be destroyed:
+  // after that decrement only |run| is touched.
+  void execute(NodeId id, const std::shared_ptr<Run>& run) {
+    while (id != kNone) {
+      Node& node = nodes[id];
+      node.pending.store(node.strong_predecessors, std::memory_order_relaxed);
+
+      size_t chosen = node.successors.size();
+      if (!failed.load(std::memory_order_relaxed)) {
+        try {
+          switch (node.kind) {
+            case Node::kWork:
+              node.work();
+              break;
+            case Node::kCondition:
+              chosen = node.condition();
+              break;
+            case Node::kSubflow:
+              if (!node.subflow) node.subflow = std::make_unique<TaskGraph>();
+              node.subflow->clear();
+              node.build(*node.subflow);
+              node.subflow->run(*executor);
+              break;
+          }
+        } catch (...) {
+          if (!failed.exchange(true, std::memory_order_acq_rel)) {
+            error = std::current_exception();
+          }
+        }
+      }
+
+      NodeId next = kNone;
+      auto ready = [&](NodeId s) {
+        run->in_flight.fetch_add(1, std::memory_order_relaxed);
+        if (next == kNone) {
+          next = s;
+        } else {
+          enqueue(s, run);
+        }
+      };
+      if (node.kind == Node::kCondition) {
+        if (chosen < node.successors.size()) {
+          ready(node.successors[chosen]);
+        }
+      } else {
+        for (NodeId s : node.successors) {
+          if (nodes[s].pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready(s);
+          }
+        }
+      }
+
+      // after the successors are counted in, so in_flight never dips to 0
+      if (run->in_flight.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        run->in_flight.notify_all();
+      }
+      id = next;
+    }
+  }
+
+  std::deque<Node> nodes;  // stable addresses: atomics do not move
+
+  ThreadPool* executor = nullptr;
+  std::atomic<bool> failed{false};
+  std::exception_ptr error;
+};
+
+}  // namespace MT
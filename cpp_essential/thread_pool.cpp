@@ -0,0 +1,1134 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "benchmark.cpp"
+#include "spin_wait.cpp"
+
+namespace MT {
+
+// ------------
+// UniqueFunction
+// ------------
+//
+// Move-only replacement for std::function<void()>:
+//   - accepts move-only callables (lambdas capturing a promise, unique_ptr)
+//   - small callables live in an inline buffer, so enqueueing a typical
+//     lambda does not touch the heap
+
+class UniqueFunction {
+ public:
+  UniqueFunction() = default;
+
+  template <typename F>
+    requires(!std::same_as<std::decay_t<F>, UniqueFunction> &&
+             std::invocable<std::decay_t<F>&>)
+  UniqueFunction(F&& fn) {
+    using Fn = std::decay_t<F>;
+
+    if constexpr (sizeof(Fn) <= kInlineSize &&
+                  alignof(Fn) <= alignof(std::max_align_t) &&
+                  std::is_nothrow_move_constructible_v<Fn>) {
+      new (storage) Fn(std::forward<F>(fn));
+      ops = &kInlineOps<Fn>;
+    } else {
+      // NOTE: big callables fall back to one heap allocation; only the
+      // pointer is stored inline.
+      *reinterpret_cast<Fn**>(storage) = new Fn(std::forward<F>(fn));
+      ops = &kHeapOps<Fn>;
+    }
+  }
+
+  UniqueFunction(UniqueFunction&& other) noexcept : ops(other.ops) {
+    if (ops) {
+      ops->move(other.storage, storage);
+      other.ops = nullptr;
+    }
+  }
+
+  UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+    if (this != &other) {
+      reset();
+      ops = other.ops;
+      if (ops) {
+        ops->move(other.storage, storage);
+        other.ops = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  UniqueFunction(const UniqueFunction&) = delete;
+  UniqueFunction& operator=(const UniqueFunction&) = delete;
+
+  ~UniqueFunction() { reset(); }
+
+  void operator()() { ops->invoke(storage); }
+
+  explicit operator bool() const { return ops != nullptr; }
+
+ private:
+  // One vtable per stored type: call, relocate into |dst| (and destroy |src|),
+  // destroy.
+  struct Ops {
+    void (*invoke)(void*);
+    void (*move)(void* src, void* dst);
+    void (*destroy)(void*);
+  };
+
+  template <typename Fn>
+  static constexpr Ops kInlineOps{
+      [](void* p) { (*static_cast<Fn*>(p))(); },
+      [](void* src, void* dst) {
+        new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+        static_cast<Fn*>(src)->~Fn();
+      },
+      [](void* p) { static_cast<Fn*>(p)->~Fn(); }};
+
+  template <typename Fn>
+  static constexpr Ops kHeapOps{
+      [](void* p) { (**static_cast<Fn**>(p))(); },
+      [](void* src, void* dst) {
+        *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+      },
+      [](void* p) { delete *static_cast<Fn**>(p); }};
+
+  void reset() {
+    if (ops) {
+      ops->destroy(storage);
+      ops = nullptr;
+    }
+  }
+
+  // 56 + 8 (ops) = one cache line per queued task on 64-bit targets
+  static constexpr size_t kInlineSize = 56;
+
+  alignas(std::max_align_t) unsigned char storage[kInlineSize];
+  const Ops* ops = nullptr;
+};
+
+class ThreadPool;
+
+template <typename T>
+class Future;
+
+template <typename T>
+class Promise;
+
+namespace detail {
+
+// Stand-in for `void` so Future<void> can reuse the same shared state
+struct Unit {};
+
+template <typename T>
+using StoredType = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+// ------------
+// Shared state between one Promise and one Future
+// ------------
+//
+// One heap allocation per Future: the result is stored inline in a variant,
+// the readiness flag doubles as the futex word for blocking get(), and the
+// (single) continuation sits in a UniqueFunction buffer.
+//
+// |status| transitions:
+//   kPending -> kReady                       (no continuation attached)
+//   kPending -> kHasContinuation -> kReady   (continuation runs on set)
+template <typename T>
+class SharedState {
+ public:
+  using Value = StoredType<T>;
+
+  void add_ref() { refs.fetch_add(1, std::memory_order_relaxed); }
+
+  void release() {
+    if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  template <typename... Args>
+  void set_value(Args&&... args) {
+    result.template emplace<1>(std::forward<Args>(args)...);
+    publish();
+  }
+
+  void set_exception(std::exception_ptr e) {
+    result.template emplace<2>(std::move(e));
+    publish();
+  }
+
+  bool is_ready() const {
+    return status.load(std::memory_order_acquire) == kReady;
+  }
+
+  void wait() const {
+    uint32_t s = status.load(std::memory_order_acquire);
+    while (s != kReady) {
+      status.wait(s, std::memory_order_acquire);
+      s = status.load(std::memory_order_acquire);
+    }
+  }
+
+  // Moves the result out; rethrows a stored exception.
+  Value take() {
+    wait();
+    if (result.index() == 2) {
+      std::rethrow_exception(std::get<2>(result));
+    }
+    return std::move(std::get<1>(result));
+  }
+
+  // Runs |fn| on the thread that fulfils the promise, or right away if the
+  // result is already there. At most one continuation per state.
+  void on_ready(UniqueFunction fn) {
+    continuation = std::move(fn);
+
+    uint32_t expected = kPending;
+    if (!status.compare_exchange_strong(expected,
+                                        kHasContinuation,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+      // already ready: nobody else will touch |continuation|
+      run_continuation();
+    }
+  }
+
+  // Pool used by Future::then(); nullptr means "run inline".
+  ThreadPool* executor = nullptr;
+
+ private:
+  static constexpr uint32_t kPending = 0;
+  static constexpr uint32_t kHasContinuation = 1;
+  static constexpr uint32_t kReady = 2;
+
+  void publish() {
+    uint32_t prev = status.exchange(kReady, std::memory_order_acq_rel);
+    status.notify_all();
+    if (prev == kHasContinuation) {
+      run_continuation();
+    }
+  }
+
+  void run_continuation() {
+    UniqueFunction fn = std::move(continuation);
+    fn();
+  }
+
+  std::variant<std::monostate, Value, std::exception_ptr> result;
+  UniqueFunction continuation;
+  std::atomic<uint32_t> status{kPending};
+  std::atomic<uint32_t> refs{1};
+};
+
+// Runs |fn| and stores its return value (or exception) into |promise|.
+template <typename T, typename Fn>
+void fulfil(Promise<T>& promise, Fn&& fn) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      std::forward<Fn>(fn)();
+      promise.set_value();
+    } else {
+      promise.set_value(std::forward<Fn>(fn)());
+    }
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+}
+
+// Return type of a continuation: F(T) or F() for Future<void>
+template <typename F, typename T>
+struct ContinuationResult {
+  using type = std::invoke_result_t<F, T>;
+};
+
+template <typename F>
+struct ContinuationResult<F, void> {
+  using type = std::invoke_result_t<F>;
+};
+
+}  // namespace detail
+
+// ------------
+// Promise<T>
+// ------------
+//
+// Write end of a Future. Destroying an unsatisfied promise stores
+// std::future_errc::broken_promise, same as std::promise.
+
+template <typename T>
+class Promise {
+ public:
+  Promise() : state(new detail::SharedState<T>()) {}
+
+  Promise(Promise&& other) noexcept
+      : state(std::exchange(other.state, nullptr)),
+        retrieved(other.retrieved) {}
+
+  Promise& operator=(Promise&& other) noexcept {
+    if (this != &other) {
+      abandon();
+      state = std::exchange(other.state, nullptr);
+      retrieved = other.retrieved;
+    }
+    return *this;
+  }
+
+  Promise(const Promise&) = delete;
+  Promise& operator=(const Promise&) = delete;
+
+  ~Promise() { abandon(); }
+
+  Future<T> get_future() {
+    if (retrieved) {
+      throw std::future_error(std::future_errc::future_already_retrieved);
+    }
+    retrieved = true;
+    state->add_ref();
+    return Future<T>(state);
+  }
+
+  template <typename... Args>
+  void set_value(Args&&... args) {
+    detail::SharedState<T>* s = take_state();
+    s->set_value(std::forward<Args>(args)...);
+    s->release();
+  }
+
+  void set_exception(std::exception_ptr e) {
+    detail::SharedState<T>* s = take_state();
+    s->set_exception(std::move(e));
+    s->release();
+  }
+
+ private:
+  detail::SharedState<T>* take_state() {
+    if (!state) {
+      throw std::future_error(std::future_errc::promise_already_satisfied);
+    }
+    return std::exchange(state, nullptr);
+  }
+
+  void abandon() {
+    if (state) {
+      state->set_exception(std::make_exception_ptr(
+          std::future_error(std::future_errc::broken_promise)));
+      state->release();
+      state = nullptr;
+    }
+  }
+
+  detail::SharedState<T>* state;
+  bool retrieved = false;
+};
+
+// ------------
+// Future<T>
+// ------------
+//
+// Move-only read end. get() blocks with std::atomic::wait (no mutex/cv),
+// then() chains work on the pool that produced the value.
+
+template <typename T>
+class Future {
+ public:
+  Future() = default;
+
+  Future(Future&& other) noexcept
+      : state(std::exchange(other.state, nullptr)) {}
+
+  Future& operator=(Future&& other) noexcept {
+    if (this != &other) {
+      if (state) state->release();
+      state = std::exchange(other.state, nullptr);
+    }
+    return *this;
+  }
+
+  Future(const Future&) = delete;
+  Future& operator=(const Future&) = delete;
+
+  ~Future() {
+    if (state) state->release();
+  }
+
+  bool valid() const { return state != nullptr; }
+
+  bool is_ready() const { return state->is_ready(); }
+
+  void wait() const { state->wait(); }
+
+  // Blocks until ready and consumes the future.
+  T get() {
+    detail::SharedState<T>* s = std::exchange(state, nullptr);
+
+    struct Release {
+      detail::SharedState<T>* s;
+      ~Release() { s->release(); }
+    } guard{s};
+
+    if constexpr (std::is_void_v<T>) {
+      s->take();
+    } else {
+      return s->take();
+    }
+  }
+
+  // Schedules |fn(value)| on this future's pool once the value is ready and
+  // returns a future for its result. Exceptions skip |fn| and propagate.
+  // Consumes this future.
+  template <typename F>
+  auto then(F&& fn) -> Future<typename detail::ContinuationResult<F, T>::type>;
+
+  // Low-level hook for combinators: runs |fn| inline on the completing thread.
+  void on_ready(UniqueFunction fn) { state->on_ready(std::move(fn)); }
+
+ private:
+  template <typename>
+  friend class Future;
+  template <typename>
+  friend class Promise;
+  friend class ThreadPool;
+
+  explicit Future(detail::SharedState<T>* s) : state(s) {}
+
+  detail::SharedState<T>* state = nullptr;
+};
+
+// ------------
+// Thread Pool
+// ------------
+//
+// Tasks wait in one of three lanes:
+//   - kCritical: latency-sensitive (a request, a heartbeat)
+//   - kNormal: the default, for enqueue(task) and submit(...)
+//   - kBulk: throughput work that can wait (batch jobs, rebuilds)
+// With one lane in use the pool is a plain FIFO. With several, a free
+// worker picks the lane according to ThreadPoolOptions:
+//   - weighted (default): lanes take turns, weights[i] tasks from lane i
+//     per round, the most urgent first; every lane keeps its share
+//   - strict: always the most urgent non-empty lane, so a burst of bulk
+//     work delays a critical task by at most the tasks already running
+//   - reserved_workers: that many workers only ever run critical tasks, so
+//     one is free for them even while long bulk tasks occupy the rest
+//   - max_wait (aging): a task that has waited longer than this is taken
+//     next whatever its lane, so strict priority cannot starve bulk work
+//     forever (costs a clock read per enqueue)
+// Inside a lane the order stays FIFO.
+//
+// How an idle worker waits for the next task (IdleStrategy) trades CPU for
+// wake-up latency:
+//   - kBlock (default): condition variable. No CPU while idle; a wake-up
+//     is a futex syscall plus the scheduler, several microseconds
+//   - kSpinThenWait: spins for |idle_spin|, then sleeps in
+//     std::atomic::wait; enqueue only pays for the futex wake when a
+//     worker actually sleeps
+//   - kSpinThenYield: spins, then yields in a loop; never sleeps, so it
+//     burns a core while idle but steps aside for other runnable threads
+//   - kBusyPoll: spins forever: the lowest latency, one full core per
+//     worker, always. Only with a core per worker (pinned, isolated);
+//     when threads outnumber cores it is the slowest of all
+// The spin phases are skipped on a single-core machine, where spinning
+// only delays the thread that would enqueue the work.
+//
+// Placement (Linux only, ignored elsewhere):
+//   - affinity: worker i only runs on the CPUs of affinity[i % size()], so
+//     the scheduler cannot migrate it away from the caches it warmed. One
+//     CPU per worker is the usual setup; workers sharing a CPU take turns
+//   - name: workers are named "<name>-<i>" (cut to the 15 characters Linux
+//     allows), which is what top -H, perf and gdb show
+//
+// stats() reports per worker: tasks run always; with |stats| set also
+// busy / idle / queue-wait time and CPU migrations, for two clock reads
+// per task plus one per enqueue. Each worker writes only its own cache
+// line of counters, so counting adds no sharing between workers.
+
+enum class Lane : uint8_t { kCritical, kNormal, kBulk };
+
+enum class IdleStrategy : uint8_t {
+  kBlock,
+  kSpinThenWait,
+  kSpinThenYield,
+  kBusyPoll,
+};
+
+struct ThreadPoolOptions {
+  bool strict = false;
+  std::array<unsigned, 3> weights = {4, 2, 1};  // weighted only, by Lane
+  int reserved_workers = 0;  // out of the n workers; at least one is left
+  std::chrono::microseconds max_wait{0};  // 0: no aging
+  IdleStrategy idle = IdleStrategy::kBlock;
+  std::chrono::microseconds idle_spin{50};  // kSpinThen* only
+  std::vector<std::vector<int>> affinity;  // CPU sets; empty: not pinned
+  std::string name;  // thread name prefix; empty: unnamed
+  bool stats = false;  // time tasks (see ThreadPool::stats())
+};
+
+struct WorkerStats {
+  int index = 0;
+  bool reserved = false;  // runs critical tasks only
+  bool pinned = false;    // affinity applied
+  int cpu = -1;           // where the last task ran; |stats| on Linux only
+  uint64_t tasks = 0;
+  // |stats| only:
+  uint64_t migrations = 0;  // changes of CPU between two tasks
+  std::chrono::nanoseconds busy{0};  // running tasks
+  std::chrono::nanoseconds idle{0};  // waiting for a task
+  std::chrono::nanoseconds queue_wait{0};  // its tasks' enqueue to start
+};
+
+struct ThreadPoolStats {
+  std::vector<WorkerStats> workers;
+  uint64_t helped = 0;  // tasks run by try_run_one() callers
+};
+
+class ThreadPool {
+ public:
+  ThreadPool(int n, ThreadPoolOptions opts = {})
+      : options(std::move(opts)),
+        credits(options.weights),
+        counters(std::make_unique<WorkerCounters[]>(std::max(n, 0))) {
+    const int reserved = std::clamp(options.reserved_workers, 0,
+                                    std::max(n - 1, 0));
+    for (int i = 0; i < n; ++i) {
+      const bool critical_only = i >= n - reserved;  // the last |reserved|
+      counters[i].reserved = critical_only;
+      workers.emplace_back([this, i, critical_only]() {
+        current_pool = this;
+        current_index = i;
+        setup_thread(i);
+        if (options.idle == IdleStrategy::kBlock) {
+          work(critical_only, counters[i]);
+        } else {
+          poll(critical_only, counters[i]);
+        }
+      });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      stop = true;
+    }
+    cv.notify_all();
+    critical_cv.notify_all();
+    for (Signal* s : {&work_signal, &critical_signal}) {
+      s->epoch.fetch_add(1, std::memory_order_seq_cst);
+      s->epoch.notify_all();
+    }
+
+    for (int i = 0; i < workers.size(); ++i) {
+      workers[i].join();
+    }
+  }
+
+  // Fire-and-forget. The task is moved (not copied) into the queue.
+  //
+  // NOTE: notifies under the lock. A thread outside the pool (a timer) may
+  // enqueue the last task the owner is waiting for; once that task runs the
+  // owner can destroy the pool, which it cannot do while we hold |mtx|.
+  void enqueue(UniqueFunction task, Lane lane = Lane::kNormal) {
+    const int64_t now =
+        options.max_wait.count() > 0 || options.stats ? now_ns() : 0;
+    std::lock_guard<std::mutex> lock(mtx);
+    lanes[size_t(lane)].push({std::move(task), now});
+    ++queued;
+    if (options.idle != IdleStrategy::kBlock) {
+      signal(work_signal);
+      if (lane == Lane::kCritical) {
+        signal(critical_signal);
+      }
+    } else if (lane == Lane::kCritical && idle_reserved > 0) {
+      critical_cv.notify_one();
+    } else {
+      cv.notify_one();
+    }
+  }
+
+  // Runs |fn(args...)| on a worker and returns a Future for the result.
+  // |fn| and |args| may be move-only; they are stored by value in the task.
+  template <typename F, typename... Args>
+  auto submit(F&& fn, Args&&... args) {
+    return submit_to(Lane::kNormal, std::forward<F>(fn),
+                     std::forward<Args>(args)...);
+  }
+
+  template <typename F, typename... Args>
+  auto submit_to(Lane lane, F&& fn, Args&&... args)
+      -> Future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+    using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+
+    Promise<R> promise;
+    Future<R> future = promise.get_future();
+    future.state->executor = this;
+
+    enqueue(
+        [promise = std::move(promise),
+         fn = std::forward<F>(fn),
+         ... args = std::forward<Args>(args)]() mutable {
+          detail::fulfil(promise, [&]() -> R {
+            return std::invoke(std::move(fn), std::move(args)...);
+          });
+        },
+        lane);
+
+    return future;
+  }
+
+  // Pops and runs one queued task on the calling thread. Lets a thread that
+  // waits for pool work help instead of blocking (no deadlock when called
+  // from a worker).
+  bool try_run_one() {
+    Queued item;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (queued == 0) {
+        return false;
+      }
+      item = pop(pick_lane());
+    }
+    helped.fetch_add(1, std::memory_order_relaxed);
+    item.fn();
+    return true;
+  }
+
+  size_t size() const { return workers.size(); }
+
+  // Number of workers (not counting reserved ones) currently parked on the
+  // condition variable. Relaxed snapshot, only meant as a scheduling hint.
+  int idle_workers() const { return idle.load(std::memory_order_relaxed); }
+
+  // Index of the calling worker in [0, size()), or -1 if the caller is not
+  // one of this pool's workers.
+  int worker_index() const {
+    return current_pool == this ? current_index : -1;
+  }
+
+  // Relaxed snapshot of the counters, cheap enough to poll from a
+  // monitoring thread. Counters of different workers are read at slightly
+  // different moments; the task or wait in progress is not counted yet.
+  ThreadPoolStats stats() const {
+    ThreadPoolStats s;
+    s.helped = helped.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < workers.size(); ++i) {
+      const WorkerCounters& c = counters[i];
+      auto ns = [](const std::atomic<uint64_t>& v) {
+        return std::chrono::nanoseconds(v.load(std::memory_order_relaxed));
+      };
+      WorkerStats& w = s.workers.emplace_back();
+      w.index = int(i);
+      w.reserved = c.reserved;
+      w.pinned = c.pinned.load(std::memory_order_relaxed);
+      w.cpu = c.cpu.load(std::memory_order_relaxed);
+      w.tasks = c.tasks.load(std::memory_order_relaxed);
+      w.migrations = c.migrations.load(std::memory_order_relaxed);
+      w.busy = ns(c.busy_ns);
+      w.idle = ns(c.idle_ns);
+      w.queue_wait = ns(c.queue_wait_ns);
+    }
+    return s;
+  }
+
+ private:
+  static constexpr size_t kLanes = 3;
+
+  struct Queued {
+    UniqueFunction fn;
+    int64_t enqueued_ns = 0;  // aging or stats only
+  };
+
+  // One per worker and written by that worker only, so a plain load + store
+  // does (no locked read-modify-write); stats() reads them from any thread.
+  struct alignas(64) WorkerCounters {
+    std::atomic<uint64_t> tasks{0};
+    std::atomic<uint64_t> busy_ns{0};
+    std::atomic<uint64_t> idle_ns{0};
+    std::atomic<uint64_t> queue_wait_ns{0};
+    std::atomic<uint64_t> migrations{0};
+    std::atomic<int> cpu{-1};
+    std::atomic<bool> pinned{false};
+    bool reserved = false;  // set before the worker starts
+  };
+
+  static void add(std::atomic<uint64_t>& counter, int64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + uint64_t(value),
+                  std::memory_order_relaxed);
+  }
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // Pins and names the calling worker |i| as |options| asks.
+  void setup_thread(int i) {
+#if defined(__linux__)
+    if (!options.affinity.empty()) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (int cpu : options.affinity[size_t(i) % options.affinity.size()]) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+      }
+      // fails, leaving the worker unpinned, if none of the CPUs is usable
+      const bool pinned =
+          pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+      counters[i].pinned.store(pinned, std::memory_order_relaxed);
+    }
+    if (!options.name.empty()) {
+      const std::string name =
+          (options.name + "-" + std::to_string(i)).substr(0, 15);
+      pthread_setname_np(pthread_self(), name.c_str());
+    }
+#else
+    (void)i;
+#endif
+  }
+
+  // Runs |item| on the calling worker, which started looking for work at
+  // |idle_since|. Returns when the next idle period starts (|stats| only).
+  int64_t run(WorkerCounters& c, Queued& item, int64_t idle_since) {
+    if (!options.stats) {
+      item.fn();
+      add(c.tasks, 1);
+      return 0;
+    }
+    const int64_t start = now_ns();
+    add(c.idle_ns, start - idle_since);
+    add(c.queue_wait_ns, start - item.enqueued_ns);
+    item.fn();
+    const int64_t end = now_ns();
+    add(c.busy_ns, end - start);
+    add(c.tasks, 1);
+#if defined(__linux__)
+    const int cpu = sched_getcpu();
+    const int last = c.cpu.load(std::memory_order_relaxed);
+    if (cpu != last) {
+      if (last != -1) add(c.migrations, 1);
+      c.cpu.store(cpu, std::memory_order_relaxed);
+    }
+#endif
+    return end;
+  }
+
+  void work(bool critical_only, WorkerCounters& counter) {
+    auto& critical = lanes[size_t(Lane::kCritical)];
+    int64_t idle_since = options.stats ? now_ns() : 0;
+    while (true) {
+      Queued item;
+
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (critical_only) {
+          ++idle_reserved;
+          critical_cv.wait(lock, [&] { return stop || !critical.empty(); });
+          --idle_reserved;
+          if (critical.empty()) {
+            return;  // stopping
+          }
+          item = pop(size_t(Lane::kCritical));
+        } else {
+          idle.fetch_add(1, std::memory_order_relaxed);
+          cv.wait(lock, [this] { return stop || queued != 0; });
+          idle.fetch_sub(1, std::memory_order_relaxed);
+
+          if (stop && queued == 0) {
+            return;
+          }
+
+          item = pop(pick_lane());
+        }
+      }
+
+      idle_since = run(counter, item, idle_since);
+    }
+  }
+
+  // Non-blocking idle strategies: workers watch an epoch that every
+  // enqueue bumps (reserved workers one bumped for critical tasks only).
+  //
+  // Sleeper:  seen = epoch; check queue; sleepers++; if (epoch == seen) wait
+  // Enqueuer: push; epoch++; if (sleepers) notify
+  // All seq_cst: either the sleeper sees the new epoch or the enqueuer sees
+  // the sleeper, so no wake-up is lost and nobody sleeping costs nothing.
+  struct alignas(64) Signal {
+    std::atomic<uint32_t> epoch{0};
+    std::atomic<int> sleepers{0};
+  };
+
+  void signal(Signal& s) {
+    s.epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (s.sleepers.load(std::memory_order_seq_cst) > 0) {
+      s.epoch.notify_one();
+    }
+  }
+
+  void poll(bool critical_only, WorkerCounters& counter) {
+    Signal& s = critical_only ? critical_signal : work_signal;
+    int64_t idle_since = options.stats ? now_ns() : 0;
+    while (true) {
+      const uint32_t seen = s.epoch.load(std::memory_order_seq_cst);
+      Queued item;
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (critical_only && !lanes[size_t(Lane::kCritical)].empty()) {
+          item = pop(size_t(Lane::kCritical));
+        } else if (!critical_only && queued != 0) {
+          item = pop(pick_lane());
+        } else if (stop) {
+          return;
+        }
+      }
+
+      if (item.fn) {
+        idle_since = run(counter, item, idle_since);
+        continue;
+      }
+      if (!critical_only) idle.fetch_add(1, std::memory_order_relaxed);
+      idle_wait(s, seen);
+      if (!critical_only) idle.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Returns once |s.epoch| has moved past |seen|.
+  void idle_wait(Signal& s, uint32_t seen) {
+    using Clock = std::chrono::steady_clock;
+    static const bool multi_core = std::thread::hardware_concurrency() > 1;
+
+    bool spinning = options.idle == IdleStrategy::kBusyPoll || multi_core;
+    const Clock::time_point spin_end = Clock::now() + options.idle_spin;
+    for (uint32_t i = 1; s.epoch.load(std::memory_order_acquire) == seen;
+         ++i) {
+      if (spinning) {
+        cpu_relax();
+        if (options.idle != IdleStrategy::kBusyPoll && i % 64 == 0 &&
+            Clock::now() >= spin_end) {
+          spinning = false;
+        }
+      } else if (options.idle == IdleStrategy::kSpinThenYield) {
+        std::this_thread::yield();
+      } else {
+        s.sleepers.fetch_add(1, std::memory_order_seq_cst);
+        s.epoch.wait(seen, std::memory_order_seq_cst);
+        s.sleepers.fetch_sub(1, std::memory_order_seq_cst);
+      }
+    }
+  }
+
+  Queued pop(size_t lane) {
+    Queued item = std::move(lanes[lane].front());
+    lanes[lane].pop();
+    --queued;
+    return item;
+  }
+
+  // Under |mtx|, with |queued| > 0.
+  size_t pick_lane() {
+    if (options.max_wait.count() > 0) {
+      const int64_t deadline =
+          now_ns() -
+          std::chrono::duration_cast<std::chrono::nanoseconds>(options.max_wait)
+              .count();
+      size_t oldest = kLanes;
+      for (size_t l = 0; l < kLanes; ++l) {
+        if (!lanes[l].empty() && lanes[l].front().enqueued_ns < deadline &&
+            (oldest == kLanes || lanes[l].front().enqueued_ns <
+                                     lanes[oldest].front().enqueued_ns)) {
+          oldest = l;
+        }
+      }
+      if (oldest != kLanes) {
+        return oldest;
+      }
+    }
+
+    if (!options.strict) {
+      // a round ends when no non-empty lane has credit left
+      for (int round = 0; round < 2; ++round) {
+        for (size_t l = 0; l < kLanes; ++l) {
+          if (!lanes[l].empty() && credits[l] > 0) {
+            --credits[l];
+            return l;
+          }
+        }
+        credits = options.weights;
+      }
+    }
+
+    size_t l = 0;
+    while (lanes[l].empty()) ++l;
+    return l;
+  }
+
+  const ThreadPoolOptions options;
+  std::vector<std::thread> workers;
+  std::array<std::queue<Queued>, kLanes> lanes;
+  size_t queued = 0;  // over all lanes
+  std::array<unsigned, kLanes> credits;  // weighted: left in this round
+  std::unique_ptr<WorkerCounters[]> counters;  // one per worker
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::condition_variable critical_cv;  // reserved workers
+  int idle_reserved = 0;
+  bool stop = false;
+
+  std::atomic<int> idle{0};
+
+  Signal work_signal;
+  Signal critical_signal;  // reserved workers
+  std::atomic<uint64_t> helped{0};  // try_run_one() calls that ran a task
+
+  static inline thread_local ThreadPool* current_pool = nullptr;
+  static inline thread_local int current_index = -1;
+};
+
+template <typename T>
+template <typename F>
+auto Future<T>::then(F&& fn)
+    -> Future<typename detail::ContinuationResult<F, T>::type> {
+  using U = typename detail::ContinuationResult<F, T>::type;
+
+  Promise<U> promise;
+  Future<U> next = promise.get_future();
+
+  detail::SharedState<T>* prev = std::exchange(state, nullptr);
+  ThreadPool* pool = prev->executor;
+  next.state->executor = pool;
+
+  auto run = [prev, fn = std::forward<F>(fn), promise = std::move(promise)](
+                 ) mutable {
+    detail::fulfil(promise, [&]() -> U {
+      if constexpr (std::is_void_v<T>) {
+        prev->take();
+        return fn();
+      } else {
+        return fn(prev->take());
+      }
+    });
+    prev->release();
+  };
+
+  prev->on_ready([pool, run = std::move(run)]() mutable {
+    if (pool) {
+      pool->enqueue(std::move(run));
+    } else {
+      run();
+    }
+  });
+
+  return next;
+}
+
+// ------------
+// when_all / when_any
+// ------------
+//
+// Both take ownership of the input futures and keep them in one shared
+// control block; per-input callbacks only touch an atomic counter/flag, the
+// last (or first) one to arrive fulfils the combined promise inline.
+
+template <typename T>
+using WhenAllResult =
+    std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+
+template <typename T>
+Future<WhenAllResult<T>> when_all(std::vector<Future<T>> futures) {
+  struct Block {
+    std::vector<Future<T>> inputs;
+    std::atomic<size_t> remaining;
+    Promise<WhenAllResult<T>> promise;
+  };
+
+  auto block = std::make_shared<Block>();
+  block->inputs = std::move(futures);
+  block->remaining.store(block->inputs.size(), std::memory_order_relaxed);
+  Future<WhenAllResult<T>> result = block->promise.get_future();
+
+  auto finish = [](Block& b) {
+    detail::fulfil(b.promise, [&]() -> WhenAllResult<T> {
+      if constexpr (std::is_void_v<T>) {
+        for (auto& f : b.inputs) f.get();
+      } else {
+        std::vector<T> values;
+        values.reserve(b.inputs.size());
+        for (auto& f : b.inputs) values.push_back(f.get());
+        return values;
+      }
+    });
+  };
+
+  if (block->inputs.empty()) {
+    finish(*block);
+    return result;
+  }
+
+  for (auto& f : block->inputs) {
+    f.on_ready([block, finish]() {
+      if (block->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        finish(*block);
+      }
+    });
+  }
+
+  return result;
+}
+
+template <typename T>
+struct WhenAnyResult {
+  size_t index;
+  T value;
+};
+
+template <>
+struct WhenAnyResult<void> {
+  size_t index;
+};
+
+// Completes with the first input to become ready (value or exception).
+// With no inputs nothing could ever become ready, so the result fails at
+// once with std::invalid_argument.
+template <typename T>
+Future<WhenAnyResult<T>> when_any(std::vector<Future<T>> futures) {
+  struct Block {
+    std::vector<Future<T>> inputs;
+    std::atomic<bool> done{false};
+    Promise<WhenAnyResult<T>> promise;
+  };
+
+  auto block = std::make_shared<Block>();
+  block->inputs = std::move(futures);
+  Future<WhenAnyResult<T>> result = block->promise.get_future();
+
+  if (block->inputs.empty()) {
+    block->promise.set_exception(
+        std::make_exception_ptr(std::invalid_argument("when_any: no futures")));
+    return result;
+  }
+
+  for (size_t i = 0; i < block->inputs.size(); ++i) {
+    block->inputs[i].on_ready([block, i]() {
+      if (block->done.exchange(true, std::memory_order_acq_rel)) {
+        return;
+      }
+      detail::fulfil(block->promise, [&]() -> WhenAnyResult<T> {
+        if constexpr (std::is_void_v<T>) {
+          block->inputs[i].get();
+          return {i};
+        } else {
+          return {i, block->inputs[i].get()};
+        }
+      });
+    });
+  }
+
+  return result;
+}
+
+// ------------
+// Benchmark: fan-out / fan-in
+// ------------
+//
+// Spawn |num_tasks| tiny tasks and wait for all of them:
+//   1. ThreadPool::submit + when_all
+//   2. ThreadPool::enqueue + std::promise/std::future (the old plumbing,
+//      promise has to live in a shared_ptr because the task is copyable)
+//   3. std::async(std::launch::async): one OS thread per task
+
+void benchmark_fan_out_fan_in(size_t num_tasks) {
+  const int num_threads =
+      std::max(1u, std::thread::hardware_concurrency());
+  auto square = [](size_t x) { return static_cast<int64_t>(x * x); };
+
+  int64_t expected = 0;
+  for (size_t i = 0; i < num_tasks; ++i) expected += square(i);
+
+  {
+    ThreadPool pool(num_threads);
+    int64_t sum = 0;
+
+    double ms = time_ms([&] {
+      std::vector<Future<int64_t>> futures;
+      futures.reserve(num_tasks);
+      for (size_t i = 0; i < num_tasks; ++i) {
+        futures.push_back(pool.submit(square, i));
+      }
+      for (int64_t v : when_all(std::move(futures)).get()) sum += v;
+    });
+
+    std::cout << "submit + when_all:        " << ms << " ms"
+              << (sum == expected ? "" : " (WRONG)") << "\n";
+  }
+
+  {
+    ThreadPool pool(num_threads);
+    int64_t sum = 0;
+
+    double ms = time_ms([&] {
+      std::vector<std::future<int64_t>> futures;
+      futures.reserve(num_tasks);
+      for (size_t i = 0; i < num_tasks; ++i) {
+        auto prom = std::make_shared<std::promise<int64_t>>();
+        futures.push_back(prom->get_future());
+        pool.enqueue([prom, i, square] { prom->set_value(square(i)); });
+      }
+      for (auto& f : futures) sum += f.get();
+    });
+
+    std::cout << "enqueue + std::promise:   " << ms << " ms"
+              << (sum == expected ? "" : " (WRONG)") << "\n";
+  }
+
+  {
+    int64_t sum = 0;
+
+    // NOTE: waves keep the number of live (finished but not yet joined) OS
+    // threads bounded; launching all at once exhausts thread limits.
+    const size_t wave = 1024;
+
+    double ms = time_ms([&] {
+      std::vector<std::future<int64_t>> futures;
+      futures.reserve(wave);
+      for (size_t begin = 0; begin < num_tasks; begin += wave) {
+        size_t end = std::min(num_tasks, begin + wave);
+        for (size_t i = begin; i < end; ++i) {
+          futures.push_back(std::async(std::launch::async, square, i));
+        }
+        for (auto& f : futures) sum += f.get();
+        futures.clear();
+      }
+    });
+
+    std::cout << "std::async:               " << ms << " ms"
+              << (sum == expected ? "" : " (WRONG)") << "\n";
+  }
+}
+
+}  // namespace MT
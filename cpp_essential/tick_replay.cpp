@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.cpp"
+
+namespace MT {
+
+// ------------
+// Binary tick file
+// ------------
+//
+// Fixed-size records in host byte order behind a small header, so a file
+// can be mapped and read in place, no parsing:
+//
+//   TickFileHeader | TickRecord[num_records]
+//
+// Records are sorted by timestamp. Symbols are dense ids 0..num_symbols-1;
+// the reader decides what they map to (names, interned ids).
+
+struct TickFileHeader {
+  char magic[4] = {'T', 'I', 'C', 'K'};
+  uint32_t version = 1;
+  uint32_t record_size = 0;
+  uint32_t num_symbols = 0;
+  uint64_t num_records = 0;
+};
+
+struct TickRecord {
+  uint32_t symbol;
+  uint32_t reserved;  // keeps ts_ns 8-byte aligned
+  int64_t ts_ns;
+  double price;
+};
+
+static_assert(sizeof(TickFileHeader) % alignof(TickRecord) == 0);
+
+// Writes |num_ticks| synthetic ticks over |num_symbols| symbols to |path|:
+//   - symbols drawn at random, so some ids get runs and others are sparse
+//   - exponential gaps between ticks, |ticks_per_sec| on average
+//   - each symbol's price is a random walk starting at 100
+inline void write_tick_file(const std::string& path,
+                            uint64_t num_ticks,
+                            uint32_t num_symbols,
+                            double ticks_per_sec,
+                            uint64_t seed = 42) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) throw std::runtime_error("Failed to open file: " + path);
+
+  TickFileHeader header;
+  header.record_size = sizeof(TickRecord);
+  header.num_symbols = num_symbols;
+  header.num_records = num_ticks;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  uint64_t rng = seed;
+  auto next_unit = [&] {  // uniform in (0, 1)
+    rng = rng * 6364136223846793005ull + 1442695040888963407ull;  // LCG
+    return (double(rng >> 11) + 0.5) / double(uint64_t{1} << 53);
+  };
+
+  std::vector<double> prices(num_symbols, 100.0);
+  std::vector<TickRecord> chunk;
+  chunk.reserve(4096);
+  double ts = 0;
+
+  for (uint64_t i = 0; i < num_ticks; ++i) {
+    ts += -std::log(next_unit()) * 1e9 / ticks_per_sec;
+    uint32_t symbol = uint32_t(next_unit() * num_symbols);
+    prices[symbol] += next_unit() < 0.5 ? -0.01 : 0.01;
+    chunk.push_back({symbol, 0, int64_t(ts), prices[symbol]});
+
+    if (chunk.size() == chunk.capacity() || i + 1 == num_ticks) {
+      out.write(reinterpret_cast<const char*>(chunk.data()),
+                std::streamsize(chunk.size() * sizeof(TickRecord)));
+      chunk.clear();
+    }
+  }
+
+  if (!out.flush()) throw std::runtime_error("Failed to write file: " + path);
+}
+
+// A mapped tick file. Records are read in place from the page cache, and
+// the kernel reads ahead since replay walks the file front to back.
+class TickFile {
+ public:
+  explicit TickFile(const std::string& path) : file(path) {
+    if (!valid()) {
+      throw std::runtime_error("Not a tick file: " + path);
+    }
+    file.advise_sequential();
+  }
+
+  const TickFileHeader& header() const {
+    return *reinterpret_cast<const TickFileHeader*>(file.bytes().data());
+  }
+
+  std::span<const TickRecord> records() const {
+    return {reinterpret_cast<const TickRecord*>(file.bytes().data() +
+                                                sizeof(TickFileHeader)),
+            size_t(header().num_records)};
+  }
+
+ private:
+  bool valid() const {
+    const size_t length = file.bytes().size();
+    if (length < sizeof(TickFileHeader)) {
+      return false;
+    }
+    const TickFileHeader& h = header();
+    return std::memcmp(h.magic, "TICK", 4) == 0 && h.version == 1 &&
+           h.record_size == sizeof(TickRecord) &&
+           h.num_records == (length - sizeof(TickFileHeader)) /
+                                sizeof(TickRecord);
+  }
+
+  MappedFile file;
+};
+
+// ------------
+// Replay
+// ------------
+//
+// Feeds the records of a TickFile to |sink(const TickRecord&)| from
+// |num_feeders| threads. Feeder k takes the symbols with id % num_feeders
+// == k, so each symbol's ticks still arrive in file order and two feeders
+// never update the same symbol. The records are split into one index list
+// per feeder in a single pass before the clock starts, so each feeder
+// reads only its own records instead of scanning the whole file.
+//
+// Modes:
+//   - as fast as possible: every feeder dispatches its ticks back to back;
+//     measures the sustained update rate of the sink
+//   - paced: tick i is due at start + (ts_i - ts_0) / speed, the feeder
+//     waits for it; measures the sink under a realistic arrival pattern
+//
+// Latency of a tick: from the moment it is due until sink() returns, so a
+// feeder that falls behind the schedule shows up in the tail. In
+// as-fast-as-possible mode a tick is due when the previous one is done.
+// One clock read per tick.
+
+struct ReplayOptions {
+  int num_feeders = 1;
+  bool paced = false;
+  double speed = 1.0;  // paced only: 2.0 replays twice as fast as recorded
+};
+
+struct ReplayReport {
+  uint64_t updates = 0;
+  double seconds = 0;
+  double updates_per_sec = 0;
+  // update latency in nanoseconds
+  int64_t p50 = 0;
+  int64_t p90 = 0;
+  int64_t p99 = 0;
+  int64_t p999 = 0;
+  int64_t max = 0;
+};
+
+namespace detail {
+
+inline int64_t replay_clock_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Returns the time it got to |due_ns|. Sleeps through long gaps and yields
+// through short ones: feeders may share a core with the readers they load.
+inline int64_t replay_wait_until(int64_t due_ns) {
+  while (true) {
+    const int64_t now = replay_clock_ns();
+    if (now >= due_ns) {
+      return now;
+    }
+    if (due_ns - now > 200'000) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(due_ns - now) -
+                                  std::chrono::microseconds(100));
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+}  // namespace detail
+
+template <typename Sink>
+ReplayReport replay(const TickFile& file,
+                    const ReplayOptions& options,
+                    Sink&& sink) {
+  const std::span<const TickRecord> records = file.records();
+  const int num_feeders = std::max(options.num_feeders, 1);
+  if (records.empty()) {
+    return {};
+  }
+
+  const int64_t first_ts = records.front().ts_ns;
+
+  // feeder k's records, in file order; one feeder walks the file directly
+  std::vector<std::vector<size_t>> assigned;
+  if (num_feeders > 1) {
+    std::vector<size_t> counts(num_feeders);
+    for (const TickRecord& tick : records) ++counts[tick.symbol % num_feeders];
+    assigned.resize(num_feeders);
+    for (int k = 0; k < num_feeders; ++k) assigned[k].reserve(counts[k]);
+    for (size_t i = 0; i < records.size(); ++i) {
+      assigned[records[i].symbol % num_feeders].push_back(i);
+    }
+  }
+
+  std::vector<std::vector<int64_t>> latencies(num_feeders);
+  std::atomic<int> ready{0};
+  std::atomic<int64_t> start_ns{0};
+
+  auto feed = [&](int feeder) {
+    std::vector<int64_t>& latency = latencies[feeder];
+    const size_t count =
+        num_feeders > 1 ? assigned[feeder].size() : records.size();
+    latency.reserve(count);
+
+    // same start for every feeder, so paced schedules line up
+    if (ready.fetch_add(1) + 1 == num_feeders) {
+      start_ns.store(detail::replay_clock_ns());
+    }
+    while (start_ns.load() == 0) std::this_thread::yield();
+    const int64_t start = start_ns.load();
+
+    int64_t done = start;
+    for (size_t n = 0; n < count; ++n) {
+      const TickRecord& tick =
+          records[num_feeders > 1 ? assigned[feeder][n] : n];
+      int64_t due = done;
+      if (options.paced) {
+        due = start + int64_t(double(tick.ts_ns - first_ts) / options.speed);
+        detail::replay_wait_until(due);
+      }
+      sink(tick);
+      done = detail::replay_clock_ns();
+      latency.push_back(done - due);
+    }
+  };
+
+  std::vector<std::thread> feeders;
+  for (int k = 1; k < num_feeders; ++k) {
+    feeders.emplace_back(feed, k);
+  }
+  feed(0);
+  for (auto& t : feeders) t.join();
+  const int64_t end_ns = detail::replay_clock_ns();
+
+  std::vector<int64_t> all;
+  all.reserve(records.size());
+  for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+  std::sort(all.begin(), all.end());
+  auto percentile = [&](double p) {
+    return all[std::min(all.size() - 1, size_t(p * all.size()))];
+  };
+
+  ReplayReport report;
+  report.updates = all.size();
+  report.seconds = double(end_ns - start_ns.load()) / 1e9;
+  report.updates_per_sec = report.updates / report.seconds;
+  report.p50 = percentile(0.50);
+  report.p90 = percentile(0.90);
+  report.p99 = percentile(0.99);
+  report.p999 = percentile(0.999);
+  report.max = all.back();
+  return report;
+}
+
+}  // namespace MT
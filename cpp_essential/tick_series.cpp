@@ -0,0 +1,491 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "epoch_reclamation.cpp"
+#include "symbol_table.cpp"
+
+namespace MT {
+
+// ------------
+// Per-symbol tick history (columnar ring)
+// ------------
+//
+// TickSeries keeps the last |capacity| ticks of one symbol as a ring of
+// fixed-size blocks. Each block stores its ticks column by column (struct
+// of arrays) instead of as Tick structs:
+//   ts[]     int64 nanoseconds
+//   price[]  double
+//   size[]   double
+// A window aggregate streams only the columns it needs, 8 values per cache
+// line, into 8 independent partial sums/min/max per statistic, so no add
+// waits on the previous one. The 8 lanes are explicit SIMD registers:
+// 2 x 4 doubles with AVX2 (-mavx2 / -march=native), 4 x 2 with SSE2 (any
+// x86-64) or NEON (arm64); other targets run the same lanes as a scalar
+// loop. GCC does not vectorize that loop by itself: without -ffast-math it
+// keeps FP adds in source order, and with -O3 it still leaves the min/max
+// selects scalar. Every path adds the same values in the same order per
+// lane, so the results are bit-identical whichever one is compiled in.
+//
+// One writer, any number of readers, no locks:
+//   - the writer fills the slot at |count|, then publishes count + 1; it
+//     never touches a published slot again
+//   - when the ring wraps, the writer does not overwrite the oldest block:
+//     it installs a fresh one and retires the old one to the epoch domain
+//   - readers pin the epoch, so every block they reach stays valid and
+//     unchanged for as long as they read it; each block records the first
+//     tick it holds, so a reader that was lapped notices and starts over
+// Readers therefore aggregate straight out of the blocks with plain loads.
+//
+// The oldest block can be replaced at any moment, so the newest
+// capacity - kBlockSize ticks are readable.
+
+struct Tick {
+  int64_t ts_ns;
+  double price;
+  double size;
+};
+
+struct WindowStats {
+  size_t count = 0;
+  double min_price = 0;
+  double max_price = 0;
+  double mean_price = 0;
+  double volume = 0;  // sum of sizes
+  double vwap = 0;    // sum(price * size) / volume
+};
+
+class TickSeries {
+ public:
+  static constexpr size_t kBlockSize = 256;
+
+  // |capacity| is rounded up to a power of two of at least 2 blocks.
+  explicit TickSeries(size_t capacity)
+      : block_mask(std::bit_ceil(std::max<size_t>(capacity / kBlockSize, 2)) -
+                   1),
+        blocks(std::make_unique<std::atomic<Block*>[]>(block_mask + 1)) {}
+
+  ~TickSeries() {
+    for (size_t i = 0; i <= block_mask; ++i) {
+      delete blocks[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  TickSeries(const TickSeries&) = delete;
+  TickSeries& operator=(const TickSeries&) = delete;
+
+  // --- writer ---
+
+  void append(const Tick& tick) {
+    const uint64_t n = count.load(std::memory_order_relaxed);
+    store(n, tick);
+    count.store(n + 1, std::memory_order_release);
+  }
+
+  // Publishes the whole batch with one store.
+  void append_batch(std::span<const Tick> ticks) {
+    const uint64_t n = count.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < ticks.size(); ++i) store(n + i, ticks[i]);
+    count.store(n + ticks.size(), std::memory_order_release);
+  }
+
+  // --- readers (timestamps must not decrease for since()) ---
+
+  size_t capacity() const { return (block_mask + 1) * kBlockSize; }
+
+  // Number of readable ticks.
+  size_t size() const {
+    return std::min<uint64_t>(count.load(std::memory_order_acquire),
+                              readable());
+  }
+
+  std::optional<Tick> last() const {
+    auto guard = epoch_domain().pin();
+    while (true) {
+      const uint64_t n = count.load(std::memory_order_seq_cst);
+      if (n == 0) {
+        return std::nullopt;
+      }
+      if (const Block* block = block_of(n - 1)) {
+        const size_t slot = (n - 1) % kBlockSize;
+        return Tick{block->ts[slot], block->price[slot], block->size[slot]};
+      }
+    }
+  }
+
+  // Aggregates over the newest |n| ticks (fewer if not available).
+  WindowStats last_n(size_t n) const {
+    auto guard = epoch_domain().pin();
+    while (true) {
+      const uint64_t end = count.load(std::memory_order_seq_cst);
+      const uint64_t first = end - std::min<uint64_t>({n, end, readable()});
+      if (auto stats = aggregate(first, end)) {
+        return *stats;
+      }
+    }
+  }
+
+  // Aggregates over the readable ticks with ts_ns >= |from_ns|.
+  WindowStats since(int64_t from_ns) const {
+    auto guard = epoch_domain().pin();
+    while (true) {
+      const uint64_t end = count.load(std::memory_order_seq_cst);
+      if (auto first = lower_bound(from_ns, end)) {
+        if (auto stats = aggregate(*first, end)) {
+          return *stats;
+        }
+      }
+    }
+  }
+
+  // Aggregates over the last |window| of time, ending at |now_ns|.
+  WindowStats last_duration(std::chrono::nanoseconds window,
+                            int64_t now_ns) const {
+    return since(now_ns - window.count());
+  }
+
+ private:
+  struct Block {
+    uint64_t base;  // index of the first tick stored here
+    int64_t ts[kBlockSize];
+    double price[kBlockSize];
+    double size[kBlockSize];
+  };
+
+  size_t readable() const { return capacity() - kBlockSize; }
+
+  void store(uint64_t index, const Tick& tick) {
+    const size_t slot = index % kBlockSize;
+    if (slot == 0) {
+      // new block; the one it replaces may still be read by pinned readers
+      auto* block = new Block;
+      block->base = index;
+      Block* old = blocks[(index / kBlockSize) & block_mask].exchange(
+          block, std::memory_order_seq_cst);
+      if (old) {
+        epoch_domain().retire(old);
+      }
+      tail = block;
+    }
+    tail->ts[slot] = tick.ts_ns;
+    tail->price[slot] = tick.price;
+    tail->size[slot] = tick.size;
+  }
+
+  // The block holding tick |index|, or nullptr if it was already replaced.
+  // Caller is pinned.
+  const Block* block_of(uint64_t index) const {
+    const Block* block = blocks[(index / kBlockSize) & block_mask].load(
+        std::memory_order_seq_cst);
+    return block && block->base == index - index % kBlockSize ? block
+                                                              : nullptr;
+  }
+
+  // First index in the readable range whose ts >= |from_ns|; nullopt if a
+  // block was replaced under us.
+  std::optional<uint64_t> lower_bound(int64_t from_ns, uint64_t end) const {
+    uint64_t lo = end - std::min<uint64_t>(end, readable());
+    uint64_t hi = end;
+    while (lo < hi) {
+      const uint64_t mid = lo + (hi - lo) / 2;
+      const Block* block = block_of(mid);
+      if (!block) {
+        return std::nullopt;
+      }
+      if (block->ts[mid % kBlockSize] < from_ns) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  // kLanes independent accumulators per quantity; element i goes to lane
+  // i % kLanes of the group it starts, the tail of a block to lane 0. The
+  // lanes are worked on in locals (registers): the compiler cannot prove
+  // |p| and |q| do not alias the members and would store them back on
+  // every iteration.
+  struct Accumulator {
+    static constexpr int kLanes = 8;
+
+    double sum[kLanes] = {};
+    double volume[kLanes] = {};
+    double notional[kLanes] = {};
+    double min[kLanes];
+    double max[kLanes];
+
+    Accumulator() {
+      std::fill(std::begin(min), std::end(min),
+                std::numeric_limits<double>::infinity());
+      std::fill(std::begin(max), std::end(max),
+                -std::numeric_limits<double>::infinity());
+    }
+
+    void add(const double* p, const double* q, size_t n) {
+      size_t i = add_groups(p, q, n);
+      for (; i < n; ++i) {
+        sum[0] += p[i];
+        volume[0] += q[i];
+        notional[0] += p[i] * q[i];
+        min[0] = p[i] < min[0] ? p[i] : min[0];
+        max[0] = p[i] > max[0] ? p[i] : max[0];
+      }
+    }
+
+    // Adds the whole groups of kLanes elements; returns how many it took.
+#if defined(__AVX2__) || defined(__SSE2__) || \
+    (defined(__aarch64__) && defined(__ARM_NEON))
+#if defined(__AVX2__)
+    using Vec = __m256d;
+    static constexpr int kWidth = 4;
+    static Vec load(const double* x) { return _mm256_loadu_pd(x); }
+    static void store(double* x, Vec v) { _mm256_storeu_pd(x, v); }
+    static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+    static Vec min_of(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+    static Vec max_of(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+#elif defined(__SSE2__)
+    using Vec = __m128d;
+    static constexpr int kWidth = 2;
+    static Vec load(const double* x) { return _mm_loadu_pd(x); }
+    static void store(double* x, Vec v) { _mm_storeu_pd(x, v); }
+    static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+    static Vec min_of(Vec a, Vec b) { return _mm_min_pd(a, b); }
+    static Vec max_of(Vec a, Vec b) { return _mm_max_pd(a, b); }
+#else
+    using Vec = float64x2_t;
+    static constexpr int kWidth = 2;
+    static Vec load(const double* x) { return vld1q_f64(x); }
+    static void store(double* x, Vec v) { vst1q_f64(x, v); }
+    static Vec add(Vec a, Vec b) { return vaddq_f64(a, b); }
+    static Vec mul(Vec a, Vec b) { return vmulq_f64(a, b); }
+    // a < b ? a : b, like _mm_min_pd and the scalar loop (vminq_f64
+    // would treat NaN differently)
+    static Vec min_of(Vec a, Vec b) { return vbslq_f64(vcltq_f64(a, b), a, b); }
+    static Vec max_of(Vec a, Vec b) { return vbslq_f64(vcgtq_f64(a, b), a, b); }
+#endif
+    static constexpr int kRegs = kLanes / kWidth;
+
+    size_t add_groups(const double* p, const double* q, size_t n) {
+      Vec s[kRegs], v[kRegs], pv[kRegs], lo[kRegs], hi[kRegs];
+      for (int r = 0; r < kRegs; ++r) {
+        s[r] = load(sum + r * kWidth);
+        v[r] = load(volume + r * kWidth);
+        pv[r] = load(notional + r * kWidth);
+        lo[r] = load(min + r * kWidth);
+        hi[r] = load(max + r * kWidth);
+      }
+
+      size_t i = 0;
+      for (; i + kLanes <= n; i += kLanes) {
+        for (int r = 0; r < kRegs; ++r) {
+          const Vec price = load(p + i + r * kWidth);
+          const Vec size = load(q + i + r * kWidth);
+          s[r] = add(s[r], price);
+          v[r] = add(v[r], size);
+          pv[r] = add(pv[r], mul(price, size));  // no FMA: same rounding
+          lo[r] = min_of(price, lo[r]);
+          hi[r] = max_of(price, hi[r]);
+        }
+      }
+
+      for (int r = 0; r < kRegs; ++r) {
+        store(sum + r * kWidth, s[r]);
+        store(volume + r * kWidth, v[r]);
+        store(notional + r * kWidth, pv[r]);
+        store(min + r * kWidth, lo[r]);
+        store(max + r * kWidth, hi[r]);
+      }
+      return i;
+    }
+#else
+    size_t add_groups(const double* p, const double* q, size_t n) {
+      double s[kLanes], v[kLanes], pv[kLanes], lo[kLanes], hi[kLanes];
+      for (int k = 0; k < kLanes; ++k) {
+        s[k] = sum[k];
+        v[k] = volume[k];
+        pv[k] = notional[k];
+        lo[k] = min[k];
+        hi[k] = max[k];
+      }
+
+      size_t i = 0;
+      for (; i + kLanes <= n; i += kLanes) {
+        for (int k = 0; k < kLanes; ++k) {
+          s[k] += p[i + k];
+          v[k] += q[i + k];
+          pv[k] += p[i + k] * q[i + k];
+          lo[k] = p[i + k] < lo[k] ? p[i + k] : lo[k];
+          hi[k] = p[i + k] > hi[k] ? p[i + k] : hi[k];
+        }
+      }
+
+      for (int k = 0; k < kLanes; ++k) {
+        sum[k] = s[k];
+        volume[k] = v[k];
+        notional[k] = pv[k];
+        min[k] = lo[k];
+        max[k] = hi[k];
+      }
+      return i;
+    }
+#endif
+  };
+
+  // nullopt if a block of [first, end) was replaced under us.
+  std::optional<WindowStats> aggregate(uint64_t first, uint64_t end) const {
+    WindowStats stats;
+    stats.count = end - first;
+    if (stats.count == 0) {
+      return stats;
+    }
+
+    Accumulator acc;
+    for (uint64_t i = first; i < end;) {
+      const Block* block = block_of(i);
+      if (!block) {
+        return std::nullopt;
+      }
+      const size_t slot = i % kBlockSize;
+      const size_t n = std::min<uint64_t>(kBlockSize - slot, end - i);
+      acc.add(block->price + slot, block->size + slot, n);
+      i += n;
+    }
+
+    double sum = 0, notional = 0;
+    stats.min_price = acc.min[0];
+    stats.max_price = acc.max[0];
+    for (int k = 0; k < Accumulator::kLanes; ++k) {
+      sum += acc.sum[k];
+      stats.volume += acc.volume[k];
+      notional += acc.notional[k];
+      stats.min_price = std::min(stats.min_price, acc.min[k]);
+      stats.max_price = std::max(stats.max_price, acc.max[k]);
+    }
+    stats.mean_price = sum / stats.count;
+    stats.vwap = stats.volume > 0 ? notional / stats.volume : 0;
+    return stats;
+  }
+
+  const size_t block_mask;
+  std::unique_ptr<std::atomic<Block*>[]> blocks;
+  alignas(64) std::atomic<uint64_t> count{0};
+  // writer only: the block receiving appends
+  Block* tail = nullptr;
+};
+
+// ------------
+// DataCache with history
+// ------------
+//
+// DataCache's update/get on top of one TickSeries per symbol. Appends come
+// from a single writer thread (the feed handler); readers get the latest
+// price or window aggregates without locks.
+//
+// The id -> series directory is a fixed array of atomic pointers sized at
+// construction, so adding a symbol never moves what readers are looking at.
+
+class TimeSeriesCache {
+ public:
+  explicit TimeSeriesCache(size_t max_symbols = 4096,
+                           size_t ticks_per_symbol = 1 << 14)
+      : ticks_per_symbol(ticks_per_symbol),
+        directory(std::make_unique<std::atomic<TickSeries*>[]>(max_symbols)),
+        max_symbols(max_symbols) {}
+
+  ~TimeSeriesCache() {
+    for (size_t i = 0; i < max_symbols; ++i) {
+      delete directory[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  TimeSeriesCache(const TimeSeriesCache&) = delete;
+  TimeSeriesCache& operator=(const TimeSeriesCache&) = delete;
+
+  // --- writer ---
+
+  SymbolId intern(const std::string& symbol) {
+    SymbolId id = symbols.intern(symbol);
+    if (id >= max_symbols) {
+      throw std::length_error("TimeSeriesCache: too many symbols");
+    }
+    if (!directory[id].load(std::memory_order_relaxed)) {
+      directory[id].store(new TickSeries(ticks_per_symbol),
+                          std::memory_order_release);
+    }
+    return id;
+  }
+
+  void append(SymbolId id, const Tick& tick) {
+    directory[id].load(std::memory_order_relaxed)->append(tick);
+  }
+
+  void append_batch(SymbolId id, std::span<const Tick> ticks) {
+    directory[id].load(std::memory_order_relaxed)->append_batch(ticks);
+  }
+
+  // DataCache interface: a tick of size 0 stamped with the current time.
+  void update(const std::string& symbol, double price) {
+    append(intern(symbol), {now_ns(), price, 0.0});
+  }
+
+  // --- readers ---
+
+  double get(const std::string& symbol) const {
+    auto id = symbols.find(symbol);
+    return id ? get(*id) : 0.0;
+  }
+
+  double get(SymbolId id) const {
+    const TickSeries* s = series(id);
+    if (!s) {
+      return 0.0;
+    }
+    auto tick = s->last();
+    return tick ? tick->price : 0.0;
+  }
+
+  // nullptr until the writer interned the symbol.
+  const TickSeries* series(SymbolId id) const {
+    return id < max_symbols ? directory[id].load(std::memory_order_acquire)
+                            : nullptr;
+  }
+
+  std::optional<SymbolId> find(const std::string& symbol) const {
+    return symbols.find(symbol);
+  }
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+ private:
+  const size_t ticks_per_symbol;
+  SymbolTable symbols;
+  std::unique_ptr<std::atomic<TickSeries*>[]> directory;
+  const size_t max_symbols;
+};
+
+}  // namespace MT
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "thread_pool.cpp"
+
+namespace MT {
+
+// ------------
+// Hierarchical timing wheel
+// ------------
+//
+// "Run this in 50 ms" / "run this every second" without parking a thread
+// per timer: one timer thread hands due tasks to a ThreadPool.
+//
+// A min-heap (TimerService in task.cpp) costs O(log n) per insert and
+// cannot cancel. The wheel does both in O(1): time is cut into ticks,
+// and a timer goes into the slot of its tick. Four levels of 256 slots:
+//   level 0: one slot per tick, the next 256 ticks
+//   level 1: one slot per 256 ticks, the next 64K ticks
+//   level 2: one slot per 64K ticks, the next 16M ticks
+//   level 3: one slot per 16M ticks, the next 4G ticks
+// Insert = pick the level from the distance, the slot from the expiry
+// tick, push onto that slot's list. Cancel = unlink from the list (the
+// lists are intrusive and doubly linked). Every 256 ticks the next slot
+// of level 1 is "cascaded": its timers are re-inserted, now landing in
+// level 0; level 1 refills from level 2 the same way every 64K ticks, and
+// so on. A timer moves at most three times before it fires.
+//
+// Coarse ticks: expiries are rounded up to a whole tick (never early, up
+// to one tick late), and all timers of a tick are dispatched in one go.
+// The timer thread sleeps until the next non-empty level 0 slot or the
+// next cascade, not every tick; a new timer only wakes it if it is due
+// before that. With nothing pending it sleeps until a timer arrives.
+//
+// Periodic timers run at a fixed rate (every |period| from the first
+// expiry, skipping runs missed while the timer thread was behind), and on
+// the pool: with several workers, a run longer than the period can
+// overlap the next. cancel() stops future runs; a run already handed to
+// the pool still happens.
+//
+// Delays are capped at 2^32 ticks (~49 days with 1 ms ticks). Timers
+// still pending at destruction are dropped.
+
+class TimerWheel {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using TimerId = uint64_t;  // 0 never names a timer
+
+  explicit TimerWheel(ThreadPool& pool,
+                      Clock::duration tick = std::chrono::milliseconds(1))
+      : pool(pool),
+        tick(std::max(tick, Clock::duration(1))),
+        start(Clock::now()),
+        thread([this] { loop(); }) {}
+
+  ~TimerWheel() {
+    {
+      std::lock_guard<std::mutex> locker(mtx);
+      stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // Enqueues |task| on the pool once |delay| has passed.
+  template <typename Rep, typename Period>
+  TimerId schedule_after(std::chrono::duration<Rep, Period> delay,
+                         UniqueFunction task) {
+    return add(std::chrono::duration_cast<Clock::duration>(delay), 0,
+               std::move(task));
+  }
+
+  // Enqueues |task| every |period|, the first time one period from now.
+  template <typename Rep, typename Period>
+  TimerId schedule_every(std::chrono::duration<Rep, Period> period,
+                         UniqueFunction task) {
+    const auto d = std::chrono::duration_cast<Clock::duration>(period);
+    const uint64_t ticks =
+        std::max<uint64_t>((d + tick - Clock::duration(1)) / tick, 1);
+    return add(d, ticks, std::move(task));
+  }
+
+  // Returns true if the timer was pending (and now never runs again),
+  // false if it already fired (one-shot) or was cancelled.
+  bool cancel(TimerId id) {
+    const uint32_t index = uint32_t(id);
+    const uint32_t generation = uint32_t(id >> 32);
+    std::lock_guard<std::mutex> locker(mtx);
+    if (index >= nodes.size() || nodes[index].generation != generation) {
+      return false;
+    }
+    unlink(index);
+    release(index);
+    return true;
+  }
+
+  size_t pending() const {
+    std::lock_guard<std::mutex> locker(mtx);
+    return num_pending;
+  }
+
+ private:
+  static constexpr int kLevels = 4;
+  static constexpr int kSlotBits = 8;
+  static constexpr uint32_t kSlots = 1u << kSlotBits;
+  static constexpr uint32_t kNil = ~uint32_t{0};
+  static constexpr uint64_t kMaxDelay = (uint64_t{1} << 32) - 1;  // ticks
+
+  struct Node {
+    UniqueFunction task;                     // one-shot
+    std::shared_ptr<UniqueFunction> repeat;  // periodic: shared by its runs
+    uint64_t expires = 0;                    // tick
+    uint64_t period = 0;                     // ticks; 0: one-shot
+    uint32_t prev = kNil;
+    uint32_t next = kNil;  // also the free list
+    uint32_t generation = 1;
+    uint32_t slot = kNil;  // level * kSlots + index
+  };
+
+  TimerId add(Clock::duration delay, uint64_t period, UniqueFunction task) {
+    const Clock::duration elapsed = Clock::now() - start;
+    const uint64_t expires =
+        uint64_t((elapsed + std::max(delay, Clock::duration(0)) + tick -
+                  Clock::duration(1)) /
+                 tick);
+
+    bool wake;
+    TimerId id;
+    {
+      std::lock_guard<std::mutex> locker(mtx);
+      if (num_pending == 0) {
+        // idle: no need to walk the ticks that passed without timers
+        current = std::max(current, uint64_t(elapsed / tick));
+      }
+      const uint32_t index = acquire();
+      Node& node = nodes[index];
+      node.expires = std::min(expires, current + kMaxDelay);
+      node.period = period;
+      if (period != 0) {
+        node.repeat = std::make_shared<UniqueFunction>(std::move(task));
+      } else {
+        node.task = std::move(task);
+      }
+      place(index);
+      id = (TimerId{node.generation} << 32) | index;
+      wake = node.expires < wake_tick;
+      if (wake) {
+        wake_tick = node.expires;
+      }
+    }
+    if (wake) {
+      cv.notify_one();  // sleeping past it otherwise
+    }
+    return id;
+  }
+
+  uint32_t acquire() {
+    ++num_pending;
+    if (free_head != kNil) {
+      const uint32_t index = free_head;
+      free_head = nodes[index].next;
+      return index;
+    }
+    nodes.emplace_back();
+    return uint32_t(nodes.size() - 1);
+  }
+
+  void release(uint32_t index) {
+    --num_pending;
+    Node& node = nodes[index];
+    node.task = UniqueFunction();
+    node.repeat.reset();
+    ++node.generation;  // stale ids stop matching
+    node.next = free_head;
+    free_head = index;
+  }
+
+  // Puts node |index| into the slot for its expiry, relative to |current|.
+  void place(uint32_t index) {
+    const uint64_t expires = std::max(nodes[index].expires, current);
+    const uint64_t distance = expires - current;
+    int level = 0;
+    while (level < kLevels - 1 &&
+           distance >= uint64_t{1} << (kSlotBits * (level + 1))) {
+      ++level;
+    }
+    const uint32_t slot =
+        uint32_t(level) * kSlots +
+        uint32_t((expires >> (kSlotBits * level)) & (kSlots - 1));
+    link(index, slot);
+  }
+
+  void link(uint32_t index, uint32_t slot) {
+    Node& node = nodes[index];
+    node.slot = slot;
+    node.prev = kNil;
+    node.next = heads[slot];
+    if (node.next != kNil) {
+      nodes[node.next].prev = index;
+    }
+    heads[slot] = index;
+    if (slot < kSlots) {
+      occupied[slot / 64] |= uint64_t{1} << (slot % 64);
+    }
+  }
+
+  void unlink(uint32_t index) {
+    Node& node = nodes[index];
+    if (node.prev != kNil) {
+      nodes[node.prev].next = node.next;
+    } else {
+      heads[node.slot] = node.next;
+      if (node.next == kNil && node.slot < kSlots) {
+        occupied[node.slot / 64] &= ~(uint64_t{1} << (node.slot % 64));
+      }
+    }
+    if (node.next != kNil) {
+      nodes[node.next].prev = node.prev;
+    }
+    node.slot = kNil;
+  }
+
+  // Takes the whole list of |slot|.
+  uint32_t take(uint32_t slot) {
+    const uint32_t first = heads[slot];
+    heads[slot] = kNil;
+    if (slot < kSlots) {
+      occupied[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    }
+    return first;
+  }
+
+  // Re-inserts the timers of |level|'s slot for |current|; returns that
+  // slot's index (0: time to cascade the level above too).
+  uint32_t cascade(int level) {
+    const uint32_t index =
+        uint32_t((current >> (kSlotBits * level)) & (kSlots - 1));
+    for (uint32_t i = take(uint32_t(level) * kSlots + index); i != kNil;) {
+      const uint32_t next = nodes[i].next;
+      place(i);
+      i = next;
+    }
+    return index;
+  }
+
+  // Processes tick |current|: cascades if it starts a new lap of level 0,
+  // then moves that tick's tasks to |due|.
+  void advance() {
+    const uint32_t index = uint32_t(current & (kSlots - 1));
+    if (index == 0) {
+      for (int level = 1; level < kLevels && cascade(level) == 0; ++level) {
+      }
+    }
+
+    for (uint32_t i = take(index); i != kNil;) {
+      Node& node = nodes[i];
+      const uint32_t next = node.next;
+      if (node.period == 0) {
+        due.push_back(std::move(node.task));
+        release(i);
+      } else {
+        due.push_back([fn = node.repeat] { (*fn)(); });
+        node.expires += node.period;
+        if (node.expires <= current) {  // behind: skip the missed runs
+          const uint64_t behind = current - node.expires;
+          node.expires += (behind / node.period + 1) * node.period;
+        }
+        place(i);
+      }
+      i = next;
+    }
+    ++current;
+  }
+
+  // The next tick worth waking up for: the next non-empty level 0 slot
+  // before the end of the lap, else the cascade that starts the next lap.
+  uint64_t next_wake_tick() const {
+    const uint32_t index = uint32_t(current & (kSlots - 1));
+    for (uint32_t word = index / 64; word < kSlots / 64; ++word) {
+      uint64_t bits = occupied[word];
+      if (word == index / 64) {
+        bits &= ~uint64_t{0} << (index % 64);
+      }
+      if (bits != 0) {
+        return current - index + word * 64 + std::countr_zero(bits);
+      }
+    }
+    return (current | (kSlots - 1)) + 1;
+  }
+
+  void loop() {
+    std::unique_lock<std::mutex> locker(mtx);
+    while (!stopping) {
+      if (num_pending == 0) {
+        wake_tick = ~uint64_t{0};
+        cv.wait(locker);
+        continue;
+      }
+
+      const uint64_t now = uint64_t((Clock::now() - start) / tick);
+      while (current <= now && num_pending != 0) {
+        advance();
+      }
+      if (current <= now) {  // emptied: skip ahead
+        current = now + 1;
+      }
+
+      if (!due.empty()) {
+        wake_tick = 0;  // busy: new timers need not wake us
+        locker.unlock();
+        for (UniqueFunction& task : due) {
+          pool.enqueue(std::move(task));
+        }
+        due.clear();
+        locker.lock();
+        continue;
+      }
+
+      if (num_pending != 0) {
+        wake_tick = next_wake_tick();
+        cv.wait_until(locker, start + tick * int64_t(wake_tick));
+      }
+    }
+  }
+
+  ThreadPool& pool;
+  const Clock::duration tick;
+  const Clock::time_point start;
+
+  mutable std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<Node> nodes;
+  uint32_t free_head = kNil;
+  size_t num_pending = 0;
+  std::array<uint32_t, kLevels * kSlots> heads = make_heads();
+  std::array<uint64_t, kSlots / 64> occupied{};  // level 0 slots in use
+  uint64_t current = 0;             // next tick to process
+  uint64_t wake_tick = ~uint64_t{0};  // what the timer thread sleeps until
+  bool stopping = false;
+
+  std::vector<UniqueFunction> due;  // timer thread only
+
+  std::thread thread;  // last: starts after the members it uses
+
+  static std::array<uint32_t, kLevels * kSlots> make_heads() {
+    std::array<uint32_t, kLevels * kSlots> h;
+    h.fill(kNil);
+    return h;
+  }
+};
+
+}  // namespace MT